@@ -0,0 +1,74 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <string>
+#include "search_server.h"
+
+// Awaitable returned by SearchServer::FindTopDocumentsAsync. The query text is copied,
+// so the caller's string may go away while the query is in flight. Cancellation through
+// QueryOptions::cancellation makes co_await throw QueryCancelled.
+class SearchAwaitable
+{
+public:
+    SearchAwaitable(const SearchServer &search_server, QueryExecutor *executor,
+                    std::string_view raw_query, QueryOptions options)
+        : search_server_(&search_server),
+          executor_(executor),
+          raw_query_(raw_query),
+          options_(std::move(options))
+    {
+    }
+
+    bool await_ready()
+    {
+        if (executor_ == nullptr)
+        {
+            Run();
+            return true;
+        }
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> caller)
+    {
+        executor_->Submit([this, caller]
+                          {
+                              Run();
+                              caller.resume();
+                          });
+    }
+
+    SearchResult await_resume()
+    {
+        if (error_)
+        {
+            std::rethrow_exception(error_);
+        }
+        return std::move(result_);
+    }
+
+private:
+    const SearchServer *search_server_;
+    QueryExecutor *executor_;
+    std::string raw_query_;
+    QueryOptions options_;
+    SearchResult result_;
+    std::exception_ptr error_;
+
+    void Run()
+    {
+        try
+        {
+            result_ = search_server_->FindTopDocuments(raw_query_, options_);
+        }
+        catch (...)
+        {
+            error_ = std::current_exception();
+        }
+    }
+};
+
+inline SearchAwaitable SearchServer::FindTopDocumentsAsync(std::string_view raw_query, QueryOptions options) const
+{
+    return SearchAwaitable(*this, query_executor_.get(), raw_query, std::move(options));
+}
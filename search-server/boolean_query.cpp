@@ -0,0 +1,185 @@
+#include <stdexcept>
+#include <string>
+
+#include "boolean_query.h"
+#include "galloping_search.h"
+
+using namespace std::string_literals;
+
+namespace
+{
+    std::vector<std::string_view> SplitIntoTokens(std::string_view text)
+    {
+        std::vector<std::string_view> tokens;
+        size_t start = 0;
+        for (size_t i = 0; i <= text.size(); ++i)
+        {
+            if (i < text.size() && text[i] != ' ' && text[i] != '(' && text[i] != ')')
+            {
+                continue;
+            }
+            if (i > start)
+            {
+                tokens.push_back(text.substr(start, i - start));
+            }
+            if (i < text.size() && text[i] != ' ')
+            {
+                tokens.push_back(text.substr(i, 1));
+            }
+            start = i + 1;
+        }
+        return tokens;
+    }
+
+    class BooleanQueryParser
+    {
+    public:
+        explicit BooleanQueryParser(std::string_view text) : tokens_(SplitIntoTokens(text)) {}
+
+        BooleanQuery Parse()
+        {
+            if (!tokens_.empty())
+            {
+                query_.root = ParseOr();
+            }
+            if (position_ < tokens_.size())
+            {
+                throw std::invalid_argument("Unexpected "s + std::string(tokens_[position_]) + " in boolean query"s);
+            }
+            return std::move(query_);
+        }
+
+    private:
+        std::vector<std::string_view> tokens_;
+        size_t position_ = 0;
+        BooleanQuery query_;
+
+        bool IsNext(std::string_view token) const
+        {
+            return position_ < tokens_.size() && tokens_[position_] == token;
+        }
+
+        bool StartsOperand() const
+        {
+            return position_ < tokens_.size() && !IsNext("AND") && !IsNext("OR") && !IsNext(")");
+        }
+
+        int AddNode(BooleanOperator op, std::string_view word, std::vector<int> children)
+        {
+            query_.nodes.push_back({op, word, std::move(children)});
+            return static_cast<int>(query_.nodes.size()) - 1;
+        }
+
+        int ParseOr()
+        {
+            std::vector<int> children = {ParseAnd()};
+            while (IsNext("OR"))
+            {
+                ++position_;
+                children.push_back(ParseAnd());
+            }
+            return children.size() == 1 ? children[0] : AddNode(BooleanOperator::OR, {}, std::move(children));
+        }
+
+        int ParseAnd()
+        {
+            std::vector<int> children = {ParseUnary()};
+            while (IsNext("AND") || StartsOperand())
+            {
+                position_ += IsNext("AND") ? 1 : 0;
+                children.push_back(ParseUnary());
+            }
+            return children.size() == 1 ? children[0] : AddNode(BooleanOperator::AND, {}, std::move(children));
+        }
+
+        int ParseUnary()
+        {
+            if (!StartsOperand())
+            {
+                throw std::invalid_argument("Boolean query operand is missing"s);
+            }
+            const std::string_view token = tokens_[position_++];
+            if (token == "NOT")
+            {
+                return AddNode(BooleanOperator::NOT, {}, {ParseUnary()});
+            }
+            if (token == "(")
+            {
+                const int node = ParseOr();
+                if (!IsNext(")"))
+                {
+                    throw std::invalid_argument("Boolean query has unbalanced parentheses"s);
+                }
+                ++position_;
+                return node;
+            }
+            return AddNode(BooleanOperator::WORD, token, {});
+        }
+    };
+}
+
+BooleanQuery ParseBooleanQuery(std::string_view text)
+{
+    return BooleanQueryParser(text).Parse();
+}
+
+DocumentIdCursor::DocumentIdCursor(const std::map<int, double> &postings) : postings_(&postings),
+                                                                            postings_position_(postings.begin()) {}
+
+DocumentIdCursor::DocumentIdCursor(const std::vector<int> &document_ids) : document_ids_(&document_ids),
+                                                                           document_ids_position_(document_ids.begin()) {}
+
+size_t DocumentIdCursor::GetSize() const
+{
+    return postings_ ? postings_->size() : document_ids_->size();
+}
+
+bool DocumentIdCursor::IsEnd() const
+{
+    return postings_ ? postings_position_ == postings_->end() : document_ids_position_ == document_ids_->end();
+}
+
+int DocumentIdCursor::GetDocumentId() const
+{
+    return postings_ ? postings_position_->first : *document_ids_position_;
+}
+
+double DocumentIdCursor::GetTermFreq() const
+{
+    return postings_position_->second;
+}
+
+void DocumentIdCursor::Next()
+{
+    if (postings_)
+    {
+        ++postings_position_;
+    }
+    else
+    {
+        ++document_ids_position_;
+    }
+}
+
+void DocumentIdCursor::SeekTo(int document_id)
+{
+    for (int step = 0; step < LINEAR_STEP_COUNT; ++step)
+    {
+        if (IsEnd() || GetDocumentId() >= document_id)
+        {
+            return;
+        }
+        Next();
+    }
+    if (postings_)
+    {
+        if (postings_position_ != postings_->end() && postings_position_->first < document_id)
+        {
+            postings_position_ = postings_->lower_bound(document_id);
+        }
+    }
+    else
+    {
+        document_ids_position_ = GallopingLowerBound(document_ids_position_, document_ids_->end(), document_id);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <map>
+#include <string_view>
+#include <vector>
+
+enum class BooleanOperator
+{
+    WORD,
+    AND,
+    OR,
+    NOT,
+};
+
+struct BooleanQueryNode
+{
+    BooleanOperator op;
+    std::string_view word;
+    std::vector<int> children;
+};
+
+// Words joined by AND, OR and NOT and grouped with parentheses; AND binds tighter than OR
+// and is implied between adjacent operands. Nodes refer to their children by index.
+struct BooleanQuery
+{
+    std::vector<BooleanQueryNode> nodes;
+    int root = -1;
+};
+
+BooleanQuery ParseBooleanQuery(std::string_view text);
+
+// Forward-only cursor over ascending document ids of a postings map or a materialized list.
+class DocumentIdCursor
+{
+public:
+    explicit DocumentIdCursor(const std::map<int, double> &postings);
+    explicit DocumentIdCursor(const std::vector<int> &document_ids);
+
+    size_t GetSize() const;
+    bool IsEnd() const;
+    int GetDocumentId() const;
+    // Only for cursors over postings.
+    double GetTermFreq() const;
+    void Next();
+
+    // Moves to the first id not less than document_id: a few steps forward first, then
+    // a tree lookup or a galloping search, so skipping far ahead stays logarithmic.
+    void SeekTo(int document_id);
+
+private:
+    static const int LINEAR_STEP_COUNT = 4;
+
+    const std::map<int, double> *postings_ = nullptr;
+    std::map<int, double>::const_iterator postings_position_;
+    const std::vector<int> *document_ids_ = nullptr;
+    std::vector<int>::const_iterator document_ids_position_;
+};
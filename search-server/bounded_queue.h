@@ -0,0 +1,61 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+template <typename Value>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+    bool Push(Value value)
+    {
+        std::unique_lock lock(mutex_);
+        not_full_.wait(lock, [this]
+                       {
+                           return is_closed_ || values_.size() < capacity_;
+                       });
+        if (is_closed_)
+        {
+            return false;
+        }
+        values_.push_back(std::move(value));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    std::optional<Value> Pop()
+    {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this]
+                        {
+                            return is_closed_ || !values_.empty();
+                        });
+        if (values_.empty())
+        {
+            return std::nullopt;
+        }
+        Value value = std::move(values_.front());
+        values_.pop_front();
+        not_full_.notify_one();
+        return value;
+    }
+
+    void Close()
+    {
+        std::lock_guard lock(mutex_);
+        is_closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<Value> values_;
+    bool is_closed_ = false;
+};
@@ -1,5 +1,7 @@
 #pragma once
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 struct Document
 {
@@ -19,4 +21,12 @@ enum class DocumentStatus
     IRRELEVANT,
     BANNED,
     REMOVED,
+};
+
+struct NewDocument
+{
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
 };
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "document_attributes.h"
+
+void DocumentAttributeIndex::Add(int document_id, int rating, DocumentStatus status, uint32_t word_count)
+{
+    const auto position = std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    const size_t index = position - document_ids_.begin();
+    document_ids_.insert(position, document_id);
+    ratings_.insert(ratings_.begin() + index, rating);
+    statuses_.insert(statuses_.begin() + index, status);
+    word_counts_.insert(word_counts_.begin() + index, word_count);
+    rating_index_.emplace(rating, document_id);
+    UpdateBlocks(index);
+}
+
+void DocumentAttributeIndex::Remove(int document_id)
+{
+    const auto position = std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (position == document_ids_.end() || *position != document_id)
+    {
+        return;
+    }
+    const size_t index = position - document_ids_.begin();
+    rating_index_.erase({ratings_[index], document_id});
+    document_ids_.erase(position);
+    ratings_.erase(ratings_.begin() + index);
+    statuses_.erase(statuses_.begin() + index);
+    word_counts_.erase(word_counts_.begin() + index);
+    UpdateBlocks(index);
+}
+
+std::optional<std::vector<int>> DocumentAttributeIndex::FindByRating(const DocumentFilter &filter, size_t max_count) const
+{
+    std::vector<int> document_ids;
+    for (auto entry = rating_index_.lower_bound({filter.min_rating, std::numeric_limits<int>::min()});
+         entry != rating_index_.end() && entry->first <= filter.max_rating; ++entry)
+    {
+        if (document_ids.size() == max_count)
+        {
+            return std::nullopt;
+        }
+        const size_t index = std::lower_bound(document_ids_.begin(), document_ids_.end(), entry->second) - document_ids_.begin();
+        if (filter(entry->second, statuses_[index], entry->first))
+        {
+            document_ids.push_back(entry->second);
+        }
+    }
+    std::sort(document_ids.begin(), document_ids.end());
+    return document_ids;
+}
+
+size_t DocumentAttributeIndex::GetSize() const
+{
+    return document_ids_.size();
+}
+
+int DocumentAttributeIndex::GetDocumentId(size_t position) const
+{
+    return document_ids_[position];
+}
+
+int DocumentAttributeIndex::GetRating(size_t position) const
+{
+    return ratings_[position];
+}
+
+DocumentStatus DocumentAttributeIndex::GetStatus(size_t position) const
+{
+    return statuses_[position];
+}
+
+uint32_t DocumentAttributeIndex::GetWordCount(size_t position) const
+{
+    return word_counts_[position];
+}
+
+size_t DocumentAttributeIndex::FindPosition(int document_id) const
+{
+    return std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id) - document_ids_.begin();
+}
+
+size_t DocumentAttributeIndex::GetMemoryUsage() const
+{
+    return document_ids_.capacity() * sizeof(int) +
+           ratings_.capacity() * sizeof(int) +
+           statuses_.capacity() * sizeof(DocumentStatus) +
+           word_counts_.capacity() * sizeof(uint32_t) +
+           blocks_.capacity() * sizeof(BlockSummary) +
+           rating_index_.size() * (sizeof(std::pair<int, int>) + 4 * sizeof(void *));
+}
+
+void DocumentAttributeIndex::UpdateBlocks(size_t first_position)
+{
+    const size_t block_count = (document_ids_.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    blocks_.resize(block_count);
+    for (size_t block = first_position / BLOCK_SIZE; block < block_count; ++block)
+    {
+        BlockSummary summary{std::numeric_limits<int>::max(), std::numeric_limits<int>::min(), 0};
+        const size_t last = std::min(document_ids_.size(), (block + 1) * BLOCK_SIZE);
+        for (size_t i = block * BLOCK_SIZE; i < last; ++i)
+        {
+            summary.min_rating = std::min(summary.min_rating, ratings_[i]);
+            summary.max_rating = std::max(summary.max_rating, ratings_[i]);
+            summary.status_mask |= GetStatusBit(statuses_[i]);
+        }
+        blocks_[block] = summary;
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "document_filter.h"
+#include "galloping_search.h"
+
+// Postings are the tree of one word or the merged postings of a prefix, both ascending by id.
+// SeekPosting moves forward from posting to the first one with an id not less than document_id.
+inline std::map<int, double>::const_iterator SeekPosting(const std::map<int, double> &postings,
+                                                          std::map<int, double>::const_iterator posting,
+                                                          int document_id)
+{
+    return posting != postings.end() && posting->first < document_id ? postings.lower_bound(document_id) : posting;
+}
+
+template <typename Postings>
+typename Postings::const_iterator SeekPosting(const Postings &postings, typename Postings::const_iterator posting,
+                                              int document_id)
+{
+    return GallopingLowerBound(posting, postings.end(), document_id,
+                               [](const auto &entry, int id)
+                               {
+                                   return entry.first < id;
+                               });
+}
+
+// Document metadata as id-ordered columns with min/max summaries per block of BLOCK_SIZE
+// documents, plus a rating-ordered index for selective rating ranges.
+class DocumentAttributeIndex
+{
+public:
+    static const size_t BLOCK_SIZE = 128;
+
+    void Add(int document_id, int rating, DocumentStatus status, uint32_t word_count);
+    void Remove(int document_id);
+
+    // Ids in the filter's rating range that pass the whole filter, ascending, unless there
+    // are more than max_count of them.
+    std::optional<std::vector<int>> FindByRating(const DocumentFilter &filter, size_t max_count) const;
+
+    // Calls callback(document_id, term_freq, word_count) for postings passing the filter
+    // until it returns false. Postings in blocks the filter rules out are skipped by seeking.
+    template <typename Postings, typename Callback>
+    void ForEachMatch(const Postings &postings, const DocumentFilter &filter, Callback callback) const;
+
+    // Documents are numbered by position in id order, from 0 to GetSize().
+    size_t GetSize() const;
+    int GetDocumentId(size_t position) const;
+    int GetRating(size_t position) const;
+    DocumentStatus GetStatus(size_t position) const;
+
+    uint32_t GetWordCount(size_t position) const;
+    size_t FindPosition(int document_id) const;
+
+    // Calls callback(position, term_freq) for postings of documents in [first_position,
+    // last_position) until it returns false.
+    template <typename Postings, typename Callback>
+    void ForEachPosition(const Postings &postings, size_t first_position, size_t last_position,
+                         Callback callback) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    struct BlockSummary
+    {
+        int min_rating;
+        int max_rating;
+        uint8_t status_mask;
+    };
+
+    std::vector<int> document_ids_;
+    std::vector<int> ratings_;
+    std::vector<DocumentStatus> statuses_;
+    std::vector<uint32_t> word_counts_;
+    std::vector<BlockSummary> blocks_;
+    std::set<std::pair<int, int>> rating_index_;
+
+    void UpdateBlocks(size_t first_position);
+};
+
+template <typename Postings, typename Callback>
+void DocumentAttributeIndex::ForEachMatch(const Postings &postings, const DocumentFilter &filter,
+                                          Callback callback) const
+{
+    const uint8_t status_mask = filter.GetStatusMask();
+    auto position = document_ids_.begin();
+    auto posting = SeekPosting(postings, postings.begin(), filter.min_document_id);
+    while (posting != postings.end() && posting->first <= filter.max_document_id)
+    {
+        position = GallopingLowerBound(position, document_ids_.end(), posting->first);
+        const size_t index = position - document_ids_.begin();
+        const BlockSummary &block = blocks_[index / BLOCK_SIZE];
+        if (!filter.MatchesBlock(block.min_rating, block.max_rating, block.status_mask))
+        {
+            const size_t next_block = (index / BLOCK_SIZE + 1) * BLOCK_SIZE;
+            if (next_block >= document_ids_.size())
+            {
+                return;
+            }
+            position = document_ids_.begin() + next_block;
+            posting = SeekPosting(postings, posting, *position);
+            continue;
+        }
+        if (ratings_[index] >= filter.min_rating && ratings_[index] <= filter.max_rating &&
+            (status_mask & GetStatusBit(statuses_[index])) != 0 &&
+            !callback(posting->first, posting->second, word_counts_[index]))
+        {
+            return;
+        }
+        ++posting;
+    }
+}
+
+template <typename Postings, typename Callback>
+void DocumentAttributeIndex::ForEachPosition(const Postings &postings, size_t first_position,
+                                             size_t last_position, Callback callback) const
+{
+    if (first_position >= last_position)
+    {
+        return;
+    }
+    auto position = document_ids_.begin() + first_position;
+    const auto last = document_ids_.begin() + last_position;
+    const int last_document_id = *(last - 1);
+    for (auto posting = SeekPosting(postings, postings.begin(), *position);
+         posting != postings.end() && posting->first <= last_document_id; ++posting)
+    {
+        position = GallopingLowerBound(position, last, posting->first);
+        if (!callback(static_cast<size_t>(position - document_ids_.begin()), posting->second))
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#include <algorithm>
+
+#include "document_filter.h"
+
+bool DocumentFilter::operator()(int document_id, DocumentStatus status, int rating) const
+{
+    return document_id >= min_document_id && document_id <= max_document_id &&
+           rating >= min_rating && rating <= max_rating &&
+           (GetStatusMask() & GetStatusBit(status)) != 0;
+}
+
+bool DocumentFilter::MatchesAll() const
+{
+    return statuses.empty() && min_document_id <= 0 && max_document_id == std::numeric_limits<int>::max() &&
+           min_rating == std::numeric_limits<int>::min() && max_rating == std::numeric_limits<int>::max();
+}
+
+uint8_t DocumentFilter::GetStatusMask() const
+{
+    if (statuses.empty())
+    {
+        return std::numeric_limits<uint8_t>::max();
+    }
+    uint8_t mask = 0;
+    for (const DocumentStatus status : statuses)
+    {
+        mask |= GetStatusBit(status);
+    }
+    return mask;
+}
+
+bool DocumentFilter::MatchesBlock(int min_block_rating, int max_block_rating, uint8_t block_status_mask) const
+{
+    return max_block_rating >= min_rating && min_block_rating <= max_rating &&
+           (GetStatusMask() & block_status_mask) != 0;
+}
+
+uint8_t GetStatusBit(DocumentStatus status)
+{
+    return static_cast<uint8_t>(1u << static_cast<int>(status));
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "document.h"
+
+// Declarative alternative to a DocumentPredicate. It can be passed anywhere a predicate is
+// accepted; the sequential and parallel searches then check it against the attribute
+// columns and skip blocks of postings it rules out.
+struct DocumentFilter
+{
+    std::vector<DocumentStatus> statuses;
+    int min_rating = std::numeric_limits<int>::min();
+    int max_rating = std::numeric_limits<int>::max();
+    int min_document_id = 0;
+    int max_document_id = std::numeric_limits<int>::max();
+
+    bool operator()(int document_id, DocumentStatus status, int rating) const;
+    bool MatchesAll() const;
+
+    uint8_t GetStatusMask() const;
+    bool MatchesBlock(int min_block_rating, int max_block_rating, uint8_t block_status_mask) const;
+};
+
+uint8_t GetStatusBit(DocumentStatus status);
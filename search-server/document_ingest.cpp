@@ -0,0 +1,402 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bounded_queue.h"
+#include "document_ingest.h"
+
+namespace
+{
+    // Text of whole records, either in its own buffer or in a mapped file.
+    struct TextChunk
+    {
+        std::vector<char> buffer;
+        std::string_view text;
+    };
+
+    struct ParsedChunk
+    {
+        TextChunk chunk;
+        std::vector<NewDocument> documents;
+        std::vector<SearchServer::TokenizedDocument> tokenized;
+    };
+
+    DocumentStatus ParseStatus(std::string_view field)
+    {
+        if (field == "ACTUAL")
+        {
+            return DocumentStatus::ACTUAL;
+        }
+        if (field == "IRRELEVANT")
+        {
+            return DocumentStatus::IRRELEVANT;
+        }
+        if (field == "BANNED")
+        {
+            return DocumentStatus::BANNED;
+        }
+        if (field == "REMOVED")
+        {
+            return DocumentStatus::REMOVED;
+        }
+        throw std::invalid_argument("Unknown document status "s + std::string(field));
+    }
+
+    int ParseInt(std::string_view field)
+    {
+        int value = 0;
+        const auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value);
+        if (field.empty() || error != std::errc() || end != field.data() + field.size())
+        {
+            throw std::invalid_argument("Invalid number "s + std::string(field));
+        }
+        return value;
+    }
+
+    std::string_view NextField(std::string_view &line)
+    {
+        const auto tab = line.find('\t');
+        if (tab == line.npos)
+        {
+            throw std::invalid_argument("Document record has too few fields"s);
+        }
+        const std::string_view field = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+        return field;
+    }
+
+    NewDocument ParseRecord(std::string_view line)
+    {
+        NewDocument document;
+        document.id = ParseInt(NextField(line));
+        document.status = ParseStatus(NextField(line));
+        for (std::string_view rating : SplitIntoWords(NextField(line)))
+        {
+            document.ratings.push_back(ParseInt(rating));
+        }
+        document.text = line;
+        return document;
+    }
+
+    void CheckLineLength(size_t length, const IngestOptions &options)
+    {
+        if (length > options.max_line_length)
+        {
+            throw std::invalid_argument("Document record is longer than "s + std::to_string(options.max_line_length) +
+                                        " bytes"s);
+        }
+    }
+
+    ParsedChunk ParseChunk(TextChunk chunk, const IngestOptions &options)
+    {
+        ParsedChunk parsed;
+        parsed.chunk = std::move(chunk);
+
+        std::string_view rest = parsed.chunk.text;
+        while (!rest.empty())
+        {
+            const auto line_end = rest.find('\n');
+            std::string_view line = rest.substr(0, line_end);
+            rest.remove_prefix(line_end == rest.npos ? rest.size() : line_end + 1);
+            CheckLineLength(line.size(), options);
+
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
+            if (!line.empty())
+            {
+                parsed.documents.push_back(ParseRecord(line));
+            }
+        }
+        return parsed;
+    }
+
+    // Reads big blocks and cuts them at the last line break, so every chunk holds whole records.
+    void ReadChunks(std::istream &input, const IngestOptions &options, BoundedQueue<TextChunk> &chunks)
+    {
+        std::vector<char> carry;
+        while (input)
+        {
+            std::vector<char> buffer(std::move(carry));
+            const size_t carried = buffer.size();
+            buffer.resize(carried + options.chunk_size);
+            input.read(buffer.data() + carried, options.chunk_size);
+            buffer.resize(carried + static_cast<size_t>(input.gcount()));
+
+            carry.clear();
+            if (input)
+            {
+                const auto last_line_end = std::find(buffer.rbegin(), buffer.rend(), '\n');
+                if (last_line_end == buffer.rend())
+                {
+                    CheckLineLength(buffer.size(), options);
+                    carry = std::move(buffer);
+                    continue;
+                }
+                carry.assign(last_line_end.base(), buffer.end());
+                buffer.erase(last_line_end.base(), buffer.end());
+            }
+            if (buffer.empty())
+            {
+                continue;
+            }
+            TextChunk chunk;
+            chunk.buffer = std::move(buffer);
+            chunk.text = {chunk.buffer.data(), chunk.buffer.size()};
+            if (!chunks.Push(std::move(chunk)))
+            {
+                break;
+            }
+        }
+    }
+
+    // Cuts text that is already in memory into chunks of whole records without copying it.
+    void SplitChunks(std::string_view text, const IngestOptions &options, BoundedQueue<TextChunk> &chunks)
+    {
+        while (!text.empty())
+        {
+            size_t size = text.size();
+            if (size > options.chunk_size)
+            {
+                const auto last_line_end = text.rfind('\n', options.chunk_size - 1);
+                const auto line_end = last_line_end != text.npos ? last_line_end : text.find('\n');
+                size = line_end == text.npos ? text.size() : line_end + 1;
+            }
+            TextChunk chunk;
+            chunk.text = text.substr(0, size);
+            text.remove_prefix(size);
+            if (!chunks.Push(std::move(chunk)))
+            {
+                break;
+            }
+        }
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string &path)
+        {
+            const int descriptor = open(path.c_str(), O_RDONLY);
+            if (descriptor < 0)
+            {
+                throw std::invalid_argument("Cannot open "s + path);
+            }
+            struct stat file_status;
+            if (fstat(descriptor, &file_status) == 0 && S_ISREG(file_status.st_mode) && file_status.st_size > 0)
+            {
+                void *data = mmap(nullptr, static_cast<size_t>(file_status.st_size), PROT_READ, MAP_PRIVATE,
+                                  descriptor, 0);
+                if (data != MAP_FAILED)
+                {
+                    data_ = data;
+                    size_ = static_cast<size_t>(file_status.st_size);
+                    madvise(data_, size_, MADV_SEQUENTIAL);
+                }
+            }
+            close(descriptor);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile()
+        {
+            if (data_)
+            {
+                munmap(data_, size_);
+            }
+        }
+
+        bool IsMapped() const
+        {
+            return data_ != nullptr;
+        }
+
+        std::string_view GetText() const
+        {
+            return {static_cast<const char *>(data_), size_};
+        }
+
+    private:
+        void *data_ = nullptr;
+        size_t size_ = 0;
+    };
+#endif
+
+    template <typename ChunkReader>
+    IngestStats RunPipeline(SearchServer &search_server, const IngestOptions &options, ChunkReader read_chunks)
+    {
+        const auto start_time = std::chrono::steady_clock::now();
+        IngestStats stats;
+
+        BoundedQueue<TextChunk> chunks(options.queue_capacity);
+        BoundedQueue<ParsedChunk> parsed_chunks(options.queue_capacity);
+        BoundedQueue<ParsedChunk> tokenized_chunks(options.queue_capacity);
+        std::exception_ptr reader_error;
+        std::exception_ptr parser_error;
+        std::exception_ptr tokenizer_error;
+        std::exception_ptr indexer_error;
+
+        std::thread reader([&]
+                           {
+                               try
+                               {
+                                   read_chunks(chunks);
+                               }
+                               catch (...)
+                               {
+                                   reader_error = std::current_exception();
+                               }
+                               chunks.Close();
+                           });
+
+        std::thread parser([&]
+                           {
+                               try
+                               {
+                                   while (auto chunk = chunks.Pop())
+                                   {
+                                       if (!parsed_chunks.Push(ParseChunk(std::move(*chunk), options)))
+                                       {
+                                           break;
+                                       }
+                                   }
+                               }
+                               catch (...)
+                               {
+                                   parser_error = std::current_exception();
+                                   chunks.Close();
+                               }
+                               parsed_chunks.Close();
+                           });
+
+        std::thread tokenizer([&]
+                              {
+                                  try
+                                  {
+                                      while (auto parsed = parsed_chunks.Pop())
+                                      {
+                                          parsed->tokenized = search_server.TokenizeDocuments(std::execution::par,
+                                                                                              parsed->documents);
+                                          if (!tokenized_chunks.Push(std::move(*parsed)))
+                                          {
+                                              break;
+                                          }
+                                      }
+                                  }
+                                  catch (...)
+                                  {
+                                      tokenizer_error = std::current_exception();
+                                      parsed_chunks.Close();
+                                      chunks.Close();
+                                  }
+                                  tokenized_chunks.Close();
+                              });
+
+        try
+        {
+            while (auto parsed = tokenized_chunks.Pop())
+            {
+                search_server.AddDocuments(std::execution::par, parsed->documents, parsed->tokenized);
+                stats.document_count += parsed->documents.size();
+                stats.byte_count += parsed->chunk.text.size();
+            }
+        }
+        catch (...)
+        {
+            indexer_error = std::current_exception();
+            tokenized_chunks.Close();
+            parsed_chunks.Close();
+            chunks.Close();
+        }
+
+        reader.join();
+        parser.join();
+        tokenizer.join();
+
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        for (const auto &error : {reader_error, parser_error, tokenizer_error, indexer_error})
+        {
+            if (!error)
+            {
+                continue;
+            }
+            try
+            {
+                std::rethrow_exception(error);
+            }
+            catch (const std::exception &exception)
+            {
+                std::throw_with_nested(IngestError("Ingest stopped after "s + std::to_string(stats.document_count) +
+                                                       " documents: "s + exception.what(),
+                                                   stats));
+            }
+        }
+        return stats;
+    }
+}
+
+IngestError::IngestError(const std::string &message, const IngestStats &committed) : std::runtime_error(message),
+                                                                                      committed_(committed) {}
+
+const IngestStats &IngestError::GetCommittedStats() const
+{
+    return committed_;
+}
+
+double IngestStats::GetDocumentsPerSecond() const
+{
+    return seconds > 0.0 ? document_count / seconds : 0.0;
+}
+
+IngestStats IngestDocuments(SearchServer &search_server, std::istream &input, const IngestOptions &options)
+{
+    return RunPipeline(search_server, options,
+                       [&input, &options](BoundedQueue<TextChunk> &chunks)
+                       {
+                           ReadChunks(input, options, chunks);
+                       });
+}
+
+IngestStats IngestDocumentsFromFile(SearchServer &search_server, const std::string &path, const IngestOptions &options)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    const MappedFile file(path);
+    if (file.IsMapped())
+    {
+        return RunPipeline(search_server, options,
+                           [&file, &options](BoundedQueue<TextChunk> &chunks)
+                           {
+                               SplitChunks(file.GetText(), options, chunks);
+                           });
+    }
+#endif
+    std::ifstream input(path, std::ios::binary);
+    if (!input)
+    {
+        throw std::invalid_argument("Cannot open "s + path);
+    }
+    return IngestDocuments(search_server, input, options);
+}
+
+std::ostream &operator<<(std::ostream &out, const IngestStats &stats)
+{
+    out << "{ documents = "s << stats.document_count
+        << ", bytes = "s << stats.byte_count
+        << ", seconds = "s << stats.seconds
+        << ", documents_per_second = "s << stats.GetDocumentsPerSecond() << " }"s;
+    return out;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "search_server.h"
+
+// Input is one document per line: id<TAB>status<TAB>ratings<TAB>text,
+// where status is ACTUAL, IRRELEVANT, BANNED or REMOVED and ratings are space separated.
+struct IngestOptions
+{
+    size_t chunk_size = 4 << 20;
+    size_t queue_capacity = 4;
+    // Bounds the text a reader buffers while looking for the end of a record.
+    size_t max_line_length = 1 << 20;
+};
+
+struct IngestStats
+{
+    size_t document_count = 0;
+    size_t byte_count = 0;
+    double seconds = 0.0;
+
+    double GetDocumentsPerSecond() const;
+};
+
+// Thrown when a stage of the pipeline fails, with the original exception nested. Every chunk
+// is added as one batch, so the server keeps exactly the documents of the committed stats.
+class IngestError : public std::runtime_error
+{
+public:
+    IngestError(const std::string &message, const IngestStats &committed);
+
+    const IngestStats &GetCommittedStats() const;
+
+private:
+    IngestStats committed_;
+};
+
+// Reading, parsing, tokenizing and indexing run on their own threads, passing chunks of whole
+// records through bounded queues. IngestDocumentsFromFile maps regular files into memory and
+// parses the records in place instead of copying them into chunks.
+IngestStats IngestDocuments(SearchServer &search_server, std::istream &input, const IngestOptions &options = {});
+IngestStats IngestDocumentsFromFile(SearchServer &search_server, const std::string &path, const IngestOptions &options = {});
+
+std::ostream &operator<<(std::ostream &out, const IngestStats &stats);
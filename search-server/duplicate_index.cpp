@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "duplicate_index.h"
+
+using namespace std::string_literals;
+
+namespace
+{
+    uint64_t MixBits(uint64_t value)
+    {
+        value += 0x9E3779B97F4A7C15ULL;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    void EraseFromBucket(std::unordered_map<uint64_t, std::vector<int>> &buckets, uint64_t key, int document_id)
+    {
+        const auto bucket = buckets.find(key);
+        if (bucket == buckets.end())
+        {
+            return;
+        }
+        auto &document_ids = bucket->second;
+        document_ids.erase(std::find(document_ids.begin(), document_ids.end(), document_id));
+        if (document_ids.empty())
+        {
+            buckets.erase(bucket);
+        }
+    }
+}
+
+DuplicateIndex::DuplicateIndex(int band_count, int rows_per_band) : band_count_(band_count),
+                                                                    rows_per_band_(rows_per_band),
+                                                                    band_buckets_(band_count > 0 ? band_count : 0)
+{
+    if (band_count < 1 || rows_per_band < 1)
+    {
+        throw std::invalid_argument("LSH needs at least one band with one row"s);
+    }
+    for (int i = 0; i < band_count * rows_per_band; ++i)
+    {
+        seeds_.push_back(MixBits(i + 1));
+    }
+}
+
+void DuplicateIndex::Add(int document_id, const TermFrequency *begin, const TermFrequency *end)
+{
+    Fingerprint fingerprint{HashTermSet(begin, end), {}};
+
+    for (int band = 0; band < band_count_; ++band)
+    {
+        uint64_t band_hash = MixBits(band);
+        for (int row = 0; row < rows_per_band_; ++row)
+        {
+            const uint64_t seed = seeds_[band * rows_per_band_ + row];
+            uint64_t min_hash = std::numeric_limits<uint64_t>::max();
+            for (auto term = begin; term != end; ++term)
+            {
+                min_hash = std::min(min_hash, MixBits(static_cast<uint64_t>(term->term_id) ^ seed));
+            }
+            band_hash = MixBits(band_hash ^ min_hash);
+        }
+        fingerprint.band_hashes.push_back(band_hash);
+        band_buckets_[band][band_hash].push_back(document_id);
+    }
+
+    exact_buckets_[fingerprint.set_hash].push_back(document_id);
+    fingerprints_.emplace(document_id, std::move(fingerprint));
+}
+
+void DuplicateIndex::Remove(int document_id)
+{
+    const auto fingerprint = fingerprints_.find(document_id);
+    if (fingerprint == fingerprints_.end())
+    {
+        return;
+    }
+    EraseFromBucket(exact_buckets_, fingerprint->second.set_hash, document_id);
+    for (int band = 0; band < band_count_; ++band)
+    {
+        EraseFromBucket(band_buckets_[band], fingerprint->second.band_hashes[band], document_id);
+    }
+    fingerprints_.erase(fingerprint);
+}
+
+bool DuplicateIndex::ShareEarlierBand(int lhs_document_id, int rhs_document_id, int band) const
+{
+    const auto &lhs_hashes = fingerprints_.at(lhs_document_id).band_hashes;
+    const auto &rhs_hashes = fingerprints_.at(rhs_document_id).band_hashes;
+    for (int earlier_band = 0; earlier_band < band; ++earlier_band)
+    {
+        if (lhs_hashes[earlier_band] == rhs_hashes[earlier_band])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t DuplicateIndex::GetMemoryUsage() const
+{
+    size_t bytes = seeds_.capacity() * sizeof(uint64_t) +
+                   fingerprints_.size() * (sizeof(std::pair<const int, Fingerprint>) + 4 * sizeof(void *) +
+                                           band_count_ * sizeof(uint64_t));
+    const auto bucket_bytes = [](const std::unordered_map<uint64_t, std::vector<int>> &buckets)
+    {
+        size_t bytes = buckets.bucket_count() * sizeof(void *);
+        for (const auto &[key, document_ids] : buckets)
+        {
+            bytes += sizeof(std::pair<const uint64_t, std::vector<int>>) + sizeof(void *) +
+                     document_ids.capacity() * sizeof(int);
+        }
+        return bytes;
+    };
+    bytes += bucket_bytes(exact_buckets_);
+    for (const auto &buckets : band_buckets_)
+    {
+        bytes += bucket_bytes(buckets);
+    }
+    return bytes;
+}
+
+uint64_t DuplicateIndex::HashTermSet(const TermFrequency *begin, const TermFrequency *end)
+{
+    uint64_t hash = MixBits(end - begin);
+    for (auto term = begin; term != end; ++term)
+    {
+        hash = MixBits(hash ^ static_cast<uint64_t>(term->term_id));
+    }
+    return hash;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "word_frequencies_view.h"
+
+// Per-document fingerprints of term sets: a hash of the whole set for exact duplicates and
+// a MinHash signature split into LSH bands for near duplicates. Documents sharing a bucket
+// are only candidates; SearchServer verifies them against the forward index.
+class DuplicateIndex
+{
+public:
+    DuplicateIndex(int band_count, int rows_per_band);
+
+    void Add(int document_id, const TermFrequency *begin, const TermFrequency *end);
+    void Remove(int document_id);
+
+    template <typename Callback>
+    void ForEachExactCandidates(Callback callback) const;
+
+    // Calls callback(band, document_ids) for every band bucket shared by several documents.
+    template <typename Callback>
+    void ForEachSimilarCandidates(Callback callback) const;
+    // True if the documents already share a bucket in a band before the given one.
+    bool ShareEarlierBand(int lhs_document_id, int rhs_document_id, int band) const;
+
+    size_t GetMemoryUsage() const;
+
+    static uint64_t HashTermSet(const TermFrequency *begin, const TermFrequency *end);
+
+private:
+    struct Fingerprint
+    {
+        uint64_t set_hash;
+        std::vector<uint64_t> band_hashes;
+    };
+
+    int band_count_;
+    int rows_per_band_;
+    std::vector<uint64_t> seeds_;
+    std::map<int, Fingerprint> fingerprints_;
+    std::unordered_map<uint64_t, std::vector<int>> exact_buckets_;
+    std::vector<std::unordered_map<uint64_t, std::vector<int>>> band_buckets_;
+};
+
+template <typename Callback>
+void DuplicateIndex::ForEachExactCandidates(Callback callback) const
+{
+    for (const auto &[set_hash, document_ids] : exact_buckets_)
+    {
+        if (document_ids.size() > 1)
+        {
+            callback(document_ids);
+        }
+    }
+}
+
+template <typename Callback>
+void DuplicateIndex::ForEachSimilarCandidates(Callback callback) const
+{
+    for (int band = 0; band < band_count_; ++band)
+    {
+        for (const auto &[band_hash, document_ids] : band_buckets_[band])
+        {
+            if (document_ids.size() > 1)
+            {
+                callback(band, document_ids);
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+#include "facet.h"
+
+using namespace std::string_literals;
+
+namespace
+{
+    const size_t STATUS_COUNT = static_cast<size_t>(DocumentStatus::REMOVED) + 1;
+}
+
+FacetResult::FacetResult(const FacetDimensions &dimensions)
+    : rating_bounds(dimensions.rating_bounds),
+      counts(dimensions.by_status ? STATUS_COUNT : 1, std::vector<size_t>(dimensions.rating_bounds.size() + 1, 0))
+{
+    if (!std::is_sorted(rating_bounds.begin(), rating_bounds.end()))
+    {
+        throw std::invalid_argument("Rating bounds must be sorted"s);
+    }
+}
+
+void FacetResult::Add(DocumentStatus status, int rating)
+{
+    const size_t row = counts.size() == 1 ? 0 : static_cast<size_t>(status);
+    const size_t rating_bucket = std::upper_bound(rating_bounds.begin(), rating_bounds.end(), rating) - rating_bounds.begin();
+    ++counts[row][rating_bucket];
+}
+
+void FacetResult::Merge(const FacetResult &other)
+{
+    for (size_t row = 0; row < counts.size(); ++row)
+    {
+        for (size_t rating_bucket = 0; rating_bucket < counts[row].size(); ++rating_bucket)
+        {
+            counts[row][rating_bucket] += other.counts[row][rating_bucket];
+        }
+    }
+}
+
+size_t FacetResult::GetDocumentCount() const
+{
+    size_t document_count = 0;
+    for (const auto &row : counts)
+    {
+        document_count = std::accumulate(row.begin(), row.end(), document_count);
+    }
+    return document_count;
+}
+
+size_t FacetResult::GetStatusCount(DocumentStatus status) const
+{
+    if (counts.size() != STATUS_COUNT)
+    {
+        throw std::invalid_argument("Facet is not split by status"s);
+    }
+    const auto &row = counts[static_cast<size_t>(status)];
+    return std::accumulate(row.begin(), row.end(), size_t{0});
+}
+
+size_t FacetResult::GetRatingBucketCount(size_t rating_bucket) const
+{
+    size_t document_count = 0;
+    for (const auto &row : counts)
+    {
+        document_count += row.at(rating_bucket);
+    }
+    return document_count;
+}
+
+std::ostream &operator<<(std::ostream &out, const FacetResult &result)
+{
+    out << "{ document_count = "s << result.GetDocumentCount() << ", counts = [ "s;
+    for (size_t row = 0; row < result.counts.size(); ++row)
+    {
+        out << (row > 0 ? ", [ "s : "[ "s);
+        for (size_t rating_bucket = 0; rating_bucket < result.counts[row].size(); ++rating_bucket)
+        {
+            out << (rating_bucket > 0 ? ", "s : ""s) << result.counts[row][rating_bucket];
+        }
+        out << " ]"s;
+    }
+    out << " ] }"s;
+    return out;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include "document.h"
+
+// Rating bucket 0 holds ratings below rating_bounds[0], bucket i ratings in
+// [rating_bounds[i - 1], rating_bounds[i]) and the last bucket the rest.
+struct FacetDimensions
+{
+    bool by_status = true;
+    std::vector<int> rating_bounds;
+};
+
+// Matched document counts, one row per status (or a single row) and one column per rating bucket.
+struct FacetResult
+{
+    FacetResult() = default;
+    explicit FacetResult(const FacetDimensions &dimensions);
+
+    std::vector<int> rating_bounds;
+    std::vector<std::vector<size_t>> counts;
+
+    void Add(DocumentStatus status, int rating);
+    void Merge(const FacetResult &other);
+
+    size_t GetDocumentCount() const;
+    size_t GetStatusCount(DocumentStatus status) const;
+    size_t GetRatingBucketCount(size_t rating_bucket) const;
+};
+
+std::ostream &operator<<(std::ostream &out, const FacetResult &result);
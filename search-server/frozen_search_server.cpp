@@ -0,0 +1,420 @@
+#include <cstring>
+#include <functional>
+
+#include "frozen_search_server.h"
+#include "galloping_search.h"
+#include "index_file.h"
+
+FrozenSearchServer::FrozenSearchServer(const SearchServer &search_server)
+    : query_parser_(search_server.stop_words_),
+      average_word_count_(search_server.GetAverageWordCount())
+{
+    if (search_server.fuzzy_search_enabled_ || search_server.positional_index_enabled_)
+    {
+        throw std::invalid_argument("A server with fuzzy search or a positional index cannot be frozen"s);
+    }
+    const size_t document_count = search_server.documents_.size();
+    document_ids_.reserve(document_count);
+    ratings_.reserve(document_count);
+    statuses_.reserve(document_count);
+    word_counts_.reserve(document_count);
+    for (const auto &[document_id, document_data] : search_server.documents_)
+    {
+        document_ids_.push_back(document_id);
+        ratings_.push_back(document_data.rating);
+        statuses_.push_back(document_data.status);
+        word_counts_.push_back(document_data.word_count);
+    }
+
+    size_t term_count = 0;
+    size_t posting_count = 0;
+    size_t text_size = 0;
+    for (const auto &[word, postings] : search_server.word_to_document_freqs_)
+    {
+        if (!postings.empty())
+        {
+            ++term_count;
+            posting_count += postings.size();
+            text_size += word.size();
+        }
+    }
+    terms_text_.reserve(text_size);
+    term_words_.reserve(term_count);
+    posting_offsets_.reserve(term_count + 1);
+    posting_positions_.reserve(posting_count);
+    posting_freqs_.reserve(posting_count);
+
+    for (const auto &[word, postings] : search_server.word_to_document_freqs_)
+    {
+        if (postings.empty())
+        {
+            continue;
+        }
+        term_words_.emplace_back(terms_text_.data() + terms_text_.size(), word.size());
+        terms_text_.insert(terms_text_.end(), word.begin(), word.end());
+
+        auto position = document_ids_.begin();
+        for (const auto &[document_id, term_freq] : postings)
+        {
+            position = std::lower_bound(position, document_ids_.end(), document_id);
+            posting_positions_.push_back(static_cast<uint32_t>(position - document_ids_.begin()));
+            posting_freqs_.push_back(term_freq);
+        }
+        posting_offsets_.push_back(posting_positions_.size());
+    }
+
+    forward_offsets_.assign(document_count + 1, 0);
+    for (const uint32_t position : posting_positions_)
+    {
+        ++forward_offsets_[position + 1];
+    }
+    std::partial_sum(forward_offsets_.begin(), forward_offsets_.end(), forward_offsets_.begin());
+    forward_index_.resize(posting_count);
+    std::vector<size_t> forward_ends(forward_offsets_.begin(), forward_offsets_.end() - 1);
+    for (uint32_t term = 0; term < term_count; ++term)
+    {
+        for (size_t i = posting_offsets_[term]; i < posting_offsets_[term + 1]; ++i)
+        {
+            const size_t entry = forward_ends[posting_positions_[i]]++;
+            forward_index_[entry] = {static_cast<int>(term), posting_freqs_[i]};
+        }
+    }
+
+    BuildTermDirectory();
+}
+
+FrozenSearchServer::FrozenSearchServer(SearchServer &&search_server)
+    : FrozenSearchServer(static_cast<const SearchServer &>(search_server))
+{
+    SearchServer released(std::move(search_server));
+}
+
+FrozenSearchServer::FrozenSearchServer(const std::set<std::string, std::less<>> &stop_words)
+    : query_parser_(stop_words)
+{
+}
+
+FrozenSearchServer FrozenSearchServer::OpenIndex(const std::string &index_path)
+{
+    auto posting_file = std::make_unique<PostingFile>();
+    posting_file->input.open(index_path, std::ios::binary);
+    std::ifstream &input = posting_file->input;
+    FrozenSearchServer server(ReadIndexHeader(input, index_path));
+
+    std::vector<IndexDocument> documents(ReadBinary<uint64_t>(input));
+    uint64_t total_word_count = 0;
+    for (auto &document : documents)
+    {
+        document = ReadIndexDocument(input);
+        total_word_count += document.word_count;
+    }
+    std::sort(documents.begin(), documents.end(),
+              [](const IndexDocument &lhs, const IndexDocument &rhs)
+              {
+                  return lhs.id < rhs.id;
+              });
+    server.document_ids_.reserve(documents.size());
+    server.ratings_.reserve(documents.size());
+    server.statuses_.reserve(documents.size());
+    server.word_counts_.reserve(documents.size());
+    for (const auto &document : documents)
+    {
+        if (!server.document_ids_.empty() && server.document_ids_.back() == document.id)
+        {
+            throw std::invalid_argument("Invalid document ID"s);
+        }
+        server.document_ids_.push_back(document.id);
+        server.ratings_.push_back(document.rating);
+        server.statuses_.push_back(document.status);
+        server.word_counts_.push_back(document.word_count);
+    }
+    server.average_word_count_ = documents.empty() ? 0.0 : static_cast<double>(total_word_count) / documents.size();
+    std::vector<IndexDocument>().swap(documents);
+
+    input.seekg(-static_cast<std::streamoff>(sizeof(uint64_t)), std::ios::end);
+    input.seekg(static_cast<std::streamoff>(ReadBinary<uint64_t>(input)));
+    std::vector<size_t> term_offsets = {0};
+    std::string previous_term;
+    for (auto count = ReadBinary<uint64_t>(input); count > 0; --count)
+    {
+        const IndexTermEntry entry = ReadIndexTermEntry(input);
+        if (entry.term.empty() || (term_offsets.size() > 1 && entry.term <= previous_term))
+        {
+            throw std::invalid_argument("Invalid term in index file"s);
+        }
+        server.terms_text_.insert(server.terms_text_.end(), entry.term.begin(), entry.term.end());
+        term_offsets.push_back(server.terms_text_.size());
+        server.posting_offsets_.push_back(server.posting_offsets_.back() + entry.posting_count);
+        server.posting_file_offsets_.push_back(entry.posting_offset);
+        previous_term = entry.term;
+    }
+    server.term_words_.reserve(term_offsets.size() - 1);
+    for (size_t term = 0; term + 1 < term_offsets.size(); ++term)
+    {
+        server.term_words_.emplace_back(server.terms_text_.data() + term_offsets[term],
+                                        term_offsets[term + 1] - term_offsets[term]);
+    }
+    server.BuildTermDirectory();
+    server.posting_file_ = std::move(posting_file);
+    return server;
+}
+
+int FrozenSearchServer::GetDocumentCount() const
+{
+    return static_cast<int>(document_ids_.size());
+}
+
+std::vector<int>::const_iterator FrozenSearchServer::begin() const
+{
+    return document_ids_.begin();
+}
+
+std::vector<int>::const_iterator FrozenSearchServer::end() const
+{
+    return document_ids_.end();
+}
+
+WordFrequenciesView FrozenSearchServer::GetWordFrequencies(int document_id) const
+{
+    if (posting_file_)
+    {
+        throw std::logic_error("Word frequencies are not loaded from an index file"s);
+    }
+    const auto document = FindDocument(document_id);
+    if (!document)
+    {
+        return {};
+    }
+    return {forward_index_.data() + forward_offsets_[*document],
+            forward_index_.data() + forward_offsets_[*document + 1],
+            term_words_};
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> FrozenSearchServer::MatchDocument(std::string_view raw_query,
+                                                                                            int document_id) const
+{
+    return MatchDocument(std::execution::seq, raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> FrozenSearchServer::MatchDocument(const std::execution::sequenced_policy &,
+                                                                                            std::string_view raw_query,
+                                                                                            int document_id) const
+{
+    const auto document = FindDocument(document_id);
+    if (document_id < 0 || !document)
+    {
+        throw std::invalid_argument("Non-existent document ID"s);
+    }
+
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena);
+    const DocumentStatus status = statuses_[*document];
+    const auto contains = [this, &document](std::string_view word)
+    {
+        const auto term = FindTerm(word);
+        if (!term)
+        {
+            return false;
+        }
+        if (!posting_file_)
+        {
+            const auto terms_begin = forward_index_.begin() + forward_offsets_[*document];
+            const auto terms_end = forward_index_.begin() + forward_offsets_[*document + 1];
+            return std::binary_search(terms_begin, terms_end, TermFrequency{static_cast<int>(*term), 0.0},
+                                      [](const TermFrequency &lhs, const TermFrequency &rhs)
+                                      {
+                                          return lhs.term_id < rhs.term_id;
+                                      });
+        }
+        return ContainsPosting(*term, *document);
+    };
+
+    for (const std::string_view word : query.minus_words)
+    {
+        if (contains(word))
+        {
+            return {std::vector<std::string_view>{}, status};
+        }
+    }
+
+    std::vector<std::string_view> matched_words;
+    for (const std::string_view word : query.plus_words)
+    {
+        if (contains(word))
+        {
+            matched_words.push_back(GetTerm(*FindTerm(word)));
+        }
+    }
+    return {matched_words, status};
+}
+
+MemoryUsage FrozenSearchServer::GetMemoryUsage() const
+{
+    MemoryUsage usage;
+    usage.posting_lists = posting_offsets_.capacity() * sizeof(size_t) +
+                          posting_positions_.capacity() * sizeof(uint32_t) +
+                          posting_freqs_.capacity() * sizeof(double);
+    usage.forward_index = forward_offsets_.capacity() * sizeof(size_t) +
+                          forward_index_.capacity() * sizeof(TermFrequency);
+    usage.documents = ratings_.capacity() * sizeof(int) +
+                      statuses_.capacity() * sizeof(DocumentStatus) +
+                      word_counts_.capacity() * sizeof(uint32_t);
+    usage.document_ids = document_ids_.capacity() * sizeof(int);
+    usage.posting_lists += posting_file_offsets_.capacity() * sizeof(uint64_t);
+    usage.term_dictionary = terms_text_.capacity() +
+                            term_words_.capacity() * sizeof(std::string_view) +
+                            term_directory_.capacity() * sizeof(uint32_t);
+    return usage;
+}
+
+void FrozenSearchServer::BuildTermDirectory()
+{
+    // Open addressing with linear probing, at most half full; a slot holds term + 1 or 0.
+    const size_t term_count = term_words_.size();
+    size_t slot_count = 1;
+    while (slot_count < term_count * 2)
+    {
+        slot_count *= 2;
+    }
+    term_directory_.assign(slot_count, 0);
+    for (uint32_t term = 0; term < term_count; ++term)
+    {
+        size_t slot = std::hash<std::string_view>{}(GetTerm(term)) & (slot_count - 1);
+        while (term_directory_[slot] != 0)
+        {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        term_directory_[slot] = term + 1;
+    }
+}
+
+std::optional<uint32_t> FrozenSearchServer::FindTerm(std::string_view word) const
+{
+    const size_t mask = term_directory_.size() - 1;
+    for (size_t slot = std::hash<std::string_view>{}(word) & mask; term_directory_[slot] != 0; slot = (slot + 1) & mask)
+    {
+        const uint32_t term = term_directory_[slot] - 1;
+        if (GetTerm(term) == word)
+        {
+            return term;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string_view FrozenSearchServer::GetTerm(uint32_t term) const
+{
+    return term_words_[term];
+}
+
+std::optional<uint32_t> FrozenSearchServer::FindDocument(int document_id) const
+{
+    const auto position = std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (position == document_ids_.end() || *position != document_id)
+    {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(position - document_ids_.begin());
+}
+
+SearchServer::Query FrozenSearchServer::ParseQuery(std::string_view raw_query, QueryArena &arena) const
+{
+    for (std::string_view word : SplitIntoWords(raw_query))
+    {
+        if (word[0] == '"' || (word.size() > 1 && word.back() == '*'))
+        {
+            throw std::invalid_argument("Phrase and prefix queries are not supported by the frozen index"s);
+        }
+    }
+    return query_parser_.ParseQuery(raw_query, arena);
+}
+
+size_t FrozenSearchServer::GetRangeCount(const std::execution::sequenced_policy &) const
+{
+    return 1;
+}
+
+size_t FrozenSearchServer::GetRangeCount(const std::execution::parallel_policy &) const
+{
+    return std::clamp<size_t>(std::max<size_t>(std::thread::hardware_concurrency(), 1) * 4, 1,
+                              std::max<size_t>(document_ids_.size() / SearchServer::MIN_DOCUMENTS_PER_RANGE, 1));
+}
+
+FrozenSearchServer::PostingSpan FrozenSearchServer::GetPostings(uint32_t term, PostingBuffer &buffer) const
+{
+    const size_t first_posting = posting_offsets_[term];
+    const size_t count = posting_offsets_[term + 1] - first_posting;
+    if (!posting_file_)
+    {
+        return {posting_positions_.data() + first_posting, posting_freqs_.data() + first_posting, count};
+    }
+
+    buffer.bytes.resize(count * INDEX_POSTING_SIZE);
+    {
+        std::lock_guard lock(posting_file_->mutex);
+        std::ifstream &input = posting_file_->input;
+        input.clear();
+        input.seekg(static_cast<std::streamoff>(posting_file_offsets_[term]));
+        if (!input.read(buffer.bytes.data(), static_cast<std::streamsize>(buffer.bytes.size())))
+        {
+            throw std::invalid_argument("Unexpected end of index file"s);
+        }
+    }
+    buffer.positions.resize(count);
+    buffer.term_freqs.resize(count);
+    auto position = document_ids_.begin();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const char *posting = buffer.bytes.data() + i * INDEX_POSTING_SIZE;
+        int document_id;
+        std::memcpy(&document_id, posting, sizeof(document_id));
+        std::memcpy(&buffer.term_freqs[i], posting + sizeof(document_id), sizeof(double));
+        position = GallopingLowerBound(position, document_ids_.end(), document_id);
+        if (position == document_ids_.end() || *position != document_id)
+        {
+            throw std::invalid_argument("Invalid document in index file"s);
+        }
+        buffer.positions[i] = static_cast<uint32_t>(position - document_ids_.begin());
+    }
+    return {buffer.positions.data(), buffer.term_freqs.data(), count};
+}
+
+bool FrozenSearchServer::ContainsPosting(uint32_t term, uint32_t position) const
+{
+    // Postings in the file are sorted by document id, so a binary search reads one id per step.
+    const int document_id = document_ids_[position];
+    size_t first = 0;
+    size_t last = posting_offsets_[term + 1] - posting_offsets_[term];
+    std::lock_guard lock(posting_file_->mutex);
+    std::ifstream &input = posting_file_->input;
+    input.clear();
+    while (first < last)
+    {
+        const size_t middle = first + (last - first) / 2;
+        input.seekg(static_cast<std::streamoff>(posting_file_offsets_[term] + middle * INDEX_POSTING_SIZE));
+        const int posting_document_id = ReadBinary<int>(input);
+        if (posting_document_id == document_id)
+        {
+            return true;
+        }
+        if (posting_document_id < document_id)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+    return false;
+}
+
+std::pair<size_t, size_t> FrozenSearchServer::FindRangePostings(const PostingSpan &postings,
+                                                                size_t first_position, size_t last_position) const
+{
+    const uint32_t *postings_end = postings.positions + postings.count;
+    const uint32_t *first = first_position == 0 ? postings.positions
+                                                : std::lower_bound(postings.positions, postings_end, first_position);
+    const uint32_t *last = std::lower_bound(first, postings_end, last_position);
+    return {static_cast<size_t>(first - postings.positions), static_cast<size_t>(last - postings.positions)};
+}
@@ -0,0 +1,333 @@
+#pragma once
+#include <algorithm>
+#include <execution>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "search_server.h"
+
+// Read-only copy of a SearchServer for serving replicas. Terms are kept sorted in one buffer
+// with an open-addressing hash directory over them, posting lists and the forward index are
+// CSR arrays over document positions, and document attributes are columns in id order.
+// Queries support plus and minus words and phrases and prefixes are rejected. Fuzzy search and
+// positional postings are not carried over, so a server with either enabled cannot be frozen.
+// Results of accepted queries are identical to those of the SearchServer the index was frozen from.
+class FrozenSearchServer
+{
+public:
+    // Throws std::invalid_argument if search_server has fuzzy search or a positional index enabled.
+    explicit FrozenSearchServer(const SearchServer &search_server);
+    // Releases the index of search_server once the frozen copy is built.
+    explicit FrozenSearchServer(SearchServer &&search_server);
+
+    // Serves an index file written by OfflineIndexer without loading its postings: documents and
+    // the term dictionary are read into memory, and every query reads each posting list of its
+    // words from the file kept open by the server in a single read. Such an index has no forward
+    // index, so GetWordFrequencies throws.
+    static FrozenSearchServer OpenIndex(const std::string &index_path);
+
+    // Term views point into the index itself, so it can be moved but not copied.
+    FrozenSearchServer(const FrozenSearchServer &) = delete;
+    FrozenSearchServer &operator=(const FrozenSearchServer &) = delete;
+    FrozenSearchServer(FrozenSearchServer &&) = default;
+
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query,
+                                           DocumentPredicate document_predicate) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query, DocumentStatus status) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query) const;
+
+    template <typename Ranking = TfIdfRanking>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+
+    template <typename Ranking = TfIdfRanking>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+    std::vector<int>::const_iterator begin() const;
+    std::vector<int>::const_iterator end() const;
+
+    WordFrequenciesView GetWordFrequencies(int document_id) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query,
+                                                                            int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy &,
+                                                                            std::string_view raw_query,
+                                                                            int document_id) const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    struct PostingSpan
+    {
+        const uint32_t *positions = nullptr;
+        const double *term_freqs = nullptr;
+        size_t count = 0;
+    };
+
+    struct PostingBuffer
+    {
+        std::vector<char> bytes;
+        std::vector<uint32_t> positions;
+        std::vector<double> term_freqs;
+    };
+
+    // Queries of all threads share the handle, one seek and read at a time.
+    struct PostingFile
+    {
+        std::ifstream input;
+        std::mutex mutex;
+    };
+
+    struct ScoredTerm
+    {
+        PostingSpan postings;
+        double inverse_document_freq;
+    };
+
+    explicit FrozenSearchServer(const std::set<std::string, std::less<>> &stop_words);
+
+    // Holds only the stop words: parses queries and orders results like the source server.
+    SearchServer query_parser_;
+    double average_word_count_ = 0.0;
+
+    std::vector<char> terms_text_;
+    std::vector<std::string_view> term_words_;
+    std::vector<uint32_t> term_directory_;
+
+    std::vector<size_t> posting_offsets_ = {0};
+    std::vector<uint32_t> posting_positions_;
+    std::vector<double> posting_freqs_;
+
+    std::unique_ptr<PostingFile> posting_file_;
+    std::vector<uint64_t> posting_file_offsets_;
+
+    std::vector<size_t> forward_offsets_ = {0};
+    std::vector<TermFrequency> forward_index_;
+
+    std::vector<int> document_ids_;
+    std::vector<int> ratings_;
+    std::vector<DocumentStatus> statuses_;
+    std::vector<uint32_t> word_counts_;
+
+    void BuildTermDirectory();
+    std::optional<uint32_t> FindTerm(std::string_view word) const;
+    std::string_view GetTerm(uint32_t term) const;
+    std::optional<uint32_t> FindDocument(int document_id) const;
+
+    SearchServer::Query ParseQuery(std::string_view raw_query, QueryArena &arena) const;
+
+    size_t GetRangeCount(const std::execution::sequenced_policy &) const;
+    size_t GetRangeCount(const std::execution::parallel_policy &) const;
+    PostingSpan GetPostings(uint32_t term, PostingBuffer &buffer) const;
+    bool ContainsPosting(uint32_t term, uint32_t position) const;
+    std::pair<size_t, size_t> FindRangePostings(const PostingSpan &postings,
+                                                size_t first_position, size_t last_position) const;
+
+    template <typename Ranking>
+    void ScoreRange(const std::vector<ScoredTerm> &terms, const std::vector<PostingSpan> &minus_postings,
+                    size_t first_position, size_t last_position,
+                    std::vector<double> &relevances, std::vector<char> &is_matched) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> CollectRangeDocuments(const std::vector<double> &relevances, const std::vector<char> &is_matched,
+                                                size_t first_position, size_t last_position,
+                                                DocumentPredicate document_predicate) const;
+};
+
+template <typename Ranking, typename DocumentPredicate>
+std::vector<Document> FrozenSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const
+{
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, document_predicate);
+}
+
+template <typename Ranking, typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> FrozenSearchServer::FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query,
+                                                           DocumentPredicate document_predicate) const
+{
+    QueryArena arena;
+    const auto query = ParseQuery(raw_query, arena);
+
+    std::vector<PostingBuffer> buffers(query.plus_words.size() + query.minus_words.size());
+    size_t buffer_count = 0;
+    std::vector<ScoredTerm> terms;
+    for (const std::string_view word : query.plus_words)
+    {
+        if (const auto term = FindTerm(word))
+        {
+            const PostingSpan postings = GetPostings(*term, buffers[buffer_count++]);
+            terms.push_back({postings, Ranking::ComputeInverseDocumentFreq(GetDocumentCount(), postings.count)});
+        }
+    }
+    std::vector<PostingSpan> minus_postings;
+    for (const std::string_view word : query.minus_words)
+    {
+        if (const auto term = FindTerm(word))
+        {
+            minus_postings.push_back(GetPostings(*term, buffers[buffer_count++]));
+        }
+    }
+
+    // Ranges of positions share the accumulators, each task writing only its own slots.
+    const size_t document_count = document_ids_.size();
+    const size_t range_count = GetRangeCount(policy);
+    std::vector<double> relevances(document_count, 0.0);
+    std::vector<char> is_matched(document_count, 0);
+    std::vector<std::vector<Document>> range_documents(range_count);
+    std::vector<size_t> ranges(range_count);
+    std::iota(ranges.begin(), ranges.end(), 0);
+    std::for_each(policy, ranges.begin(), ranges.end(),
+                  [&](size_t range)
+                  {
+                      const size_t first_position = document_count * range / range_count;
+                      const size_t last_position = document_count * (range + 1) / range_count;
+                      ScoreRange<Ranking>(terms, minus_postings, first_position, last_position, relevances, is_matched);
+                      range_documents[range] = CollectRangeDocuments(relevances, is_matched, first_position, last_position,
+                                                                     document_predicate);
+                  });
+
+    std::vector<Document> matched_documents;
+    for (const auto &documents : range_documents)
+    {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+    const size_t page_size = std::min(matched_documents.size(),
+                                      static_cast<size_t>(query_parser_.MAX_RESULT_DOCUMENT_COUNT));
+    std::partial_sort(matched_documents.begin(), matched_documents.begin() + page_size, matched_documents.end(),
+                      [this](const Document &lhs, const Document &rhs)
+                      {
+                          return query_parser_.RanksBefore(lhs, rhs);
+                      });
+    matched_documents.resize(page_size);
+    return matched_documents;
+}
+
+template <typename Ranking, typename ExecutionPolicy>
+std::vector<Document> FrozenSearchServer::FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query,
+                                                           DocumentStatus status) const
+{
+    return FindTopDocuments<Ranking>(policy, raw_query,
+                                     [status](int, DocumentStatus document_status, int)
+                                     {
+                                         return document_status == status;
+                                     });
+}
+
+template <typename Ranking, typename ExecutionPolicy>
+std::vector<Document> FrozenSearchServer::FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query) const
+{
+    return FindTopDocuments<Ranking>(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Ranking>
+std::vector<Document> FrozenSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, status);
+}
+
+template <typename Ranking>
+std::vector<Document> FrozenSearchServer::FindTopDocuments(std::string_view raw_query) const
+{
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Ranking>
+void FrozenSearchServer::ScoreRange(const std::vector<ScoredTerm> &terms, const std::vector<PostingSpan> &minus_postings,
+                                    size_t first_position, size_t last_position,
+                                    std::vector<double> &relevances, std::vector<char> &is_matched) const
+{
+    for (const ScoredTerm &term : terms)
+    {
+        const PostingSpan &postings = term.postings;
+        const auto [first, last] = FindRangePostings(postings, first_position, last_position);
+        for (size_t i = first; i < last; ++i)
+        {
+            is_matched[postings.positions[i]] = 1;
+        }
+        if constexpr (std::is_same_v<Ranking, TfIdfRanking>)
+        {
+            ScoreTermBlock(postings.positions + first, postings.term_freqs + first, last - first,
+                           term.inverse_document_freq, relevances.data());
+        }
+        else
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                const uint32_t position = postings.positions[i];
+                relevances[position] += Ranking::ComputeTermScore(postings.term_freqs[i], term.inverse_document_freq,
+                                                                  word_counts_[position], average_word_count_);
+            }
+        }
+    }
+    for (const PostingSpan &postings : minus_postings)
+    {
+        const auto [first, last] = FindRangePostings(postings, first_position, last_position);
+        for (size_t i = first; i < last; ++i)
+        {
+            is_matched[postings.positions[i]] = 0;
+        }
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> FrozenSearchServer::CollectRangeDocuments(const std::vector<double> &relevances,
+                                                                const std::vector<char> &is_matched,
+                                                                size_t first_position, size_t last_position,
+                                                                DocumentPredicate document_predicate) const
+{
+    const size_t result_count = static_cast<size_t>(query_parser_.MAX_RESULT_DOCUMENT_COUNT);
+    std::vector<Document> documents;
+    std::vector<double> best_relevances;
+    double threshold = -std::numeric_limits<double>::infinity();
+    for (size_t position = first_position; position < last_position; ++position)
+    {
+        if (best_relevances.size() == result_count)
+        {
+            position = FindNextAtLeast(relevances.data(), position, last_position, threshold);
+            if (position == last_position)
+            {
+                break;
+            }
+        }
+        if (!is_matched[position] ||
+            !document_predicate(document_ids_[position], statuses_[position], ratings_[position]))
+        {
+            continue;
+        }
+        documents.push_back({document_ids_[position], relevances[position], ratings_[position]});
+        best_relevances.push_back(relevances[position]);
+        std::push_heap(best_relevances.begin(), best_relevances.end(), std::greater<>());
+        if (best_relevances.size() > result_count)
+        {
+            std::pop_heap(best_relevances.begin(), best_relevances.end(), std::greater<>());
+            best_relevances.pop_back();
+        }
+        if (best_relevances.size() == result_count)
+        {
+            threshold = best_relevances.front() - query_parser_.EPSILON;
+        }
+    }
+    documents.erase(std::remove_if(documents.begin(), documents.end(),
+                                   [threshold](const Document &document)
+                                   {
+                                       return document.relevance < threshold;
+                                   }),
+                    documents.end());
+    return documents;
+}
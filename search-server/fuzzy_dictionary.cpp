@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <set>
+#include <string>
+
+#include "fuzzy_dictionary.h"
+
+FuzzyDictionary::FuzzyDictionary(int max_distance) : max_distance_(max_distance) {}
+
+template <typename Callback>
+void FuzzyDictionary::ForEachDelete(std::string_view word, Callback callback) const
+{
+    std::set<std::string> current = {std::string(word)};
+    std::set<std::string> seen = current;
+    for (int distance = 1; distance <= max_distance_; ++distance)
+    {
+        std::set<std::string> next;
+        for (const auto &variant : current)
+        {
+            for (size_t i = 0; i < variant.size(); ++i)
+            {
+                std::string shorter = variant.substr(0, i) + variant.substr(i + 1);
+                if (seen.insert(shorter).second)
+                {
+                    next.insert(std::move(shorter));
+                }
+            }
+        }
+        current = std::move(next);
+    }
+    for (const auto &variant : seen)
+    {
+        callback(std::hash<std::string_view>{}(variant));
+    }
+}
+
+void FuzzyDictionary::Add(int term_id, std::string_view word)
+{
+    ForEachDelete(word, [this, term_id](size_t hash)
+                  {
+                      auto &term_ids = deletes_[hash];
+                      if (term_ids.empty() || term_ids.back() != term_id)
+                      {
+                          term_ids.push_back(term_id);
+                      }
+                  });
+}
+
+std::vector<std::pair<int, int>> FuzzyDictionary::FindWithinDistance(std::string_view word,
+                                                                     const std::vector<std::string_view> &words) const
+{
+    std::vector<int> candidates;
+    ForEachDelete(word, [this, &candidates](size_t hash)
+                  {
+                      const auto it = deletes_.find(hash);
+                      if (it != deletes_.end())
+                      {
+                          candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+                      }
+                  });
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<std::pair<int, int>> matches;
+    for (const int term_id : candidates)
+    {
+        const int distance = ComputeEditDistance(word, words[term_id], max_distance_);
+        if (distance <= max_distance_)
+        {
+            matches.push_back({term_id, distance});
+        }
+    }
+    return matches;
+}
+
+int FuzzyDictionary::GetMaxDistance() const
+{
+    return max_distance_;
+}
+
+size_t FuzzyDictionary::GetMemoryUsage() const
+{
+    size_t bytes = deletes_.bucket_count() * sizeof(void *);
+    for (const auto &[hash, term_ids] : deletes_)
+    {
+        bytes += sizeof(void *) + sizeof(hash) + sizeof(term_ids) + term_ids.capacity() * sizeof(int);
+    }
+    return bytes;
+}
+
+int ComputeEditDistance(std::string_view lhs, std::string_view rhs, int max_distance)
+{
+    const int lhs_size = static_cast<int>(lhs.size());
+    const int rhs_size = static_cast<int>(rhs.size());
+    if (std::abs(lhs_size - rhs_size) > max_distance)
+    {
+        return max_distance + 1;
+    }
+
+    std::vector<std::vector<int>> distance(lhs_size + 1, std::vector<int>(rhs_size + 1));
+    for (int i = 0; i <= lhs_size; ++i)
+    {
+        distance[i][0] = i;
+    }
+    for (int j = 0; j <= rhs_size; ++j)
+    {
+        distance[0][j] = j;
+    }
+
+    int previous_row_minimum = 0;
+    for (int i = 1; i <= lhs_size; ++i)
+    {
+        int row_minimum = distance[i][0];
+        for (int j = 1; j <= rhs_size; ++j)
+        {
+            const int cost = lhs[i - 1] == rhs[j - 1] ? 0 : 1;
+            distance[i][j] = std::min({distance[i - 1][j] + 1,
+                                       distance[i][j - 1] + 1,
+                                       distance[i - 1][j - 1] + cost});
+            if (i > 1 && j > 1 && lhs[i - 1] == rhs[j - 2] && lhs[i - 2] == rhs[j - 1])
+            {
+                distance[i][j] = std::min(distance[i][j], distance[i - 2][j - 2] + 1);
+            }
+            row_minimum = std::min(row_minimum, distance[i][j]);
+        }
+        if (row_minimum > max_distance && previous_row_minimum > max_distance)
+        {
+            return max_distance + 1;
+        }
+        previous_row_minimum = row_minimum;
+    }
+    return std::min(distance[lhs_size][rhs_size], max_distance + 1);
+}
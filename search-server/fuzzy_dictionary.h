@@ -0,0 +1,30 @@
+#pragma once
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class FuzzyDictionary
+{
+public:
+    FuzzyDictionary() = default;
+    explicit FuzzyDictionary(int max_distance);
+
+    void Add(int term_id, std::string_view word);
+
+    // Pairs of term id and edit distance for every word within the maximum distance.
+    std::vector<std::pair<int, int>> FindWithinDistance(std::string_view word,
+                                                        const std::vector<std::string_view> &words) const;
+
+    int GetMaxDistance() const;
+    size_t GetMemoryUsage() const;
+
+private:
+    int max_distance_ = 0;
+    std::unordered_map<size_t, std::vector<int>> deletes_;
+
+    template <typename Callback>
+    void ForEachDelete(std::string_view word, Callback callback) const;
+};
+
+int ComputeEditDistance(std::string_view lhs, std::string_view rhs, int max_distance);
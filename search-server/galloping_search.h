@@ -0,0 +1,30 @@
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <functional>
+
+template <typename RandomIt, typename Value, typename Compare>
+RandomIt GallopingLowerBound(RandomIt first, RandomIt last, const Value &value, Compare comp)
+{
+    const auto size = std::distance(first, last);
+    if (size == 0 || !comp(*first, value))
+    {
+        return first;
+    }
+
+    decltype(std::distance(first, last)) low = 0;
+    decltype(std::distance(first, last)) step = 1;
+    while (low + step < size && comp(first[low + step], value))
+    {
+        low += step;
+        step *= 2;
+    }
+
+    return std::lower_bound(first + low + 1, first + std::min(low + step + 1, size), value, comp);
+}
+
+template <typename RandomIt, typename Value>
+RandomIt GallopingLowerBound(RandomIt first, RandomIt last, const Value &value)
+{
+    return GallopingLowerBound(first, last, value, std::less<>{});
+}
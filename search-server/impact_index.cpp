@@ -0,0 +1,69 @@
+#include <cmath>
+
+#include "impact_index.h"
+
+ImpactIndex::ImpactIndex(ImpactPrecision precision, double max_impact) : precision_(precision)
+{
+    const double max_level = precision == ImpactPrecision::BITS_8 ? 255.0 : 65535.0;
+    scale_ = max_impact > 0.0 ? max_impact / max_level : 1.0;
+}
+
+void ImpactIndex::Reserve(size_t term_count, size_t posting_count, size_t document_id_bytes)
+{
+    posting_offsets_.reserve(term_count + 1);
+    document_id_offsets_.reserve(term_count + 1);
+    document_id_gaps_.reserve(document_id_bytes);
+    if (precision_ == ImpactPrecision::BITS_8)
+    {
+        impacts_8_.reserve(posting_count);
+    }
+    else
+    {
+        impacts_16_.reserve(posting_count);
+    }
+}
+
+void ImpactIndex::AddTerm(const std::map<int, double> &postings, double inverse_document_freq)
+{
+    uint32_t previous_document_id = 0;
+    for (const auto &[document_id, term_freq] : postings)
+    {
+        AppendVarint(document_id_gaps_, static_cast<uint32_t>(document_id) - previous_document_id);
+        previous_document_id = static_cast<uint32_t>(document_id);
+        const uint32_t level = Quantize(term_freq * inverse_document_freq);
+        if (precision_ == ImpactPrecision::BITS_8)
+        {
+            impacts_8_.push_back(static_cast<uint8_t>(level));
+        }
+        else
+        {
+            impacts_16_.push_back(static_cast<uint16_t>(level));
+        }
+    }
+    posting_offsets_.push_back(posting_offsets_.back() + postings.size());
+    document_id_offsets_.push_back(document_id_gaps_.size());
+}
+
+double ImpactIndex::GetScale() const
+{
+    return scale_;
+}
+
+uint32_t ImpactIndex::Quantize(double impact) const
+{
+    return static_cast<uint32_t>(std::lround(impact / scale_));
+}
+
+size_t ImpactIndex::GetPostingCount() const
+{
+    return posting_offsets_.back();
+}
+
+size_t ImpactIndex::GetMemoryUsage() const
+{
+    return posting_offsets_.capacity() * sizeof(size_t) +
+           document_id_offsets_.capacity() * sizeof(size_t) +
+           document_id_gaps_.capacity() * sizeof(uint8_t) +
+           impacts_8_.capacity() * sizeof(uint8_t) +
+           impacts_16_.capacity() * sizeof(uint16_t);
+}
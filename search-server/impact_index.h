@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "varint_coding.h"
+
+enum class ImpactPrecision
+{
+    BITS_8,
+    BITS_16,
+};
+
+// Postings with tf * idf precomputed and quantized to 8 or 16 bits, document ids stored as
+// varint gaps. All terms share one scale, so impacts of different terms can be summed as
+// integers. The index is kept next to the exact postings, so it adds to the total memory.
+class ImpactIndex
+{
+public:
+    ImpactIndex() = default;
+    ImpactIndex(ImpactPrecision precision, double max_impact);
+
+    void Reserve(size_t term_count, size_t posting_count, size_t document_id_bytes);
+    void AddTerm(const std::map<int, double> &postings, double inverse_document_freq);
+
+    // Stops as soon as the callback returns false
+    template <typename Callback>
+    void ForEachImpact(int term_id, Callback callback) const;
+
+    double GetScale() const;
+    uint32_t Quantize(double impact) const;
+    size_t GetPostingCount() const;
+    size_t GetMemoryUsage() const;
+
+private:
+    ImpactPrecision precision_ = ImpactPrecision::BITS_8;
+    double scale_ = 1.0;
+    std::vector<size_t> posting_offsets_ = {0};
+    std::vector<size_t> document_id_offsets_ = {0};
+    std::vector<uint8_t> document_id_gaps_;
+    std::vector<uint8_t> impacts_8_;
+    std::vector<uint16_t> impacts_16_;
+};
+
+template <typename Callback>
+void ImpactIndex::ForEachImpact(int term_id, Callback callback) const
+{
+    if (term_id < 0 || static_cast<size_t>(term_id) + 1 >= posting_offsets_.size())
+    {
+        return;
+    }
+    const uint8_t *gaps = document_id_gaps_.data() + document_id_offsets_[term_id];
+    uint32_t document_id = 0;
+    for (size_t i = posting_offsets_[term_id]; i < posting_offsets_[term_id + 1]; ++i)
+    {
+        document_id += ReadVarint(gaps);
+        if (!callback(static_cast<int>(document_id),
+                      precision_ == ImpactPrecision::BITS_8 ? uint32_t{impacts_8_[i]} : uint32_t{impacts_16_[i]}))
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "document.h"
+
+// Binary layout shared by OfflineIndexer runs and the final index opened by SearchServer::OpenIndex
+// and FrozenSearchServer::OpenIndex. Index file: magic, stop words, documents, then every term
+// with its postings terminated by a negative document id and an empty term. A directory with the
+// file offset and count of every term's postings follows, and the file ends with its offset.
+inline constexpr std::string_view INDEX_FILE_MAGIC = "SSIDX002";
+// A posting is a document id followed by its term frequency, with no padding.
+inline constexpr size_t INDEX_POSTING_SIZE = sizeof(int) + sizeof(double);
+
+template <typename Value>
+void WriteBinary(std::ostream &out, const Value &value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename Value>
+Value ReadBinary(std::istream &in)
+{
+    Value value{};
+    if (!in.read(reinterpret_cast<char *>(&value), sizeof(value)))
+    {
+        throw std::invalid_argument("Unexpected end of index file");
+    }
+    return value;
+}
+
+inline void WriteBinaryString(std::ostream &out, std::string_view text)
+{
+    WriteBinary(out, static_cast<uint32_t>(text.size()));
+    out.write(text.data(), text.size());
+}
+
+inline void ReadBinaryString(std::istream &in, std::string &text)
+{
+    text.resize(ReadBinary<uint32_t>(in));
+    if (!in.read(text.data(), text.size()))
+    {
+        throw std::invalid_argument("Unexpected end of index file");
+    }
+}
+
+struct IndexDocument
+{
+    int id;
+    int rating;
+    DocumentStatus status;
+    uint32_t word_count;
+};
+
+struct IndexTermEntry
+{
+    std::string term;
+    uint64_t posting_offset;
+    uint64_t posting_count;
+};
+
+inline void WriteIndexDocument(std::ostream &out, const IndexDocument &document)
+{
+    WriteBinary(out, document.id);
+    WriteBinary(out, document.rating);
+    WriteBinary(out, static_cast<int>(document.status));
+    WriteBinary(out, document.word_count);
+}
+
+inline IndexDocument ReadIndexDocument(std::istream &in)
+{
+    IndexDocument document{};
+    document.id = ReadBinary<int>(in);
+    document.rating = ReadBinary<int>(in);
+    const int status = ReadBinary<int>(in);
+    if (document.id < 0 || status < static_cast<int>(DocumentStatus::ACTUAL) ||
+        status > static_cast<int>(DocumentStatus::REMOVED))
+    {
+        throw std::invalid_argument("Invalid document in index file");
+    }
+    document.status = static_cast<DocumentStatus>(status);
+    document.word_count = ReadBinary<uint32_t>(in);
+    return document;
+}
+
+inline void WriteIndexTermEntry(std::ostream &out, const IndexTermEntry &entry)
+{
+    WriteBinaryString(out, entry.term);
+    WriteBinary(out, entry.posting_offset);
+    WriteBinary(out, entry.posting_count);
+}
+
+inline IndexTermEntry ReadIndexTermEntry(std::istream &in)
+{
+    IndexTermEntry entry;
+    ReadBinaryString(in, entry.term);
+    entry.posting_offset = ReadBinary<uint64_t>(in);
+    entry.posting_count = ReadBinary<uint64_t>(in);
+    return entry;
+}
+
+// Checks the magic and returns the stop words the index was built with.
+inline std::set<std::string, std::less<>> ReadIndexHeader(std::istream &in, const std::string &index_path)
+{
+    std::string magic(INDEX_FILE_MAGIC.size(), '\0');
+    if (!in.read(magic.data(), magic.size()) || magic != INDEX_FILE_MAGIC)
+    {
+        throw std::invalid_argument("Invalid index file " + index_path);
+    }
+
+    std::set<std::string, std::less<>> stop_words;
+    std::string word;
+    for (auto count = ReadBinary<uint64_t>(in); count > 0; --count)
+    {
+        ReadBinaryString(in, word);
+        stop_words.insert(word);
+    }
+    return stop_words;
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <numeric>
+
+#include "index_segment.h"
+
+void IndexSegment::Builder::AddDocument(const SegmentDocument &document,
+                                        const std::vector<std::pair<std::string_view, double>> &word_freqs)
+{
+    const auto document_index = static_cast<uint32_t>(documents_.size());
+    documents_.push_back(document);
+    for (const auto &[word, term_freq] : word_freqs)
+    {
+        auto postings = postings_.find(word);
+        if (postings == postings_.end())
+        {
+            postings = postings_.emplace(std::string(word), std::vector<Posting>{}).first;
+        }
+        postings->second.push_back({document_index, term_freq});
+    }
+}
+
+IndexSegment IndexSegment::Builder::Build() const
+{
+    std::vector<uint32_t> order(documents_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](uint32_t lhs, uint32_t rhs)
+              {
+                  return documents_[lhs].id < documents_[rhs].id;
+              });
+
+    IndexSegment segment;
+    std::vector<uint32_t> new_indexes(documents_.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+    {
+        new_indexes[order[i]] = i;
+        segment.documents_.push_back(documents_[order[i]]);
+        segment.live_word_count_ += documents_[order[i]].word_count;
+    }
+    segment.deleted_.assign(documents_.size(), false);
+    segment.live_document_count_ = documents_.size();
+
+    std::vector<std::vector<ForwardEntry>> forward(documents_.size());
+    for (const auto &[word, postings] : postings_)
+    {
+        const auto term = static_cast<uint32_t>(segment.live_document_freqs_.size());
+        segment.terms_text_ += word;
+        segment.term_offsets_.push_back(segment.terms_text_.size());
+
+        const size_t first = segment.postings_.size();
+        for (const auto &[document_index, term_freq] : postings)
+        {
+            segment.postings_.push_back({new_indexes[document_index], term_freq});
+            forward[new_indexes[document_index]].push_back({term, term_freq});
+        }
+        std::sort(segment.postings_.begin() + first, segment.postings_.end(),
+                  [](const Posting &lhs, const Posting &rhs)
+                  {
+                      return lhs.document_index < rhs.document_index;
+                  });
+        segment.posting_offsets_.push_back(segment.postings_.size());
+        segment.live_document_freqs_.push_back(static_cast<uint32_t>(postings.size()));
+    }
+
+    for (const auto &entries : forward)
+    {
+        segment.forward_entries_.insert(segment.forward_entries_.end(), entries.begin(), entries.end());
+        segment.forward_offsets_.push_back(segment.forward_entries_.size());
+    }
+    return segment;
+}
+
+size_t IndexSegment::GetDocumentCount() const
+{
+    return documents_.size();
+}
+
+size_t IndexSegment::GetLiveDocumentCount() const
+{
+    return live_document_count_;
+}
+
+uint64_t IndexSegment::GetLiveWordCount() const
+{
+    return live_word_count_;
+}
+
+const SegmentDocument &IndexSegment::GetDocument(uint32_t document_index) const
+{
+    return documents_[document_index];
+}
+
+std::optional<uint32_t> IndexSegment::FindDocument(int document_id) const
+{
+    const auto document = std::lower_bound(documents_.begin(), documents_.end(), document_id,
+                                           [](const SegmentDocument &lhs, int id)
+                                           {
+                                               return lhs.id < id;
+                                           });
+    if (document == documents_.end() || document->id != document_id)
+    {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(document - documents_.begin());
+}
+
+bool IndexSegment::ContainsDocument(int document_id) const
+{
+    const auto document_index = FindDocument(document_id);
+    return document_index && !deleted_[*document_index];
+}
+
+bool IndexSegment::IsDeleted(uint32_t document_index) const
+{
+    return deleted_[document_index];
+}
+
+const std::vector<bool> &IndexSegment::GetDeletedDocuments() const
+{
+    return deleted_;
+}
+
+bool IndexSegment::RemoveDocument(int document_id)
+{
+    const auto document_index = FindDocument(document_id);
+    if (!document_index || deleted_[*document_index])
+    {
+        return false;
+    }
+
+    deleted_[*document_index] = true;
+    --live_document_count_;
+    live_word_count_ -= documents_[*document_index].word_count;
+    for (size_t i = forward_offsets_[*document_index]; i < forward_offsets_[*document_index + 1]; ++i)
+    {
+        --live_document_freqs_[forward_entries_[i].term];
+    }
+    return true;
+}
+
+std::optional<uint32_t> IndexSegment::FindTerm(std::string_view word) const
+{
+    const uint32_t term = LowerBoundTerm(word);
+    if (term == live_document_freqs_.size() || GetTerm(term) != word)
+    {
+        return std::nullopt;
+    }
+    return term;
+}
+
+std::vector<uint32_t> IndexSegment::FindTermsByPrefix(std::string_view prefix, size_t max_count) const
+{
+    std::vector<uint32_t> terms;
+    for (uint32_t term = LowerBoundTerm(prefix);
+         term < live_document_freqs_.size() && terms.size() < max_count && GetTerm(term).substr(0, prefix.size()) == prefix;
+         ++term)
+    {
+        terms.push_back(term);
+    }
+    return terms;
+}
+
+uint32_t IndexSegment::LowerBoundTerm(std::string_view word) const
+{
+    uint32_t low = 0;
+    uint32_t high = static_cast<uint32_t>(live_document_freqs_.size());
+    while (low < high)
+    {
+        const uint32_t middle = low + (high - low) / 2;
+        if (GetTerm(middle) < word)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+std::string_view IndexSegment::GetTerm(uint32_t term) const
+{
+    return std::string_view(terms_text_).substr(term_offsets_[term], term_offsets_[term + 1] - term_offsets_[term]);
+}
+
+uint32_t IndexSegment::GetLiveDocumentFreq(std::string_view word) const
+{
+    const auto term = FindTerm(word);
+    return term ? live_document_freqs_[*term] : 0;
+}
+
+std::pair<const IndexSegment::Posting *, const IndexSegment::Posting *> IndexSegment::GetPostings(uint32_t term) const
+{
+    return {postings_.data() + posting_offsets_[term], postings_.data() + posting_offsets_[term + 1]};
+}
+
+void IndexSegment::AppendLiveDocuments(Builder &builder, const std::vector<bool> &deleted) const
+{
+    std::vector<std::pair<std::string_view, double>> word_freqs;
+    for (uint32_t document_index = 0; document_index < documents_.size(); ++document_index)
+    {
+        if (deleted[document_index])
+        {
+            continue;
+        }
+        word_freqs.clear();
+        for (size_t i = forward_offsets_[document_index]; i < forward_offsets_[document_index + 1]; ++i)
+        {
+            word_freqs.emplace_back(GetTerm(forward_entries_[i].term), forward_entries_[i].term_freq);
+        }
+        builder.AddDocument(documents_[document_index], word_freqs);
+    }
+}
+
+size_t IndexSegment::GetMemoryUsage() const
+{
+    return documents_.capacity() * sizeof(SegmentDocument) +
+           forward_offsets_.capacity() * sizeof(size_t) +
+           forward_entries_.capacity() * sizeof(ForwardEntry) +
+           terms_text_.capacity() +
+           term_offsets_.capacity() * sizeof(size_t) +
+           posting_offsets_.capacity() * sizeof(size_t) +
+           postings_.capacity() * sizeof(Posting) +
+           deleted_.capacity() / 8 +
+           live_document_freqs_.capacity() * sizeof(uint32_t);
+}
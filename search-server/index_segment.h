@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "document.h"
+
+struct SegmentDocument
+{
+    int id;
+    int rating;
+    DocumentStatus status;
+    uint32_t word_count;
+};
+
+// Read-only index over a fixed set of documents: sorted terms with CSR posting lists
+// ordered by document id. Only the tombstones change after the segment is built.
+class IndexSegment
+{
+public:
+    struct Posting
+    {
+        uint32_t document_index;
+        double term_freq;
+    };
+
+    class Builder
+    {
+    public:
+        void AddDocument(const SegmentDocument &document,
+                         const std::vector<std::pair<std::string_view, double>> &word_freqs);
+        IndexSegment Build() const;
+
+    private:
+        std::vector<SegmentDocument> documents_;
+        std::map<std::string, std::vector<Posting>, std::less<>> postings_;
+    };
+
+    size_t GetDocumentCount() const;
+    size_t GetLiveDocumentCount() const;
+    uint64_t GetLiveWordCount() const;
+
+    const SegmentDocument &GetDocument(uint32_t document_index) const;
+    std::optional<uint32_t> FindDocument(int document_id) const;
+    bool ContainsDocument(int document_id) const;
+    bool IsDeleted(uint32_t document_index) const;
+    const std::vector<bool> &GetDeletedDocuments() const;
+    bool RemoveDocument(int document_id);
+
+    std::optional<uint32_t> FindTerm(std::string_view word) const;
+    // Terms starting with prefix in lexicographical order, at most max_count of them.
+    std::vector<uint32_t> FindTermsByPrefix(std::string_view prefix, size_t max_count) const;
+    std::string_view GetTerm(uint32_t term) const;
+    uint32_t GetLiveDocumentFreq(std::string_view word) const;
+    std::pair<const Posting *, const Posting *> GetPostings(uint32_t term) const;
+
+    void AppendLiveDocuments(Builder &builder, const std::vector<bool> &deleted) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    struct ForwardEntry
+    {
+        uint32_t term;
+        double term_freq;
+    };
+
+    std::vector<SegmentDocument> documents_;
+    std::vector<size_t> forward_offsets_ = {0};
+    std::vector<ForwardEntry> forward_entries_;
+
+    std::string terms_text_;
+    std::vector<size_t> term_offsets_ = {0};
+    std::vector<size_t> posting_offsets_ = {0};
+    std::vector<Posting> postings_;
+
+    std::vector<bool> deleted_;
+    std::vector<uint32_t> live_document_freqs_;
+    size_t live_document_count_ = 0;
+    uint64_t live_word_count_ = 0;
+
+    uint32_t LowerBoundTerm(std::string_view word) const;
+};
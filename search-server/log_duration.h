@@ -2,6 +2,8 @@
 
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <string_view>
 
 using namespace std;
 using namespace chrono;
@@ -15,7 +17,7 @@ using namespace literals;
 class LogDuration
 {
 public:
-    LogDuration(const std::string &id) : id_(id)
+    LogDuration(std::string_view id) : id_(id)
     {
     }
 
@@ -1,14 +1,50 @@
 #include "search_server.h"
+#include "document_ingest.h"
+#include "frozen_search_server.h"
 #include "log_duration.h"
 #include "process_queries.h"
+#include "quantization_report.h"
+#include "test_example_functions.h"
+#include <atomic>
+#include <cstdlib>
 #include <execution>
 #include <iostream>
+#include <new>
 #include <random>
+#include <sstream>
 #include <string>
 #include <vector>
 
 using namespace std;
 
+// Counts every allocation of the program, including containers that do not use the query arena.
+atomic<uint64_t> heap_allocation_count = 0;
+
+void *operator new(size_t size)
+{
+    ++heap_allocation_count;
+    if (void *pointer = malloc(size == 0 ? 1 : size))
+    {
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+// Once inlined, GCC sees memory from operator new released by free and warns, although
+// the replaced pair matches.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void *pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    free(pointer);
+}
+#pragma GCC diagnostic pop
+
 string GenerateWord(mt19937 &generator, int max_length)
 {
     const int length = uniform_int_distribution(1, max_length)(generator);
@@ -62,34 +98,161 @@ vector<string> GenerateQueries(mt19937 &generator, const vector<string> &diction
     return queries;
 }
 
-template <typename ExecutionPolicy>
+template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
 void Test(string_view mark, const SearchServer &search_server, const vector<string> &queries, ExecutionPolicy &&policy)
 {
     LOG_DURATION(mark);
+    const uint64_t heap_allocations = heap_allocation_count;
+    const uint64_t arena_allocations = QueryArena::GetUpstreamAllocationCount();
     double total_relevance = 0;
     for (const string_view query : queries)
     {
-        for (const auto &document : search_server.FindTopDocuments(policy, query))
+        for (const auto &document : search_server.FindTopDocuments<Ranking>(policy, query))
         {
             total_relevance += document.relevance;
         }
     }
-    cout << total_relevance << endl;
+    const uint64_t query_heap_allocations = heap_allocation_count - heap_allocations;
+    cout << total_relevance << ", heap allocations per query: "s << query_heap_allocations * 1.0 / queries.size()
+         << ", of them by the query arena: "s << QueryArena::GetUpstreamAllocationCount() - arena_allocations << endl;
+}
+
+void BenchmarkScoringKernel(mt19937 &generator)
+{
+    const size_t slot_count = 1 << 20;
+    vector<uint32_t> slots;
+    vector<double> term_freqs;
+    for (size_t slot = 0; slot < slot_count; slot += uniform_int_distribution<size_t>(1, 4)(generator))
+    {
+        slots.push_back(static_cast<uint32_t>(slot));
+        term_freqs.push_back(uniform_real_distribution<>(0, 1)(generator));
+    }
+
+    const SimdLevel supported_level = GetSupportedSimdLevel();
+    for (const auto level : {SimdLevel::SCALAR, SimdLevel::AVX2, SimdLevel::AVX512})
+    {
+        if (level > supported_level)
+        {
+            continue;
+        }
+        SetSimdLevel(level);
+        vector<double> accumulators(slot_count, 0.0);
+        const uint64_t start = ReadTimestampCounter();
+        ScoreTermBlock(slots.data(), term_freqs.data(), slots.size(), 1.0, accumulators.data());
+        const uint64_t scored = ReadTimestampCounter();
+        FindNextAtLeast(accumulators.data(), 0, slot_count, 2.0);
+        const uint64_t scanned = ReadTimestampCounter();
+        cout << GetSimdLevelName(level) << ": "s << (scored - start) * 1.0 / slots.size() << " cycles per posting, "s
+             << (scanned - scored) * 1.0 / slot_count << " cycles per slot in the threshold scan"s << endl;
+    }
+    SetSimdLevel(supported_level);
 }
 
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
+#define TEST_RANKING(ranking, policy) Test<ranking>(#ranking " " #policy, search_server, queries, execution::policy)
 
 int main()
 {
+    TestSearchServer();
+
     mt19937 generator;
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
     const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
     SearchServer search_server(dictionary[0]);
+    vector<NewDocument> batch;
     for (size_t i = 0; i < documents.size(); ++i)
     {
-        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    {
+        LOG_DURATION("AddDocuments par");
+        search_server.AddDocuments(execution::par, batch);
+    }
+    {
+        string records;
+        for (size_t i = 0; i < documents.size(); ++i)
+        {
+            records += to_string(i) + "\tACTUAL\t1 2 3\t"s + documents[i] + "\n"s;
+        }
+        istringstream input(records);
+        SearchServer ingested_search_server(dictionary[0]);
+        cout << "IngestDocuments "s << IngestDocuments(ingested_search_server, input) << endl;
     }
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
     TEST(seq);
     TEST(par);
+    TEST_RANKING(TfIdfRanking, seq);
+    TEST_RANKING(Bm25Ranking, seq);
+    TEST_RANKING(Bm25PlusRanking, seq);
+    BenchmarkScoringKernel(generator);
+
+    {
+        LOG_DURATION("TfIdfRanking budget 10000 postings"s);
+        QueryOptions options;
+        options.max_postings = 10'000;
+        int partial_count = 0;
+        for (const string_view query : queries)
+        {
+            partial_count += search_server.FindTopDocuments(query, options).is_partial;
+        }
+        cout << partial_count << " of "s << queries.size() << " results are partial"s << endl;
+    }
+
+    {
+        LOG_DURATION("TfIdfRanking planned"s);
+        double total_relevance = 0.0;
+        for (const string_view query : queries)
+        {
+            for (const auto &document : search_server.FindTopDocuments(query, QueryOptions{}).documents)
+            {
+                total_relevance += document.relevance;
+            }
+        }
+        cout << total_relevance << endl;
+    }
+    {
+        LOG_DURATION("TfIdfRanking planned par"s);
+        double total_relevance = 0.0;
+        for (const string_view query : queries)
+        {
+            for (const auto &document : search_server.FindTopDocuments(execution::par, query, QueryOptions{}).documents)
+            {
+                total_relevance += document.relevance;
+            }
+        }
+        cout << total_relevance << endl;
+    }
+    cout << search_server.Explain(queries.front()) << endl;
+    cout << search_server.Explain(execution::par, queries.front()) << endl;
+    cout << search_server.GetMemoryUsage() << endl;
+    for (const auto &term : search_server.GetHeaviestTerms(3))
+    {
+        cout << term << endl;
+    }
+
+    for (const auto precision : {ImpactPrecision::BITS_8, ImpactPrecision::BITS_16})
+    {
+        search_server.BuildImpactIndex(precision);
+        cout << (precision == ImpactPrecision::BITS_8 ? "8-bit"s : "16-bit"s) << " impacts: "s
+             << search_server.GetImpactIndexMemoryUsage() * 1.0 / search_server.GetImpactIndexPostingCount()
+             << " bytes per posting against "s << sizeof(int) + sizeof(double) << " for an id and a double, "s
+             << "the index grows by "s << search_server.GetImpactIndexMemoryUsage() << " bytes, "s
+             << MeasureQuantizationLoss(search_server, queries) << endl;
+        TEST_RANKING(QuantizedTfIdfRanking, seq);
+    }
+
+    const FrozenSearchServer frozen_search_server(move(search_server));
+    cout << frozen_search_server.GetMemoryUsage() << endl;
+    {
+        LOG_DURATION("frozen seq"s);
+        double total_relevance = 0.0;
+        for (const string_view query : queries)
+        {
+            for (const auto &document : frozen_search_server.FindTopDocuments(execution::seq, query))
+            {
+                total_relevance += document.relevance;
+            }
+        }
+        cout << total_relevance << endl;
+    }
 }
\ No newline at end of file
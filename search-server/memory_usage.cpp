@@ -0,0 +1,36 @@
+#include <string>
+
+#include "memory_usage.h"
+
+using namespace std::string_literals;
+
+size_t MemoryUsage::GetTotal() const
+{
+    return posting_lists + forward_index + document_texts + documents + document_ids + term_dictionary +
+           positional_index + fuzzy_index + duplicate_index + impact_index + attribute_index;
+}
+
+std::ostream &operator<<(std::ostream &out, const MemoryUsage &usage)
+{
+    out << "{ posting_lists = "s << usage.posting_lists
+        << ", forward_index = "s << usage.forward_index
+        << ", document_texts = "s << usage.document_texts
+        << ", documents = "s << usage.documents
+        << ", document_ids = "s << usage.document_ids
+        << ", term_dictionary = "s << usage.term_dictionary
+        << ", positional_index = "s << usage.positional_index
+        << ", fuzzy_index = "s << usage.fuzzy_index
+        << ", duplicate_index = "s << usage.duplicate_index
+        << ", impact_index = "s << usage.impact_index
+        << ", attribute_index = "s << usage.attribute_index
+        << ", total = "s << usage.GetTotal() << " }"s;
+    return out;
+}
+
+std::ostream &operator<<(std::ostream &out, const TermMemoryUsage &usage)
+{
+    out << "{ word = "s << usage.word
+        << ", document_count = "s << usage.document_count
+        << ", bytes = "s << usage.bytes << " }"s;
+    return out;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <iostream>
+#include <string_view>
+
+// Bytes held by each part of a SearchServer, computed from container sizes and capacities.
+// A tree node is counted as its value plus four pointers of node header.
+struct MemoryUsage
+{
+    size_t posting_lists = 0;
+    size_t forward_index = 0;
+    size_t document_texts = 0;
+    size_t documents = 0;
+    size_t document_ids = 0;
+    size_t term_dictionary = 0;
+    size_t positional_index = 0;
+    size_t fuzzy_index = 0;
+    size_t duplicate_index = 0;
+    size_t impact_index = 0;
+    size_t attribute_index = 0;
+
+    size_t GetTotal() const;
+};
+
+// Posting list, forward index entries and dictionary entries owned by one term.
+struct TermMemoryUsage
+{
+    std::string_view word;
+    size_t document_count = 0;
+    size_t bytes = 0;
+};
+
+std::ostream &operator<<(std::ostream &out, const MemoryUsage &usage);
+std::ostream &operator<<(std::ostream &out, const TermMemoryUsage &usage);
@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <queue>
+
+#include "index_file.h"
+#include "offline_indexer.h"
+
+namespace
+{
+    const size_t MIN_MERGE_BUFFER_SIZE = 64 << 10;
+
+    struct RunRecord
+    {
+        std::string term;
+        int document_id = 0;
+        double term_freq = 0.0;
+    };
+
+    class RunReader
+    {
+    public:
+        RunReader(const std::string &path, size_t buffer_size) : buffer_(buffer_size)
+        {
+            input_.rdbuf()->pubsetbuf(buffer_.data(), buffer_.size());
+            input_.open(path, std::ios::binary);
+            if (!input_)
+            {
+                throw std::invalid_argument("Cannot open "s + path);
+            }
+            Next();
+        }
+
+        bool IsEnd() const
+        {
+            return is_end_;
+        }
+
+        const RunRecord &Current() const
+        {
+            return current_;
+        }
+
+        void Next()
+        {
+            if (input_.peek() == std::char_traits<char>::eof())
+            {
+                is_end_ = true;
+                return;
+            }
+            ReadBinaryString(input_, current_.term);
+            current_.document_id = ReadBinary<int>(input_);
+            current_.term_freq = ReadBinary<double>(input_);
+        }
+
+    private:
+        std::vector<char> buffer_;
+        std::ifstream input_;
+        RunRecord current_;
+        bool is_end_ = false;
+    };
+
+    void WriteRunRecord(std::ostream &out, std::string_view term, int document_id, double term_freq)
+    {
+        WriteBinaryString(out, term);
+        WriteBinary(out, document_id);
+        WriteBinary(out, term_freq);
+    }
+
+    template <typename Sink>
+    void MergeRunFiles(const std::vector<std::string> &paths, size_t buffer_size, Sink sink)
+    {
+        std::vector<std::unique_ptr<RunReader>> readers;
+        for (const auto &path : paths)
+        {
+            readers.push_back(std::make_unique<RunReader>(path, buffer_size));
+        }
+
+        const auto comp = [&readers](size_t lhs, size_t rhs)
+        {
+            const auto &left = readers[lhs]->Current();
+            const auto &right = readers[rhs]->Current();
+            return std::tie(left.term, left.document_id) > std::tie(right.term, right.document_id);
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(comp)> heads(comp);
+        for (size_t i = 0; i < readers.size(); ++i)
+        {
+            if (!readers[i]->IsEnd())
+            {
+                heads.push(i);
+            }
+        }
+
+        while (!heads.empty())
+        {
+            const size_t reader = heads.top();
+            heads.pop();
+            sink(readers[reader]->Current());
+            readers[reader]->Next();
+            if (!readers[reader]->IsEnd())
+            {
+                heads.push(reader);
+            }
+        }
+    }
+}
+
+OfflineIndexer::~OfflineIndexer()
+{
+    RemoveTempFiles();
+}
+
+void OfflineIndexer::Open()
+{
+    const size_t records_capacity = options_.memory_budget / (MIN_RECORD_SIZE + sizeof(uint32_t)) * MIN_RECORD_SIZE;
+    if (options_.memory_budget < 2 * MIN_MERGE_BUFFER_SIZE)
+    {
+        throw std::invalid_argument("Memory budget is too small"s);
+    }
+    records_.reserve(records_capacity);
+    record_offsets_.reserve(records_capacity / MIN_RECORD_SIZE);
+
+    documents_path_ = MakeTempPath("documents");
+    documents_.open(documents_path_, std::ios::binary);
+    if (!documents_)
+    {
+        throw std::invalid_argument("Cannot create "s + documents_path_);
+    }
+}
+
+std::string OfflineIndexer::MakeTempPath(std::string_view name) const
+{
+    static std::atomic<uint64_t> file_counter = 0;
+    const auto directory = options_.temp_directory.empty() ? std::filesystem::temp_directory_path()
+                                                           : std::filesystem::path(options_.temp_directory);
+    return (directory / ("search_index_"s + std::string(name) + "_"s + std::to_string(file_counter++) + ".tmp"s)).string();
+}
+
+void OfflineIndexer::AddDocument(int document_id,
+                                 std::string_view document,
+                                 DocumentStatus status,
+                                 const std::vector<int> &ratings)
+{
+    if (document_id < 0 || document_ids_.count(document_id) > 0)
+    {
+        throw std::invalid_argument("Invalid document ID"s);
+    }
+    if (!documents_.is_open())
+    {
+        throw std::invalid_argument("Index is already finished"s);
+    }
+
+    const auto words = tokenizer_.SplitIntoWordsNoStop(document);
+    std::map<std::string_view, double> term_freqs;
+    for (std::string_view word : words)
+    {
+        term_freqs[word] += 1.0 / words.size();
+    }
+
+    size_t record_bytes = 0;
+    for (const auto &[word, _] : term_freqs)
+    {
+        record_bytes += MIN_RECORD_SIZE - 1 + word.size();
+    }
+    if (record_bytes > records_.capacity() || term_freqs.size() > record_offsets_.capacity())
+    {
+        throw std::invalid_argument("Document does not fit into the memory budget"s);
+    }
+    if (records_.size() + record_bytes > records_.capacity() ||
+        record_offsets_.size() + term_freqs.size() > record_offsets_.capacity())
+    {
+        SpillRun();
+    }
+
+    for (const auto &[word, term_freq] : term_freqs)
+    {
+        record_offsets_.push_back(static_cast<uint32_t>(records_.size()));
+        const auto length = static_cast<uint32_t>(word.size());
+        records_.insert(records_.end(), reinterpret_cast<const char *>(&length),
+                        reinterpret_cast<const char *>(&length) + sizeof(length));
+        records_.insert(records_.end(), word.begin(), word.end());
+        records_.insert(records_.end(), reinterpret_cast<const char *>(&document_id),
+                        reinterpret_cast<const char *>(&document_id) + sizeof(document_id));
+        records_.insert(records_.end(), reinterpret_cast<const char *>(&term_freq),
+                        reinterpret_cast<const char *>(&term_freq) + sizeof(term_freq));
+    }
+
+    WriteIndexDocument(documents_, {document_id, SearchServer::ComputeAverageRating(ratings), status,
+                                    static_cast<uint32_t>(words.size())});
+    document_ids_.insert(document_id);
+}
+
+void OfflineIndexer::SpillRun()
+{
+    if (record_offsets_.empty())
+    {
+        return;
+    }
+
+    const auto term_of = [this](uint32_t offset)
+    {
+        uint32_t length;
+        std::memcpy(&length, records_.data() + offset, sizeof(length));
+        return std::string_view(records_.data() + offset + sizeof(length), length);
+    };
+    const auto document_of = [this, &term_of](uint32_t offset)
+    {
+        int document_id;
+        std::memcpy(&document_id, records_.data() + offset + sizeof(uint32_t) + term_of(offset).size(),
+                    sizeof(document_id));
+        return document_id;
+    };
+
+    std::sort(record_offsets_.begin(), record_offsets_.end(),
+              [&term_of, &document_of](uint32_t lhs, uint32_t rhs)
+              {
+                  const auto lhs_term = term_of(lhs);
+                  const auto rhs_term = term_of(rhs);
+                  return lhs_term < rhs_term || (lhs_term == rhs_term && document_of(lhs) < document_of(rhs));
+              });
+
+    run_paths_.push_back(MakeTempPath("run"));
+    std::ofstream out(run_paths_.back(), std::ios::binary);
+    for (const uint32_t offset : record_offsets_)
+    {
+        const size_t size = sizeof(uint32_t) + term_of(offset).size() + sizeof(int) + sizeof(double);
+        out.write(records_.data() + offset, size);
+    }
+    if (!out)
+    {
+        throw std::invalid_argument("Cannot write "s + run_paths_.back());
+    }
+
+    records_.clear();
+    record_offsets_.clear();
+}
+
+void OfflineIndexer::MergeRuns(std::ostream &out)
+{
+    const size_t max_fan_in = std::max<size_t>(2, options_.memory_budget / MIN_MERGE_BUFFER_SIZE - 1);
+    while (run_paths_.size() > max_fan_in)
+    {
+        const std::vector<std::string> sources(run_paths_.begin(), run_paths_.begin() + max_fan_in);
+        const std::string merged_path = MakeTempPath("run");
+        {
+            std::ofstream merged(merged_path, std::ios::binary);
+            MergeRunFiles(sources, options_.memory_budget / (max_fan_in + 1),
+                          [&merged](const RunRecord &record)
+                          {
+                              WriteRunRecord(merged, record.term, record.document_id, record.term_freq);
+                          });
+        }
+        for (const auto &path : sources)
+        {
+            std::filesystem::remove(path);
+        }
+        run_paths_.erase(run_paths_.begin(), run_paths_.begin() + max_fan_in);
+        run_paths_.push_back(merged_path);
+    }
+
+    directory_path_ = MakeTempPath("directory");
+    std::ofstream directory(directory_path_, std::ios::binary);
+    IndexTermEntry entry;
+    uint64_t term_count = 0;
+    const auto finish_term = [&]()
+    {
+        WriteBinary(out, -1);
+        WriteIndexTermEntry(directory, entry);
+        ++term_count;
+    };
+    MergeRunFiles(run_paths_, options_.memory_budget / (run_paths_.size() + 1),
+                  [&](const RunRecord &record)
+                  {
+                      if (record.term != entry.term)
+                      {
+                          if (!entry.term.empty())
+                          {
+                              finish_term();
+                          }
+                          entry.term = record.term;
+                          WriteBinaryString(out, entry.term);
+                          entry.posting_offset = static_cast<uint64_t>(out.tellp());
+                          entry.posting_count = 0;
+                      }
+                      WriteBinary(out, record.document_id);
+                      WriteBinary(out, record.term_freq);
+                      ++entry.posting_count;
+                  });
+    if (!entry.term.empty())
+    {
+        finish_term();
+    }
+    WriteBinaryString(out, std::string_view{});
+
+    directory.close();
+    if (!directory)
+    {
+        throw std::invalid_argument("Cannot write "s + directory_path_);
+    }
+    const auto directory_offset = static_cast<uint64_t>(out.tellp());
+    WriteBinary(out, term_count);
+    if (term_count > 0)
+    {
+        std::ifstream directory_input(directory_path_, std::ios::binary);
+        out << directory_input.rdbuf();
+    }
+    WriteBinary(out, directory_offset);
+}
+
+void OfflineIndexer::Finish(const std::string &index_path)
+{
+    if (!documents_.is_open())
+    {
+        throw std::invalid_argument("Index is already finished"s);
+    }
+
+    SpillRun();
+    std::vector<char>().swap(records_);
+    std::vector<uint32_t>().swap(record_offsets_);
+    documents_.close();
+
+    std::ofstream out(index_path, std::ios::binary);
+    if (!out)
+    {
+        throw std::invalid_argument("Cannot create "s + index_path);
+    }
+    out.write(INDEX_FILE_MAGIC.data(), INDEX_FILE_MAGIC.size());
+
+    WriteBinary(out, static_cast<uint64_t>(tokenizer_.stop_words_.size()));
+    for (const auto &stop_word : tokenizer_.stop_words_)
+    {
+        WriteBinaryString(out, stop_word);
+    }
+
+    WriteBinary(out, static_cast<uint64_t>(document_ids_.size()));
+    if (!document_ids_.empty())
+    {
+        std::ifstream documents(documents_path_, std::ios::binary);
+        out << documents.rdbuf();
+    }
+
+    MergeRuns(out);
+    if (!out)
+    {
+        throw std::invalid_argument("Cannot write "s + index_path);
+    }
+    RemoveTempFiles();
+}
+
+size_t OfflineIndexer::GetDocumentCount() const
+{
+    return document_ids_.size();
+}
+
+size_t OfflineIndexer::GetRunCount() const
+{
+    return run_paths_.size();
+}
+
+void OfflineIndexer::RemoveTempFiles()
+{
+    std::error_code error;
+    if (documents_.is_open())
+    {
+        documents_.close();
+    }
+    std::filesystem::remove(documents_path_, error);
+    if (!directory_path_.empty())
+    {
+        std::filesystem::remove(directory_path_, error);
+    }
+    for (const auto &path : run_paths_)
+    {
+        std::filesystem::remove(path, error);
+    }
+    run_paths_.clear();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+#include "search_server.h"
+
+struct OfflineIndexerOptions
+{
+    size_t memory_budget = 64 << 20;
+    std::string temp_directory;
+};
+
+// Builds an index file for SearchServer::OpenIndex from a stream of documents without
+// holding the whole corpus in memory. Postings are buffered in memory_budget bytes,
+// spilled to disk as sorted (term, document, frequency) runs and merged by Finish.
+// Besides the budget only the document being added and the set of added ids are held in memory.
+class OfflineIndexer
+{
+public:
+    template <typename StringContainer>
+    explicit OfflineIndexer(const StringContainer &stop_words, const OfflineIndexerOptions &options = {});
+    explicit OfflineIndexer(const std::string &stop_words_text, const OfflineIndexerOptions &options = {})
+        : OfflineIndexer(SplitIntoWords(stop_words_text), options) {}
+
+    OfflineIndexer(const OfflineIndexer &) = delete;
+    OfflineIndexer &operator=(const OfflineIndexer &) = delete;
+    ~OfflineIndexer();
+
+    void AddDocument(int document_id,
+                     std::string_view document,
+                     DocumentStatus status,
+                     const std::vector<int> &ratings);
+
+    void Finish(const std::string &index_path);
+
+    size_t GetDocumentCount() const;
+    size_t GetRunCount() const;
+
+private:
+    static const size_t MIN_RECORD_SIZE = sizeof(uint32_t) + 1 + sizeof(int) + sizeof(double);
+
+    const SearchServer tokenizer_;
+    const OfflineIndexerOptions options_;
+
+    std::vector<char> records_;
+    std::vector<uint32_t> record_offsets_;
+
+    std::string documents_path_;
+    std::ofstream documents_;
+    std::set<int> document_ids_;
+    std::string directory_path_;
+    std::vector<std::string> run_paths_;
+
+    void Open();
+    std::string MakeTempPath(std::string_view name) const;
+    void SpillRun();
+    void MergeRuns(std::ostream &out);
+    void RemoveTempFiles();
+};
+
+template <typename StringContainer>
+OfflineIndexer::OfflineIndexer(const StringContainer &stop_words, const OfflineIndexerOptions &options)
+    : tokenizer_(stop_words), options_(options)
+{
+    Open();
+}
@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <iterator>
+
+#include "prefix_dictionary.h"
+
+void PrefixDictionary::Add(int term_id, const std::vector<std::string_view> &words)
+{
+    const auto by_word = [&words](int lhs, int rhs)
+    {
+        return words[lhs] < words[rhs];
+    };
+
+    runs_.push_back({term_id});
+    while (runs_.size() > 1 && runs_[runs_.size() - 2].size() <= runs_.back().size())
+    {
+        std::vector<int> merged;
+        merged.reserve(runs_[runs_.size() - 2].size() + runs_.back().size());
+        std::merge(runs_[runs_.size() - 2].begin(), runs_[runs_.size() - 2].end(),
+                   runs_.back().begin(), runs_.back().end(),
+                   std::back_inserter(merged), by_word);
+        runs_.pop_back();
+        runs_.back() = std::move(merged);
+    }
+}
+
+std::vector<int> PrefixDictionary::FindByPrefix(std::string_view prefix,
+                                                const std::vector<std::string_view> &words,
+                                                size_t max_count) const
+{
+    std::vector<int> result;
+    for (const auto &run : runs_)
+    {
+        auto it = std::lower_bound(run.begin(), run.end(), prefix,
+                                   [&words](int term_id, std::string_view prefix)
+                                   {
+                                       return words[term_id] < prefix;
+                                   });
+        for (size_t count = 0; it != run.end() && count < max_count; ++it, ++count)
+        {
+            if (words[*it].substr(0, prefix.size()) != prefix)
+            {
+                break;
+            }
+            result.push_back(*it);
+        }
+    }
+
+    std::sort(result.begin(), result.end(),
+              [&words](int lhs, int rhs)
+              {
+                  return words[lhs] < words[rhs];
+              });
+    if (result.size() > max_count)
+    {
+        result.resize(max_count);
+    }
+    return result;
+}
+
+size_t PrefixDictionary::GetMemoryUsage() const
+{
+    size_t bytes = runs_.capacity() * sizeof(std::vector<int>);
+    for (const auto &run : runs_)
+    {
+        bytes += run.capacity() * sizeof(int);
+    }
+    return bytes;
+}
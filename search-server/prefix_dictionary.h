@@ -0,0 +1,18 @@
+#pragma once
+#include <string_view>
+#include <vector>
+
+class PrefixDictionary
+{
+public:
+    void Add(int term_id, const std::vector<std::string_view> &words);
+
+    std::vector<int> FindByPrefix(std::string_view prefix,
+                                  const std::vector<std::string_view> &words,
+                                  size_t max_count) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    std::vector<std::vector<int>> runs_;
+};
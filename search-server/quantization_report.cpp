@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <cmath>
+
+#include "quantization_report.h"
+
+QuantizationReport MeasureQuantizationLoss(const SearchServer &search_server,
+                                           const std::vector<std::string> &queries)
+{
+    QuantizationReport report;
+    size_t compared_count = 0;
+    double total_error = 0.0;
+    double total_overlap = 0.0;
+
+    for (const std::string &query : queries)
+    {
+        const auto exact = search_server.FindTopDocuments<TfIdfRanking>(query);
+        const auto quantized = search_server.FindTopDocuments<QuantizedTfIdfRanking>(query);
+        ++report.query_count;
+
+        if (exact.empty())
+        {
+            total_overlap += quantized.empty() ? 1.0 : 0.0;
+            continue;
+        }
+
+        size_t shared_count = 0;
+        for (const Document &document : exact)
+        {
+            const auto same = std::find_if(quantized.begin(), quantized.end(),
+                                           [&document](const Document &other)
+                                           {
+                                               return other.id == document.id;
+                                           });
+            if (same == quantized.end())
+            {
+                continue;
+            }
+            ++shared_count;
+            const double error = std::abs(same->relevance - document.relevance);
+            report.max_relevance_error = std::max(report.max_relevance_error, error);
+            total_error += error;
+            ++compared_count;
+        }
+        total_overlap += static_cast<double>(shared_count) / exact.size();
+    }
+
+    if (report.query_count > 0)
+    {
+        report.top_documents_overlap = total_overlap / report.query_count;
+    }
+    if (compared_count > 0)
+    {
+        report.mean_relevance_error = total_error / compared_count;
+    }
+    return report;
+}
+
+std::ostream &operator<<(std::ostream &out, const QuantizationReport &report)
+{
+    out << "{ queries = "s << report.query_count
+        << ", top_documents_overlap = "s << report.top_documents_overlap
+        << ", max_relevance_error = "s << report.max_relevance_error
+        << ", mean_relevance_error = "s << report.mean_relevance_error << " }"s;
+    return out;
+}
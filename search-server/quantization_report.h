@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "search_server.h"
+
+struct QuantizationReport
+{
+    size_t query_count = 0;
+    double top_documents_overlap = 0.0;
+    double max_relevance_error = 0.0;
+    double mean_relevance_error = 0.0;
+};
+
+QuantizationReport MeasureQuantizationLoss(const SearchServer &search_server,
+                                           const std::vector<std::string> &queries);
+
+std::ostream &operator<<(std::ostream &out, const QuantizationReport &report);
@@ -0,0 +1,77 @@
+#include <algorithm>
+
+#include "query_arena.h"
+
+namespace
+{
+    const size_t MAX_POOLED_BUFFERS = 4;
+}
+
+std::atomic<uint64_t> QueryArena::upstream_allocation_count_ = 0;
+thread_local std::vector<QueryArena::Buffer> QueryArena::pooled_buffers_;
+
+QueryArena::Buffer QueryArena::TakeBuffer()
+{
+    if (pooled_buffers_.empty())
+    {
+        ++upstream_allocation_count_;
+        return {std::make_unique<std::byte[]>(INITIAL_BUFFER_SIZE), INITIAL_BUFFER_SIZE};
+    }
+    Buffer buffer = std::move(pooled_buffers_.back());
+    pooled_buffers_.pop_back();
+    return buffer;
+}
+
+QueryArena::QueryArena() : buffer_(TakeBuffer()),
+                           resource_(buffer_.data.get(), buffer_.size, &upstream_)
+{
+}
+
+QueryArena::~QueryArena()
+{
+    resource_.release();
+
+    const size_t size = std::min(buffer_.size + upstream_.GetAllocatedBytes(), MAX_POOLED_BUFFER_SIZE);
+    if (size > buffer_.size)
+    {
+        buffer_.data.reset();
+        ++upstream_allocation_count_;
+        buffer_ = {std::make_unique<std::byte[]>(size), size};
+    }
+    if (pooled_buffers_.size() < MAX_POOLED_BUFFERS)
+    {
+        pooled_buffers_.push_back(std::move(buffer_));
+    }
+}
+
+std::pmr::memory_resource *QueryArena::GetResource()
+{
+    return &resource_;
+}
+
+uint64_t QueryArena::GetUpstreamAllocationCount()
+{
+    return upstream_allocation_count_;
+}
+
+size_t QueryArena::CountingResource::GetAllocatedBytes() const
+{
+    return allocated_bytes_;
+}
+
+void *QueryArena::CountingResource::do_allocate(size_t bytes, size_t alignment)
+{
+    ++upstream_allocation_count_;
+    allocated_bytes_ += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void QueryArena::CountingResource::do_deallocate(void *pointer, size_t bytes, size_t alignment)
+{
+    std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+}
+
+bool QueryArena::CountingResource::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
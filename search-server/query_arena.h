@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Scratch memory for the temporary containers of one query. The buffer is taken from
+// a thread-local pool and grown to the size the previous queries needed, so on a warmed up
+// thread the arena itself does not call the global allocator; everything allocated from
+// the arena is released at once when it is destroyed. A pooled buffer grows at most to
+// MAX_POOLED_BUFFER_SIZE, so one huge query does not pin its memory on the thread; larger
+// queries take the rest from the global allocator every time.
+class QueryArena
+{
+public:
+    QueryArena();
+    QueryArena(const QueryArena &) = delete;
+    QueryArena &operator=(const QueryArena &) = delete;
+    ~QueryArena();
+
+    std::pmr::memory_resource *GetResource();
+
+    // Allocations that went past the pooled buffers to the global allocator. Containers of a query
+    // that are not allocated from an arena, such as the returned documents, are not counted.
+    static uint64_t GetUpstreamAllocationCount();
+
+private:
+    class CountingResource : public std::pmr::memory_resource
+    {
+    public:
+        size_t GetAllocatedBytes() const;
+
+    private:
+        size_t allocated_bytes_ = 0;
+
+        void *do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void *pointer, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+    };
+
+    struct Buffer
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+
+    static const size_t INITIAL_BUFFER_SIZE = 64 << 10;
+    static constexpr size_t MAX_POOLED_BUFFER_SIZE = 8 << 20;
+
+    static std::atomic<uint64_t> upstream_allocation_count_;
+    static thread_local std::vector<Buffer> pooled_buffers_;
+
+    Buffer buffer_;
+    CountingResource upstream_;
+    std::pmr::monotonic_buffer_resource resource_;
+
+    static Buffer TakeBuffer();
+};
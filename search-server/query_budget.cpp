@@ -0,0 +1,61 @@
+#include <algorithm>
+
+#include "query_budget.h"
+
+QueryBudget::QueryBudget(const QueryOptions *options)
+    : options_(options),
+      block_size_(options == nullptr ? BLOCK_SIZE : std::max<size_t>(1, std::min(BLOCK_SIZE, options->max_postings)))
+{
+    if (options_ != nullptr && options_->max_postings == 0)
+    {
+        is_exhausted_ = true;
+    }
+}
+
+bool QueryBudget::IsLimited() const
+{
+    return options_ != nullptr &&
+           (options_->max_postings != std::numeric_limits<size_t>::max() ||
+            options_->deadline != std::chrono::steady_clock::time_point::max());
+}
+
+bool QueryBudget::IsExhausted() const
+{
+    return is_exhausted_ && !is_cancelled_;
+}
+
+void QueryBudget::ThrowIfCancelled() const
+{
+    if (is_cancelled_ || (options_ != nullptr && options_->cancellation.IsCancelled()))
+    {
+        throw QueryCancelled();
+    }
+}
+
+bool QueryBudget::Meter::Flush()
+{
+    const size_t spent = budget_->spent_postings_ += count_;
+    count_ = 0;
+
+    const QueryOptions *options = budget_->options_;
+    if (options == nullptr)
+    {
+        return true;
+    }
+    if (options->cancellation.IsCancelled())
+    {
+        budget_->is_cancelled_ = true;
+        budget_->is_exhausted_ = true;
+        return false;
+    }
+    if (spent > options->max_postings)
+    {
+        budget_->is_exhausted_ = true;
+        return false;
+    }
+    if (spent == options->max_postings || std::chrono::steady_clock::now() >= options->deadline)
+    {
+        budget_->is_exhausted_ = true;
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include "query_options.h"
+
+// Shared by the threads scoring one query. Each thread counts postings through its own
+// Meter, which reports to the budget every block and checks deadline and cancellation there.
+class QueryBudget
+{
+public:
+    class Meter
+    {
+    public:
+        explicit Meter(QueryBudget &budget) : budget_(&budget) {}
+        Meter(const Meter &) = delete;
+        Meter &operator=(const Meter &) = delete;
+
+        ~Meter()
+        {
+            budget_->spent_postings_ += count_;
+        }
+
+        bool Consume()
+        {
+            if (budget_->is_exhausted_.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+            return ++count_ < budget_->block_size_ || Flush();
+        }
+
+    private:
+        QueryBudget *budget_;
+        size_t count_ = 0;
+
+        bool Flush();
+    };
+
+    explicit QueryBudget(const QueryOptions *options);
+
+    bool IsLimited() const;
+    bool IsExhausted() const;
+    void ThrowIfCancelled() const;
+
+private:
+    static constexpr size_t BLOCK_SIZE = 1 << 10;
+
+    const QueryOptions *options_;
+    size_t block_size_;
+    std::atomic<size_t> spent_postings_ = 0;
+    std::atomic<bool> is_exhausted_ = false;
+    std::atomic<bool> is_cancelled_ = false;
+};
@@ -0,0 +1,65 @@
+#include <stdexcept>
+#include <string>
+
+#include "query_executor.h"
+
+using namespace std::string_literals;
+
+QueryExecutor::QueryExecutor(size_t thread_count)
+{
+    if (thread_count == 0)
+    {
+        throw std::invalid_argument("Query executor needs at least one thread"s);
+    }
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        threads_.emplace_back([this]
+                              {
+                                  Run();
+                              });
+    }
+}
+
+QueryExecutor::~QueryExecutor()
+{
+    {
+        std::lock_guard lock(mutex_);
+        is_stopping_ = true;
+    }
+    task_added_.notify_all();
+    for (auto &thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+void QueryExecutor::Submit(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    task_added_.notify_one();
+}
+
+void QueryExecutor::Run()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex_);
+            task_added_.wait(lock, [this]
+                             {
+                                 return is_stopping_ || !tasks_.empty();
+                             });
+            if (tasks_.empty())
+            {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
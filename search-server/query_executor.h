@@ -0,0 +1,29 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of threads running submitted tasks in order. Tasks queued before
+// destruction are still run.
+class QueryExecutor
+{
+public:
+    explicit QueryExecutor(size_t thread_count);
+    QueryExecutor(const QueryExecutor &) = delete;
+    QueryExecutor &operator=(const QueryExecutor &) = delete;
+    ~QueryExecutor();
+
+    void Submit(std::function<void()> task);
+
+private:
+    std::mutex mutex_;
+    std::condition_variable task_added_;
+    std::deque<std::function<void()>> tasks_;
+    bool is_stopping_ = false;
+    std::vector<std::thread> threads_;
+
+    void Run();
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "document.h"
+
+class CancellationToken
+{
+public:
+    CancellationToken() = default;
+
+    bool IsCancelled() const
+    {
+        return cancelled_ && cancelled_->load(std::memory_order_relaxed);
+    }
+
+private:
+    friend class CancellationSource;
+
+    explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> cancelled) : cancelled_(std::move(cancelled)) {}
+
+    std::shared_ptr<const std::atomic<bool>> cancelled_;
+};
+
+class CancellationSource
+{
+public:
+    CancellationSource() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void Cancel()
+    {
+        cancelled_->store(true, std::memory_order_relaxed);
+    }
+
+    CancellationToken GetToken() const
+    {
+        return CancellationToken(cancelled_);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+class QueryCancelled : public std::runtime_error
+{
+public:
+    QueryCancelled() : std::runtime_error("Query is cancelled") {}
+};
+
+// ANY ranks documents containing any plus word, ALL only those containing every plus word.
+// BOOLEAN reads the query as words joined by AND, OR, NOT and grouped with parentheses.
+enum class QueryMode
+{
+    ANY,
+    ALL,
+    BOOLEAN,
+};
+
+// A query stops scoring once max_postings postings are scored or the deadline passes
+// and returns the best documents found so far, with SearchResult::is_partial set.
+// Under a budget the plus words are scored from the highest IDF down.
+struct QueryOptions
+{
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    QueryMode mode = QueryMode::ANY;
+    CancellationToken cancellation;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    size_t max_postings = std::numeric_limits<size_t>::max();
+};
+
+struct SearchResult
+{
+    std::vector<Document> documents;
+    bool is_partial = false;
+};
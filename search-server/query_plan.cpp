@@ -0,0 +1,40 @@
+#include <string>
+
+#include "query_plan.h"
+
+using namespace std::string_literals;
+
+std::string_view GetQueryStrategyName(QueryStrategy strategy)
+{
+    switch (strategy)
+    {
+    case QueryStrategy::TERM_AT_A_TIME:
+        return "term-at-a-time";
+    case QueryStrategy::PARALLEL_DENSE:
+        return "parallel dense accumulator";
+    case QueryStrategy::DOCUMENT_AT_A_TIME:
+        return "document-at-a-time with pruning";
+    case QueryStrategy::INTERSECTION:
+        return "posting intersection";
+    }
+    return "unknown";
+}
+
+std::ostream &operator<<(std::ostream &out, const QueryPlan &plan)
+{
+    out << "{ strategy = "s << GetQueryStrategyName(plan.strategy)
+        << ", minus_filter = "s << (plan.filters_minus_words_first ? "bitmap first"s : "after scoring"s)
+        << ", plus_postings = "s << plan.plus_posting_count
+        << ", minus_postings = "s << plan.minus_posting_count
+        << ", top = "s << plan.result_count
+        << ", estimated_cost = "s << plan.estimated_cost
+        << ", term_at_a_time_cost = "s << plan.term_at_a_time_cost
+        << ", parallel_dense_cost = "s << plan.parallel_dense_cost
+        << ", document_at_a_time_cost = "s << plan.document_at_a_time_cost;
+    if (!plan.operator_tree.empty())
+    {
+        out << ", operator_tree = "s << plan.operator_tree;
+    }
+    out << " }"s;
+    return out;
+}
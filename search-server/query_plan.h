@@ -0,0 +1,35 @@
+#pragma once
+#include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
+
+enum class QueryStrategy
+{
+    TERM_AT_A_TIME,
+    PARALLEL_DENSE,
+    DOCUMENT_AT_A_TIME,
+    INTERSECTION,
+};
+
+// Chosen for every query run with QueryOptions and reported by SearchServer::Explain.
+// Costs are in units of one posting added to a dense accumulator; strategies that do not
+// fit the query are left at infinity.
+struct QueryPlan
+{
+    QueryStrategy strategy = QueryStrategy::TERM_AT_A_TIME;
+    bool filters_minus_words_first = false;
+    size_t plus_posting_count = 0;
+    size_t minus_posting_count = 0;
+    size_t result_count = 0;
+    double estimated_cost = 0.0;
+    double term_at_a_time_cost = std::numeric_limits<double>::infinity();
+    double parallel_dense_cost = std::numeric_limits<double>::infinity();
+    double document_at_a_time_cost = std::numeric_limits<double>::infinity();
+    // ALL and BOOLEAN queries, e.g. AND(cat[3], NOT(fluffy[1]))
+    std::string operator_tree;
+};
+
+std::string_view GetQueryStrategyName(QueryStrategy strategy);
+
+std::ostream &operator<<(std::ostream &out, const QueryPlan &plan);
@@ -0,0 +1,99 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Ranking policies are passed as a template parameter to FindTopDocuments,
+// so the per-posting score is inlined without virtual dispatch.
+// term_freq is the share of the document's words taken by the term,
+// word_count is the document length stored at AddDocument.
+// ComputeTermScoreBound is optional: an upper bound of the term score over documents whose
+// term_freq is at most max_term_freq. Policies providing it can be run document-at-a-time
+// with pruning by the query planner.
+
+struct TfIdfRanking
+{
+    static double ComputeInverseDocumentFreq(int document_count, size_t document_freq)
+    {
+        return std::log(document_count * 1.0 / document_freq);
+    }
+
+    static double ComputeTermScore(double term_freq, double inverse_document_freq,
+                                   uint32_t /*word_count*/, double /*average_word_count*/)
+    {
+        return term_freq * inverse_document_freq;
+    }
+
+    static double ComputeTermScoreBound(double max_term_freq, double inverse_document_freq,
+                                        double /*average_word_count*/)
+    {
+        return max_term_freq * inverse_document_freq;
+    }
+};
+
+struct Bm25Ranking
+{
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    static double ComputeInverseDocumentFreq(int document_count, size_t document_freq)
+    {
+        return std::log(1.0 + (document_count - document_freq + 0.5) / (document_freq + 0.5));
+    }
+
+    static double ComputeTermScore(double term_freq, double inverse_document_freq,
+                                   uint32_t word_count, double average_word_count)
+    {
+        const double occurrences = term_freq * word_count;
+        const double length_norm = K1 * (1.0 - B + B * word_count / average_word_count);
+        return inverse_document_freq * occurrences * (K1 + 1.0) / (occurrences + length_norm);
+    }
+
+    // For a fixed term_freq the score grows with the document length, this is its limit.
+    static double ComputeTermScoreBound(double max_term_freq, double inverse_document_freq,
+                                        double average_word_count)
+    {
+        return inverse_document_freq * max_term_freq * (K1 + 1.0) / (max_term_freq + K1 * B / average_word_count);
+    }
+};
+
+struct Bm25PlusRanking
+{
+    static constexpr double DELTA = 1.0;
+
+    static double ComputeInverseDocumentFreq(int document_count, size_t document_freq)
+    {
+        return Bm25Ranking::ComputeInverseDocumentFreq(document_count, document_freq);
+    }
+
+    static double ComputeTermScore(double term_freq, double inverse_document_freq,
+                                   uint32_t word_count, double average_word_count)
+    {
+        return Bm25Ranking::ComputeTermScore(term_freq, inverse_document_freq, word_count, average_word_count) +
+               inverse_document_freq * DELTA;
+    }
+
+    static double ComputeTermScoreBound(double max_term_freq, double inverse_document_freq,
+                                        double average_word_count)
+    {
+        return Bm25Ranking::ComputeTermScoreBound(max_term_freq, inverse_document_freq, average_word_count) +
+               inverse_document_freq * DELTA;
+    }
+};
+
+// TF-IDF scored from the quantized impact index built by SearchServer::BuildImpactIndex.
+// Falls back to exact TF-IDF while the impact index is not built or is stale.
+struct QuantizedTfIdfRanking : TfIdfRanking
+{
+};
+
+template <typename Ranking, typename = void>
+struct HasTermScoreBound : std::false_type
+{
+};
+
+template <typename Ranking>
+struct HasTermScoreBound<Ranking, std::void_t<decltype(Ranking::ComputeTermScoreBound(0.0, 0.0, 0.0))>> : std::true_type
+{
+};
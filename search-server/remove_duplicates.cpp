@@ -0,0 +1,27 @@
+#include "remove_duplicates.h"
+
+namespace
+{
+    void RemoveDocuments(SearchServer &search_server, const std::vector<int> &document_ids)
+    {
+        for (const int document_id : document_ids)
+        {
+            std::cout << "Found duplicate document id "s << document_id << std::endl;
+            search_server.RemoveDocument(document_id);
+        }
+        if (search_server.IsDocumentStorageFragmented())
+        {
+            search_server.CompactDocumentStorage();
+        }
+    }
+}
+
+void RemoveDuplicates(SearchServer &search_server)
+{
+    RemoveDocuments(search_server, search_server.FindDuplicates());
+}
+
+void RemoveDuplicates(SearchServer &search_server, double min_similarity)
+{
+    RemoveDocuments(search_server, search_server.FindDuplicates(min_similarity));
+}
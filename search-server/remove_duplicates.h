@@ -0,0 +1,6 @@
+#pragma once
+#include "search_server.h"
+
+void RemoveDuplicates(SearchServer &search_server);
+
+void RemoveDuplicates(SearchServer &search_server, double min_similarity);
@@ -4,9 +4,9 @@ std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query,
                                                    DocumentStatus status)
 {
     return AddFindRequest(raw_query,
-                          [&status](int document_id,
+                          [&status](int,
                                     DocumentStatus document_status,
-                                    int rating)
+                                    int)
                           {
                               return document_status == status;
                           });
@@ -0,0 +1,213 @@
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+#include "scoring_kernel.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SCORING_KERNEL_X86 1
+#include <immintrin.h>
+#include <x86intrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace
+{
+    void ScoreTermBlockScalar(const uint32_t *slots, const double *term_freqs, size_t count,
+                              double inverse_document_freq, double *accumulators)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            accumulators[slots[i]] += term_freqs[i] * inverse_document_freq;
+        }
+    }
+
+    size_t FindNextAtLeastScalar(const double *values, size_t first, size_t count, double threshold)
+    {
+        while (first < count && !(values[first] >= threshold))
+        {
+            ++first;
+        }
+        return first;
+    }
+
+#ifdef SCORING_KERNEL_X86
+    // Intrinsic headers start vectors from self-initialized "undefined" values.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+    // AVX2 has gathers but no scatter and no FMA under this target, so the tail and the
+    // stores stay scalar.
+    __attribute__((target("avx2"))) void ScoreTermBlockAvx2(const uint32_t *slots, const double *term_freqs, size_t count,
+                                                             double inverse_document_freq, double *accumulators)
+    {
+        const __m256d idf = _mm256_set1_pd(inverse_document_freq);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128i indexes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(slots + i));
+            const __m256d scores = _mm256_mul_pd(_mm256_loadu_pd(term_freqs + i), idf);
+            alignas(32) double sums[4];
+            _mm256_store_pd(sums, _mm256_add_pd(_mm256_i32gather_pd(accumulators, indexes, 8), scores));
+            accumulators[slots[i]] = sums[0];
+            accumulators[slots[i + 1]] = sums[1];
+            accumulators[slots[i + 2]] = sums[2];
+            accumulators[slots[i + 3]] = sums[3];
+        }
+        for (; i < count; ++i)
+        {
+            accumulators[slots[i]] += term_freqs[i] * inverse_document_freq;
+        }
+    }
+
+    __attribute__((target("avx2"))) size_t FindNextAtLeastAvx2(const double *values, size_t first, size_t count,
+                                                                double threshold)
+    {
+        const __m256d bound = _mm256_set1_pd(threshold);
+        for (; first + 4 <= count; first += 4)
+        {
+            const int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + first), bound, _CMP_GE_OQ));
+            if (mask != 0)
+            {
+                return first + __builtin_ctz(mask);
+            }
+        }
+        return FindNextAtLeastScalar(values, first, count, threshold);
+    }
+
+    // The explicit rounding variants keep the compiler from fusing the multiply and the add,
+    // and the tail is handled with masks so no scalar code is compiled with FMA available.
+    __attribute__((target("avx512f"))) void ScoreTermBlockAvx512(const uint32_t *slots, const double *term_freqs, size_t count,
+                                                                  double inverse_document_freq, double *accumulators)
+    {
+        const __m512d idf = _mm512_set1_pd(inverse_document_freq);
+        for (size_t i = 0; i < count; i += 8)
+        {
+            const __mmask8 mask = count - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (count - i)) - 1);
+            const __m256i indexes = _mm512_castsi512_si256(_mm512_maskz_loadu_epi32(mask, slots + i));
+            const __m512d scores = _mm512_mul_round_pd(_mm512_maskz_loadu_pd(mask, term_freqs + i), idf,
+                                                       _MM_FROUND_CUR_DIRECTION);
+            const __m512d sums = _mm512_add_round_pd(_mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, indexes, accumulators, 8),
+                                                     scores, _MM_FROUND_CUR_DIRECTION);
+            _mm512_mask_i32scatter_pd(accumulators, mask, indexes, sums, 8);
+        }
+    }
+
+    __attribute__((target("avx512f"))) size_t FindNextAtLeastAvx512(const double *values, size_t first, size_t count,
+                                                                     double threshold)
+    {
+        const __m512d bound = _mm512_set1_pd(threshold);
+        for (; first < count; first += 8)
+        {
+            const __mmask8 valid = count - first >= 8 ? 0xFF : static_cast<__mmask8>((1u << (count - first)) - 1);
+            const __mmask8 mask = _mm512_mask_cmp_pd_mask(valid, _mm512_maskz_loadu_pd(valid, values + first), bound, _CMP_GE_OQ);
+            if (mask != 0)
+            {
+                return first + __builtin_ctz(mask);
+            }
+        }
+        return count;
+    }
+#pragma GCC diagnostic pop
+#endif
+
+    SimdLevel DetectSimdLevel()
+    {
+#ifdef SCORING_KERNEL_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            return SimdLevel::AVX512;
+        }
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return SimdLevel::AVX2;
+        }
+#endif
+        return SimdLevel::SCALAR;
+    }
+
+    std::atomic<SimdLevel> &GetActiveSimdLevel()
+    {
+        static std::atomic<SimdLevel> level = GetSupportedSimdLevel();
+        return level;
+    }
+}
+
+SimdLevel GetSupportedSimdLevel()
+{
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+SimdLevel GetSimdLevel()
+{
+    return GetActiveSimdLevel().load(std::memory_order_relaxed);
+}
+
+void SetSimdLevel(SimdLevel level)
+{
+    if (level > GetSupportedSimdLevel())
+    {
+        throw std::invalid_argument("SIMD level is not supported by the processor"s);
+    }
+    GetActiveSimdLevel().store(level, std::memory_order_relaxed);
+}
+
+std::string_view GetSimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AVX2:
+        return "AVX2";
+    case SimdLevel::AVX512:
+        return "AVX-512";
+    default:
+        return "scalar";
+    }
+}
+
+void ScoreTermBlock(const uint32_t *slots, const double *term_freqs, size_t count,
+                    double inverse_document_freq, double *accumulators)
+{
+    switch (GetActiveSimdLevel().load(std::memory_order_relaxed))
+    {
+#ifdef SCORING_KERNEL_X86
+    case SimdLevel::AVX512:
+        ScoreTermBlockAvx512(slots, term_freqs, count, inverse_document_freq, accumulators);
+        return;
+    case SimdLevel::AVX2:
+        ScoreTermBlockAvx2(slots, term_freqs, count, inverse_document_freq, accumulators);
+        return;
+#endif
+    default:
+        ScoreTermBlockScalar(slots, term_freqs, count, inverse_document_freq, accumulators);
+    }
+}
+
+size_t FindNextAtLeast(const double *values, size_t first, size_t count, double threshold)
+{
+    switch (GetActiveSimdLevel().load(std::memory_order_relaxed))
+    {
+#ifdef SCORING_KERNEL_X86
+    case SimdLevel::AVX512:
+        return FindNextAtLeastAvx512(values, first, count, threshold);
+    case SimdLevel::AVX2:
+        return FindNextAtLeastAvx2(values, first, count, threshold);
+#endif
+    default:
+        return FindNextAtLeastScalar(values, first, count, threshold);
+    }
+}
+
+uint64_t ReadTimestampCounter()
+{
+#if defined(SCORING_KERNEL_X86) || (defined(_MSC_VER) && defined(_M_X64))
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Loops over contiguous score accumulators, dispatched by CPUID to AVX-512, AVX2 or scalar
+// code on first use. Every implementation rounds products and sums separately, so scores
+// are bit-identical to the scalar loop.
+enum class SimdLevel
+{
+    SCALAR,
+    AVX2,
+    AVX512,
+};
+
+SimdLevel GetSupportedSimdLevel();
+SimdLevel GetSimdLevel();
+// Lowers the level used by the kernels, e.g. to compare them; throws if the CPU lacks it.
+void SetSimdLevel(SimdLevel level);
+std::string_view GetSimdLevelName(SimdLevel level);
+
+// accumulators[slots[i]] += term_freqs[i] * inverse_document_freq. The SIMD versions gather
+// 4 or 8 accumulators, add and store them back, so a slot repeated within such a group would
+// keep only its last addition. Slots must be distinct, as the postings of one term are.
+// The precondition is not checked: the kernels run once per posting on the query path.
+void ScoreTermBlock(const uint32_t *slots, const double *term_freqs, size_t count,
+                    double inverse_document_freq, double *accumulators);
+
+// Position of the first value at or after first that is not below threshold, or count.
+size_t FindNextAtLeast(const double *values, size_t first, size_t count, double threshold);
+
+// Processor timestamp counter for cycle measurements, 0 where it is not available.
+uint64_t ReadTimestampCounter();
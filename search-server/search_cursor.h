@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "document.h"
+
+class SearchCursor
+{
+public:
+    SearchCursor() = default;
+
+    bool IsEnd() const
+    {
+        return is_end_;
+    }
+
+private:
+    friend class SearchServer;
+
+    SearchCursor(const Document &last, size_t query_hash) : has_position_(true),
+                                                            query_hash_(query_hash),
+                                                            relevance_(last.relevance),
+                                                            rating_(last.rating),
+                                                            id_(last.id) {}
+
+    static SearchCursor End()
+    {
+        SearchCursor cursor;
+        cursor.is_end_ = true;
+        return cursor;
+    }
+
+    bool has_position_ = false;
+    bool is_end_ = false;
+    size_t query_hash_ = 0;
+    double relevance_ = 0.0;
+    int rating_ = 0;
+    int id_ = 0;
+};
+
+struct SearchPage
+{
+    std::vector<Document> documents;
+    SearchCursor next;
+};
@@ -1,209 +1,1999 @@
 #include <numeric>
+#include <bitset>
+#include <charconv>
+#include <fstream>
+#include <thread>
+#include "index_file.h"
 #include "search_server.h"
 
+namespace
+{
+    void SortScoredTerms(std::vector<std::pair<int, double>> &scored_terms)
+    {
+        std::sort(scored_terms.begin(), scored_terms.end());
+        scored_terms.erase(std::unique(scored_terms.begin(), scored_terms.end(),
+                                       [](const auto &lhs, const auto &rhs)
+                                       {
+                                           return lhs.first == rhs.first;
+                                       }),
+                           scored_terms.end());
+    }
+}
+
+SearchServer::SearchServer(const SearchServer &other)
+    : stop_words_(other.stop_words_),
+      prefix_dictionary_(other.prefix_dictionary_),
+      max_prefix_expansions_(other.max_prefix_expansions_),
+      fuzzy_search_enabled_(other.fuzzy_search_enabled_),
+      fuzzy_dictionary_(other.fuzzy_dictionary_),
+      fuzzy_penalty_per_edit_(other.fuzzy_penalty_per_edit_),
+      impact_index_(other.impact_index_),
+      term_max_freqs_(other.term_max_freqs_),
+      duplicate_index_(other.duplicate_index_),
+      ids_of_docs_to_word_freqs_(other.ids_of_docs_to_word_freqs_),
+      forward_index_offsets_(other.forward_index_offsets_),
+      positional_index_enabled_(other.positional_index_enabled_),
+      term_positions_(other.term_positions_),
+      term_positions_offsets_(other.term_positions_offsets_),
+      documents_(other.documents_),
+      document_attributes_(other.document_attributes_),
+      document_ids_(other.document_ids_),
+      total_word_count_(other.total_word_count_),
+      query_executor_(other.query_executor_),
+      memory_budget_(other.memory_budget_),
+      budgeted_memory_usage_(other.budgeted_memory_usage_),
+      documents_since_memory_recount_(other.documents_since_memory_recount_)
+{
+    // Terms keep their ids, and every view into the arenas of other is replaced
+    term_id_to_word_.reserve(other.term_id_to_word_.size());
+    for (const std::string_view word : other.term_id_to_word_)
+    {
+        term_id_to_word_.push_back(term_pool_.Store(word));
+        word_to_term_id_.emplace(term_id_to_word_.back(), static_cast<int>(term_id_to_word_.size() - 1));
+    }
+    for (const auto &[word, postings] : other.word_to_document_freqs_)
+    {
+        word_to_document_freqs_.emplace(term_id_to_word_[other.word_to_term_id_.at(word)], postings);
+    }
+    for (auto &[document_id, document_data] : documents_)
+    {
+        document_data.text = document_texts_.Store(document_data.text);
+    }
+}
+
 void SearchServer::AddDocument(int document_id,
                                std::string_view document,
                                DocumentStatus status,
                                const std::vector<int> &ratings)
 {
 
-    if ((document_id < 0) || (documents_.count(document_id) > 0))
+    if ((document_id < 0) || (documents_.count(document_id) > 0))
+    {
+        throw std::invalid_argument("Invalid document ID"s);
+    }
+
+    const auto words = SplitIntoWordsNoStop(document);
+    if (HasMemoryBudget())
+    {
+        ReserveMemoryBudget(EstimateDocumentMemoryUsage(document, words), 1);
+    }
+    AddTokenizedDocument(document_id, document, status, ratings, words);
+}
+
+void SearchServer::AddTokenizedDocument(int document_id,
+                                        std::string_view document,
+                                        DocumentStatus status,
+                                        const std::vector<int> &ratings,
+                                        const std::vector<std::string_view> &words)
+{
+    impact_index_.reset();
+
+    documents_.emplace(document_id,
+                       DocumentData{
+                           document_texts_.Store(document),
+                           ComputeAverageRating(ratings),
+                           status,
+                           forward_index_offsets_.size() - 1,
+                           static_cast<uint32_t>(words.size())});
+    document_ids_.push_back(document_id);
+    document_attributes_.Add(document_id, documents_.at(document_id).rating, status, static_cast<uint32_t>(words.size()));
+
+    const double inv_word_count = 1.0 / words.size();
+    total_word_count_ += words.size();
+
+    std::map<int, double> term_freqs;
+    for (auto word : words)
+    {
+        const int term_id = GetOrAddTermId(word);
+        word_to_document_freqs_[term_id_to_word_[term_id]][document_id] += inv_word_count;
+        term_freqs[term_id] += inv_word_count;
+    }
+
+    for (const auto &[term_id, freq] : term_freqs)
+    {
+        ids_of_docs_to_word_freqs_.push_back({term_id, freq});
+        term_max_freqs_[term_id] = std::max(term_max_freqs_[term_id], freq);
+    }
+    forward_index_offsets_.push_back(ids_of_docs_to_word_freqs_.size());
+    AddDuplicateFingerprint(document_id);
+
+    if (positional_index_enabled_)
+    {
+        std::map<int, std::vector<uint32_t>> term_positions;
+        uint32_t position = 0;
+        for (std::string_view word : SplitIntoWords(document))
+        {
+            if (!IsStopWord(word))
+            {
+                term_positions[word_to_term_id_.at(word)].push_back(position);
+            }
+            ++position;
+        }
+        for (const auto &[term_id, positions] : term_positions)
+        {
+            AppendDeltaEncoded(term_positions_, positions);
+            term_positions_offsets_.push_back(term_positions_.size());
+        }
+    }
+}
+
+void SearchServer::AddDocuments(const std::vector<NewDocument> &batch)
+{
+    AddDocuments(std::execution::seq, batch);
+}
+
+void SearchServer::AddDocuments(const std::execution::sequenced_policy &, const std::vector<NewDocument> &batch)
+{
+    ValidateNewDocumentIds(batch);
+    std::vector<std::vector<std::string_view>> words(batch.size());
+    size_t batch_bytes = 0;
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        words[i] = SplitIntoWordsNoStop(batch[i].text);
+        if (HasMemoryBudget())
+        {
+            batch_bytes += EstimateDocumentMemoryUsage(batch[i].text, words[i]);
+        }
+    }
+    if (HasMemoryBudget())
+    {
+        ReserveMemoryBudget(batch_bytes, batch.size());
+    }
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        AddTokenizedDocument(batch[i].id, batch[i].text, batch[i].status, batch[i].ratings, words[i]);
+    }
+}
+
+void SearchServer::AddDocuments(const std::execution::parallel_policy &, const std::vector<NewDocument> &batch)
+{
+    AddDocuments(std::execution::par, batch, TokenizeDocuments(std::execution::par, batch));
+}
+
+std::vector<SearchServer::TokenizedDocument> SearchServer::TokenizeDocuments(const std::execution::parallel_policy &,
+                                                                             const std::vector<NewDocument> &batch) const
+{
+    std::vector<TokenizedDocument> tokenized(batch.size());
+    std::vector<char> is_valid(batch.size(), 1);
+    std::vector<size_t> indexes(batch.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(),
+                  [&](size_t index)
+                  {
+                      TokenizedDocument &result = tokenized[index];
+                      uint32_t position = 0;
+                      for (std::string_view word : SplitIntoWords(batch[index].text))
+                      {
+                          if (!IsValidWord(word))
+                          {
+                              is_valid[index] = 0;
+                              break;
+                          }
+                          if (!IsStopWord(word))
+                          {
+                              result.words.push_back(word);
+                              result.positions.push_back(position);
+                          }
+                          ++position;
+                      }
+                  });
+    // Exceptions must not leave a parallel algorithm, so the message is produced here.
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        if (!is_valid[i])
+        {
+            SplitIntoWordsNoStop(batch[i].text);
+        }
+    }
+    return tokenized;
+}
+
+void SearchServer::AddDocuments(const std::execution::parallel_policy &, const std::vector<NewDocument> &batch,
+                                const std::vector<TokenizedDocument> &tokenized)
+{
+    if (tokenized.size() != batch.size())
+    {
+        throw std::invalid_argument("Tokenized documents do not match the batch"s);
+    }
+    ValidateNewDocumentIds(batch);
+
+    if (HasMemoryBudget())
+    {
+        size_t batch_bytes = 0;
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            batch_bytes += EstimateDocumentMemoryUsage(batch[i].text, tokenized[i].words);
+        }
+        ReserveMemoryBudget(batch_bytes, batch.size());
+    }
+
+    std::vector<size_t> order(batch.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&batch](size_t lhs, size_t rhs)
+              {
+                  return batch[lhs].id < batch[rhs].id;
+              });
+
+    using PartialPostings = std::map<std::string_view, std::vector<std::pair<int, double>>>;
+    const size_t partition_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, std::max<size_t>(batch.size(), 1));
+    std::vector<std::pair<size_t, size_t>> partitions;
+    for (size_t i = 0; i < partition_count; ++i)
+    {
+        partitions.push_back({batch.size() * i / partition_count, batch.size() * (i + 1) / partition_count});
+    }
+
+    std::vector<PartialPostings> partial_indexes(partition_count);
+    std::transform(std::execution::par, partitions.begin(), partitions.end(), partial_indexes.begin(),
+                   [&](const std::pair<size_t, size_t> &partition)
+                   {
+                       PartialPostings postings;
+                       for (size_t i = partition.first; i < partition.second; ++i)
+                       {
+                           const size_t index = order[i];
+                           const double inv_word_count = 1.0 / tokenized[index].words.size();
+                           for (std::string_view word : tokenized[index].words)
+                           {
+                               auto &term_postings = postings[word];
+                               if (term_postings.empty() || term_postings.back().first != batch[index].id)
+                               {
+                                   term_postings.push_back({batch[index].id, 0.0});
+                               }
+                               term_postings.back().second += inv_word_count;
+                           }
+                       }
+                       return postings;
+                   });
+
+    impact_index_.reset();
+
+    std::map<int, std::vector<const std::vector<std::pair<int, double>> *>> term_to_partial_postings;
+    for (const auto &partial_index : partial_indexes)
+    {
+        for (const auto &[word, postings] : partial_index)
+        {
+            const int term_id = GetOrAddTermId(word);
+            word_to_document_freqs_[term_id_to_word_[term_id]];
+            term_to_partial_postings[term_id].push_back(&postings);
+        }
+    }
+
+    std::for_each(std::execution::par, term_to_partial_postings.begin(), term_to_partial_postings.end(),
+                  [this](const auto &term_postings)
+                  {
+                      auto &document_freqs = word_to_document_freqs_.find(term_id_to_word_[term_postings.first])->second;
+                      for (const auto *postings : term_postings.second)
+                      {
+                          for (const auto &[document_id, term_freq] : *postings)
+                          {
+                              document_freqs.emplace_hint(document_freqs.end(), document_id, term_freq);
+                          }
+                      }
+                  });
+
+    struct ForwardEntries
+    {
+        std::vector<TermFrequency> terms;
+        std::vector<uint8_t> positions;
+        std::vector<size_t> position_sizes;
+    };
+
+    std::vector<ForwardEntries> forward_entries(batch.size());
+    std::transform(std::execution::par, tokenized.begin(), tokenized.end(), forward_entries.begin(),
+                   [this](const TokenizedDocument &document)
+                   {
+                       std::map<int, std::pair<double, std::vector<uint32_t>>> term_entries;
+                       const double inv_word_count = 1.0 / document.words.size();
+                       for (size_t i = 0; i < document.words.size(); ++i)
+                       {
+                           auto &entry = term_entries[word_to_term_id_.find(document.words[i])->second];
+                           entry.first += inv_word_count;
+                           entry.second.push_back(document.positions[i]);
+                       }
+
+                       ForwardEntries result;
+                       for (const auto &[term_id, entry] : term_entries)
+                       {
+                           result.terms.push_back({term_id, entry.first});
+                           if (positional_index_enabled_)
+                           {
+                               const size_t size_before = result.positions.size();
+                               AppendDeltaEncoded(result.positions, entry.second);
+                               result.position_sizes.push_back(result.positions.size() - size_before);
+                           }
+                       }
+                       return result;
+                   });
+
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        const NewDocument &document = batch[i];
+        documents_.emplace(document.id,
+                           DocumentData{
+                               document_texts_.Store(document.text),
+                               ComputeAverageRating(document.ratings),
+                               document.status,
+                               forward_index_offsets_.size() - 1,
+                               static_cast<uint32_t>(tokenized[i].words.size())});
+        document_ids_.push_back(document.id);
+        document_attributes_.Add(document.id, documents_.at(document.id).rating, document.status,
+                                 static_cast<uint32_t>(tokenized[i].words.size()));
+        total_word_count_ += tokenized[i].words.size();
+
+        const ForwardEntries &entries = forward_entries[i];
+        ids_of_docs_to_word_freqs_.insert(ids_of_docs_to_word_freqs_.end(), entries.terms.begin(), entries.terms.end());
+        forward_index_offsets_.push_back(ids_of_docs_to_word_freqs_.size());
+        for (const auto &term : entries.terms)
+        {
+            term_max_freqs_[term.term_id] = std::max(term_max_freqs_[term.term_id], term.freq);
+        }
+        AddDuplicateFingerprint(document.id);
+
+        term_positions_.insert(term_positions_.end(), entries.positions.begin(), entries.positions.end());
+        for (const size_t size : entries.position_sizes)
+        {
+            term_positions_offsets_.push_back(term_positions_offsets_.back() + size);
+        }
+    }
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const
+{
+    return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(std::execution::seq, raw_query, status);
+}
+
+SearchPage SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, const SearchCursor &after) const
+{
+    return FindTopDocuments(std::execution::seq, raw_query, status, after);
+}
+
+SearchPage SearchServer::FindTopDocuments(std::string_view raw_query, const SearchCursor &after) const
+{
+    return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL, after);
+}
+
+SearchResult SearchServer::FindTopDocuments(std::string_view raw_query, const QueryOptions &options) const
+{
+    return FindTopDocuments<TfIdfRanking>(raw_query, options);
+}
+
+std::pmr::vector<std::string_view> SearchServer::OrderPlusWords(const Query &query) const
+{
+    std::pmr::vector<std::string_view> plus_words(query.plus_words, query.arena->GetResource());
+    if (query.budget->IsLimited())
+    {
+        std::stable_sort(plus_words.begin(), plus_words.end(),
+                         [this](std::string_view lhs, std::string_view rhs)
+                         {
+                             const auto lhs_postings = word_to_document_freqs_.find(lhs);
+                             const auto rhs_postings = word_to_document_freqs_.find(rhs);
+                             const size_t lhs_freq = lhs_postings == word_to_document_freqs_.end() ? 0 : lhs_postings->second.size();
+                             const size_t rhs_freq = rhs_postings == word_to_document_freqs_.end() ? 0 : rhs_postings->second.size();
+                             return lhs_freq < rhs_freq;
+                         });
+    }
+    return plus_words;
+}
+
+QueryPlan SearchServer::PlanQuery(const Query &query, bool can_change_strategy, bool can_prune,
+                                  bool can_run_parallel) const
+{
+    QueryPlan plan;
+    plan.result_count = MAX_RESULT_DOCUMENT_COUNT;
+
+    size_t longest_posting_count = 0;
+    const auto count_postings = [this](std::string_view word)
+    {
+        const auto postings = word_to_document_freqs_.find(word);
+        return postings == word_to_document_freqs_.end() ? size_t{0} : postings->second.size();
+    };
+    for (const std::string_view word : query.plus_words)
+    {
+        const size_t posting_count = count_postings(word);
+        plan.plus_posting_count += posting_count;
+        longest_posting_count = std::max(longest_posting_count, posting_count);
+    }
+    for (const auto &prefix : query.prefixes)
+    {
+        for (const int term_id : prefix.term_ids)
+        {
+            plan.plus_posting_count += count_postings(term_id_to_word_[term_id]);
+        }
+    }
+    for (const auto &correction : query.corrections)
+    {
+        plan.plus_posting_count += count_postings(term_id_to_word_[correction.term_id]);
+    }
+    for (const std::string_view word : query.minus_words)
+    {
+        plan.minus_posting_count += count_postings(word);
+    }
+
+    // Term- and document-at-a-time look each posting's document up in documents_, the dense
+    // accumulator reads the attribute columns instead. Term-at-a-time also pays tree steps
+    // in the accumulator per posting and per minus posting to erase it.
+    // The bitmap filter pays for the minus postings and saves the excluded share of steps.
+    const double plus_postings = static_cast<double>(plan.plus_posting_count);
+    const double minus_postings = static_cast<double>(plan.minus_posting_count);
+    const double document_count = static_cast<double>(documents_.size());
+    const double lookup_steps = std::log2(document_count + 2.0) * MAP_STEP_COST;
+    const double accumulator_steps = std::log2(std::min(plus_postings, document_count) + 2.0) * MAP_STEP_COST;
+    plan.term_at_a_time_cost = plus_postings * (1.0 + lookup_steps + accumulator_steps) + minus_postings * accumulator_steps;
+    plan.estimated_cost = plan.term_at_a_time_cost;
+
+    const double id_range = documents_.empty() ? 0.0 : documents_.rbegin()->first - documents_.begin()->first + 1.0;
+    const bool has_dense_ids = !documents_.empty() && id_range <= document_count * DENSE_ID_RANGE_FACTOR;
+    if (can_change_strategy && has_dense_ids && plan.minus_posting_count > 0)
+    {
+        const double excluded_share = std::min(1.0, minus_postings / document_count);
+        const double bitmap_cost = minus_postings + id_range * DENSE_SLOT_COST +
+                                   plus_postings * (lookup_steps + BITMAP_CHECK_COST +
+                                                    (1.0 - excluded_share) * (1.0 + accumulator_steps));
+        if (bitmap_cost < plan.term_at_a_time_cost)
+        {
+            plan.term_at_a_time_cost = bitmap_cost;
+            plan.estimated_cost = bitmap_cost;
+            plan.filters_minus_words_first = true;
+        }
+    }
+
+    if (!can_change_strategy || plan.plus_posting_count == 0 || !query.prefixes.empty() || !query.corrections.empty())
+    {
+        return plan;
+    }
+
+    if (can_run_parallel)
+    {
+        const double thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+        plan.parallel_dense_cost = plus_postings * DENSE_POSTING_COST / thread_count +
+                                   thread_count * PARALLEL_TASK_COST + document_count * DENSE_SLOT_COST + minus_postings;
+    }
+
+    // Once the top is full, the most frequent term usually has the smallest bound and stops
+    // driving the scan; it is then only probed for documents of the other terms. That needs
+    // at least a top's worth of documents from the other terms. Seeks never cost more than
+    // walking the whole list.
+    if (can_prune && query.phrases.empty())
+    {
+        const double longest_postings = static_cast<double>(longest_posting_count);
+        const double probe_steps = std::log2(longest_postings + 2.0) * MAP_STEP_COST;
+        const bool can_drop_longest = plus_postings - longest_postings >= plan.result_count;
+        const double driving_postings = can_drop_longest ? plus_postings - longest_postings : plus_postings;
+        const double probe_cost = driving_postings * probe_steps;
+        plan.document_at_a_time_cost = driving_postings * (lookup_steps + DOCUMENT_AT_A_TIME_POSTING_COST) +
+                                       (can_drop_longest ? std::min(longest_postings, probe_cost) : 0.0) +
+                                       std::min(minus_postings, probe_cost * query.minus_words.size());
+    }
+
+    if (plan.parallel_dense_cost < plan.estimated_cost)
+    {
+        plan.strategy = QueryStrategy::PARALLEL_DENSE;
+        plan.estimated_cost = plan.parallel_dense_cost;
+        plan.filters_minus_words_first = false;
+    }
+    if (plan.document_at_a_time_cost < plan.estimated_cost)
+    {
+        plan.strategy = QueryStrategy::DOCUMENT_AT_A_TIME;
+        plan.estimated_cost = plan.document_at_a_time_cost;
+        plan.filters_minus_words_first = false;
+    }
+    return plan;
+}
+
+std::vector<bool> SearchServer::MarkMinusDocuments(const Query &query) const
+{
+    const int first_document_id = documents_.begin()->first;
+    std::vector<bool> is_excluded(documents_.rbegin()->first - first_document_id + 1, false);
+    for (const std::string_view word : query.minus_words)
+    {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings == word_to_document_freqs_.end())
+        {
+            continue;
+        }
+        for (const auto &[document_id, _] : postings->second)
+        {
+            is_excluded[document_id - first_document_id] = true;
+        }
+    }
+    return is_excluded;
+}
+
+SearchServer::BooleanPlan SearchServer::MakeConjunctivePlan(const Query &query) const
+{
+    BooleanPlan plan;
+    if (query.plus_words.empty() && query.prefixes.empty() && query.correction_groups.empty())
+    {
+        return plan;
+    }
+
+    std::vector<int> operands;
+    for (const std::string_view word : query.plus_words)
+    {
+        operands.push_back(AddBooleanPlanTerm(word, 1.0, true, plan));
+    }
+    for (const auto &prefix : query.prefixes)
+    {
+        std::vector<QueryCorrection> expansions;
+        for (const int term_id : prefix.term_ids)
+        {
+            expansions.push_back({term_id, 1.0});
+        }
+        operands.push_back(AddBooleanPlanAlternatives(expansions, true, plan));
+    }
+    // Every misspelled word is an operand of its own, matched by any of its corrections. A
+    // correction that is also a plus word is scored once, as the plus word.
+    for (const auto &group : query.correction_groups)
+    {
+        std::vector<QueryCorrection> corrections;
+        for (const int term_id : group.term_ids)
+        {
+            const auto correction = std::find_if(query.corrections.begin(), query.corrections.end(),
+                                                 [term_id](const QueryCorrection &correction)
+                                                 {
+                                                     return correction.term_id == term_id;
+                                                 });
+            corrections.push_back({term_id, correction == query.corrections.end() ? 0.0 : correction->weight});
+        }
+        operands.push_back(AddBooleanPlanAlternatives(corrections, true, plan));
+    }
+    for (const std::string_view word : query.minus_words)
+    {
+        operands.push_back(AddBooleanPlanOperator(BooleanOperator::NOT, {AddBooleanPlanTerm(word, 1.0, false, plan)}, plan));
+    }
+
+    plan.root = AddBooleanPlanOperator(BooleanOperator::AND, std::move(operands), plan);
+    SortScoredTerms(plan.scored_terms);
+    return plan;
+}
+
+SearchServer::BooleanPlan SearchServer::MakeBooleanPlan(std::string_view raw_query) const
+{
+    const BooleanQuery boolean_query = ParseBooleanQuery(raw_query);
+
+    BooleanPlan plan;
+    if (boolean_query.root >= 0)
+    {
+        plan.root = AddBooleanPlanNode(boolean_query, boolean_query.root, false, plan);
+    }
+    SortScoredTerms(plan.scored_terms);
+    return plan;
+}
+
+int SearchServer::AddBooleanPlanNode(const BooleanQuery &boolean_query, int node, bool is_negated, BooleanPlan &plan) const
+{
+    const auto &query_node = boolean_query.nodes[node];
+    if (query_node.op == BooleanOperator::WORD)
+    {
+        if (query_node.word.find('"') != std::string_view::npos)
+        {
+            throw std::invalid_argument("Phrase queries are not supported in boolean mode"s);
+        }
+        std::string_view text = query_node.word;
+        const auto query_word = ParseQueryWord(text);
+        if (query_word.is_minus)
+        {
+            throw std::invalid_argument("Query word "s + std::string(query_node.word) + " is invalid"s);
+        }
+        if (query_word.is_prefix)
+        {
+            std::vector<QueryCorrection> expansions;
+            for (const int term_id : prefix_dictionary_.FindByPrefix(query_word.data, term_id_to_word_,
+                                                                      max_prefix_expansions_))
+            {
+                expansions.push_back({term_id, 1.0});
+            }
+            return AddBooleanPlanAlternatives(expansions, !is_negated, plan);
+        }
+        if (query_word.is_stop)
+        {
+            return -1;
+        }
+        if (fuzzy_search_enabled_ && !HasPostings(query_word.data))
+        {
+            return AddBooleanPlanAlternatives(FindCorrections(query_word.data), !is_negated, plan);
+        }
+        return AddBooleanPlanTerm(query_word.data, 1.0, !is_negated, plan);
+    }
+
+    std::vector<int> children;
+    for (const int child : query_node.children)
+    {
+        children.push_back(AddBooleanPlanNode(boolean_query, child, is_negated != (query_node.op == BooleanOperator::NOT), plan));
+    }
+    return AddBooleanPlanOperator(query_node.op, std::move(children), plan);
+}
+
+int SearchServer::AddBooleanPlanTerm(std::string_view word, double weight, bool is_scored, BooleanPlan &plan) const
+{
+    const auto postings = word_to_document_freqs_.find(word);
+    const bool has_postings = postings != word_to_document_freqs_.end() && !postings->second.empty();
+    plan.nodes.push_back({BooleanOperator::WORD, has_postings ? &postings->second : nullptr, {}, word});
+    if (is_scored && has_postings)
+    {
+        plan.scored_terms.push_back({word_to_term_id_.at(word), weight});
+    }
+    return static_cast<int>(plan.nodes.size()) - 1;
+}
+
+int SearchServer::AddBooleanPlanAlternatives(const std::vector<QueryCorrection> &terms, bool is_scored,
+                                             BooleanPlan &plan) const
+{
+    // Terms with a zero weight only match; without any term the operand matches nothing.
+    std::vector<int> alternatives;
+    for (const auto &[term_id, weight] : terms)
+    {
+        alternatives.push_back(AddBooleanPlanTerm(term_id_to_word_[term_id], weight, is_scored && weight > 0.0, plan));
+    }
+    if (alternatives.empty())
+    {
+        plan.nodes.push_back({BooleanOperator::WORD, nullptr, {}});
+        return static_cast<int>(plan.nodes.size()) - 1;
+    }
+    return AddBooleanPlanOperator(BooleanOperator::OR, std::move(alternatives), plan);
+}
+
+int SearchServer::AddBooleanPlanOperator(BooleanOperator op, std::vector<int> children, BooleanPlan &plan) const
+{
+    // Operands made only of stop words are dropped instead of matching nothing.
+    children.erase(std::remove(children.begin(), children.end(), -1), children.end());
+    if (children.empty())
+    {
+        return -1;
+    }
+    if (children.size() == 1 && op != BooleanOperator::NOT)
+    {
+        return children[0];
+    }
+    plan.nodes.push_back({op, nullptr, std::move(children)});
+    return static_cast<int>(plan.nodes.size()) - 1;
+}
+
+std::string SearchServer::FormatBooleanPlan(const BooleanPlan &plan, int node) const
+{
+    // Words show their posting counts; an operand without any term matches nothing
+    const auto &plan_node = plan.nodes[node];
+    if (plan_node.op == BooleanOperator::WORD)
+    {
+        if (plan_node.word.empty())
+        {
+            return "NOTHING"s;
+        }
+        return std::string(plan_node.word) + "["s + std::to_string(plan_node.postings ? plan_node.postings->size() : 0) + "]"s;
+    }
+
+    std::string text = plan_node.op == BooleanOperator::AND  ? "AND("s
+                       : plan_node.op == BooleanOperator::OR ? "OR("s
+                                                              : "NOT("s;
+    for (size_t i = 0; i < plan_node.children.size(); ++i)
+    {
+        text += (i == 0 ? ""s : ", "s) + FormatBooleanPlan(plan, plan_node.children[i]);
+    }
+    return text + ")"s;
+}
+
+std::vector<int> SearchServer::MatchBooleanNode(const BooleanPlan &plan, int node, QueryBudget::Meter &meter) const
+{
+    const auto &plan_node = plan.nodes[node];
+    if (plan_node.op == BooleanOperator::AND)
+    {
+        return IntersectBooleanNodes(plan, plan_node.children, meter);
+    }
+    if (plan_node.op == BooleanOperator::NOT)
+    {
+        return IntersectBooleanNodes(plan, {node}, meter);
+    }
+
+    std::vector<int> document_ids;
+    if (plan_node.op == BooleanOperator::WORD)
+    {
+        if (plan_node.postings)
+        {
+            document_ids.reserve(plan_node.postings->size());
+            for (const auto &[document_id, _] : *plan_node.postings)
+            {
+                if (!meter.Consume())
+                {
+                    break;
+                }
+                document_ids.push_back(document_id);
+            }
+        }
+        return document_ids;
+    }
+
+    std::vector<int> merged;
+    for (const int child : plan_node.children)
+    {
+        const auto child_document_ids = MatchBooleanNode(plan, child, meter);
+        merged.clear();
+        std::set_union(document_ids.begin(), document_ids.end(), child_document_ids.begin(), child_document_ids.end(),
+                       std::back_inserter(merged));
+        std::swap(document_ids, merged);
+    }
+    return document_ids;
+}
+
+std::vector<int> SearchServer::IntersectBooleanNodes(const BooleanPlan &plan, const std::vector<int> &nodes,
+                                                     QueryBudget::Meter &meter) const
+{
+    std::vector<std::vector<int>> materialized;
+    materialized.reserve(nodes.size() + 1);
+    std::vector<DocumentIdCursor> included;
+    std::vector<DocumentIdCursor> excluded;
+
+    for (const int node : nodes)
+    {
+        const bool is_excluded = plan.nodes[node].op == BooleanOperator::NOT;
+        const int operand = is_excluded ? plan.nodes[node].children[0] : node;
+        auto &cursors = is_excluded ? excluded : included;
+        if (plan.nodes[operand].op != BooleanOperator::WORD)
+        {
+            materialized.push_back(MatchBooleanNode(plan, operand, meter));
+            cursors.emplace_back(materialized.back());
+        }
+        else if (plan.nodes[operand].postings)
+        {
+            cursors.emplace_back(*plan.nodes[operand].postings);
+        }
+        else if (!is_excluded)
+        {
+            return {};
+        }
+    }
+
+    if (included.empty())
+    {
+        auto &all_document_ids = materialized.emplace_back();
+        all_document_ids.reserve(documents_.size());
+        for (const auto &[document_id, _] : documents_)
+        {
+            all_document_ids.push_back(document_id);
+        }
+        included.emplace_back(all_document_ids);
+    }
+
+    // Rarest operand drives; the others only seek to its ids, skipping everything in between.
+    std::sort(included.begin(), included.end(),
+              [](const DocumentIdCursor &lhs, const DocumentIdCursor &rhs)
+              {
+                  return lhs.GetSize() < rhs.GetSize();
+              });
+
+    std::vector<int> document_ids;
+    auto &driver = included[0];
+    while (!driver.IsEnd() && meter.Consume())
+    {
+        const int document_id = driver.GetDocumentId();
+        int next_document_id = document_id;
+        for (size_t i = 1; i < included.size(); ++i)
+        {
+            included[i].SeekTo(document_id);
+            if (included[i].IsEnd())
+            {
+                return document_ids;
+            }
+            next_document_id = std::max(next_document_id, included[i].GetDocumentId());
+        }
+        if (next_document_id != document_id)
+        {
+            driver.SeekTo(next_document_id);
+            continue;
+        }
+
+        const bool is_excluded = std::any_of(excluded.begin(), excluded.end(),
+                                             [document_id](DocumentIdCursor &cursor)
+                                             {
+                                                 cursor.SeekTo(document_id);
+                                                 return !cursor.IsEnd() && cursor.GetDocumentId() == document_id;
+                                             });
+        if (!is_excluded)
+        {
+            document_ids.push_back(document_id);
+        }
+        driver.Next();
+    }
+    return document_ids;
+}
+
+void SearchServer::EnableAsyncQueries(size_t thread_count)
+{
+    query_executor_ = std::make_shared<QueryExecutor>(thread_count);
+}
+
+size_t SearchServer::CountDocuments(std::string_view raw_query, const DocumentFilter &filter) const
+{
+    return CountDocuments(std::execution::seq, raw_query, filter);
+}
+
+size_t SearchServer::CountDocuments(const std::execution::sequenced_policy &, std::string_view raw_query,
+                                    const DocumentFilter &filter) const
+{
+    return CountMatchedDocuments(raw_query, {false, {}}, filter, 1).GetDocumentCount();
+}
+
+size_t SearchServer::CountDocuments(const std::execution::parallel_policy &, std::string_view raw_query,
+                                    const DocumentFilter &filter) const
+{
+    return CountMatchedDocuments(raw_query, {false, {}}, filter,
+                                 std::max<size_t>(std::thread::hardware_concurrency(), 1) * 4)
+        .GetDocumentCount();
+}
+
+FacetResult SearchServer::Facet(std::string_view raw_query, const FacetDimensions &dimensions,
+                                const DocumentFilter &filter) const
+{
+    return Facet(std::execution::seq, raw_query, dimensions, filter);
+}
+
+FacetResult SearchServer::Facet(const std::execution::sequenced_policy &, std::string_view raw_query,
+                                const FacetDimensions &dimensions, const DocumentFilter &filter) const
+{
+    return CountMatchedDocuments(raw_query, dimensions, filter, 1);
+}
+
+FacetResult SearchServer::Facet(const std::execution::parallel_policy &, std::string_view raw_query,
+                                const FacetDimensions &dimensions, const DocumentFilter &filter) const
+{
+    return CountMatchedDocuments(raw_query, dimensions, filter,
+                                 std::max<size_t>(std::thread::hardware_concurrency(), 1) * 4);
+}
+
+int SearchServer::GetDocumentCount() const
+{
+    return documents_.size();
+}
+
+void SearchServer::EnablePositionalIndex()
+{
+    if (!ids_of_docs_to_word_freqs_.empty())
+    {
+        throw std::logic_error("Positional index must be enabled before adding documents"s);
+    }
+    positional_index_enabled_ = true;
+}
+
+size_t SearchServer::GetPositionalIndexMemoryUsage() const
+{
+    return term_positions_.capacity() * sizeof(uint8_t) +
+           term_positions_offsets_.capacity() * sizeof(size_t);
+}
+
+void SearchServer::SetMaxPrefixExpansions(size_t max_expansions)
+{
+    max_prefix_expansions_ = max_expansions;
+}
+
+void SearchServer::EnableFuzzySearch(int max_distance, double penalty_per_edit)
+{
+    if (max_distance < 1 || max_distance > 2)
+    {
+        throw std::invalid_argument("Fuzzy search supports edit distance 1 or 2"s);
+    }
+    if (!(penalty_per_edit > 0.0 && penalty_per_edit <= 1.0))
+    {
+        throw std::invalid_argument("Fuzzy search penalty must be in (0, 1]"s);
+    }
+
+    fuzzy_search_enabled_ = true;
+    fuzzy_penalty_per_edit_ = penalty_per_edit;
+    fuzzy_dictionary_ = FuzzyDictionary(max_distance);
+    for (size_t term_id = 0; term_id < term_id_to_word_.size(); ++term_id)
+    {
+        fuzzy_dictionary_.Add(static_cast<int>(term_id), term_id_to_word_[term_id]);
+    }
+}
+
+size_t SearchServer::GetFuzzyIndexMemoryUsage() const
+{
+    return fuzzy_dictionary_.GetMemoryUsage();
+}
+
+void SearchServer::EnableDuplicateDetection(int band_count, int rows_per_band)
+{
+    duplicate_index_.emplace(band_count, rows_per_band);
+    for (const int document_id : document_ids_)
+    {
+        AddDuplicateFingerprint(document_id);
+    }
+}
+
+std::vector<int> SearchServer::FindDuplicates() const
+{
+    std::vector<int> duplicates;
+    const auto add_duplicates = [&](const std::vector<int> &candidates)
+    {
+        std::vector<int> originals;
+        for (const int document_id : candidates)
+        {
+            const auto original = std::find_if(originals.begin(), originals.end(),
+                                               [&](int original_id)
+                                               {
+                                                   return HaveSameTermSet(original_id, document_id);
+                                               });
+            if (original == originals.end())
+            {
+                originals.push_back(document_id);
+            }
+            else if (*original > document_id)
+            {
+                duplicates.push_back(std::exchange(*original, document_id));
+            }
+            else
+            {
+                duplicates.push_back(document_id);
+            }
+        }
+    };
+
+    if (duplicate_index_)
+    {
+        duplicate_index_->ForEachExactCandidates(add_duplicates);
+    }
+    else
+    {
+        std::unordered_map<uint64_t, std::vector<int>> candidates;
+        for (const auto &[document_id, document_data] : documents_)
+        {
+            const auto terms = ids_of_docs_to_word_freqs_.data();
+            const size_t slot = document_data.forward_index_slot;
+            candidates[DuplicateIndex::HashTermSet(terms + forward_index_offsets_[slot],
+                                                   terms + forward_index_offsets_[slot + 1])]
+                .push_back(document_id);
+        }
+        for (const auto &[set_hash, document_ids] : candidates)
+        {
+            add_duplicates(document_ids);
+        }
+    }
+
+    std::sort(duplicates.begin(), duplicates.end());
+    return duplicates;
+}
+
+std::vector<int> SearchServer::FindDuplicates(double min_similarity) const
+{
+    if (!(min_similarity > 0.0 && min_similarity <= 1.0))
+    {
+        throw std::invalid_argument("Duplicate similarity must be in (0, 1]"s);
+    }
+    if (min_similarity == 1.0)
+    {
+        return FindDuplicates();
+    }
+    if (!duplicate_index_)
+    {
+        throw std::invalid_argument("Near duplicate search needs EnableDuplicateDetection"s);
+    }
+
+    // Union-find over candidate pairs; each group is represented by its smallest id. A pair is
+    // verified only in the first band whose bucket it shares, and a document is compared with at
+    // most MAX_DUPLICATE_FAN_OUT documents before it in a bucket, so a bucket costs linear time.
+    // Members of a large group are still joined through their other neighbours.
+    std::unordered_map<int, int> parents;
+    const auto find_root = [&](int document_id)
+    {
+        auto parent = parents.try_emplace(document_id, document_id).first;
+        while (parent->second != document_id)
+        {
+            const int grandparent = parents.at(parent->second);
+            parent->second = grandparent;
+            document_id = grandparent;
+            parent = parents.find(document_id);
+        }
+        return document_id;
+    };
+    const auto union_candidates = [&](int band, const std::vector<int> &candidates)
+    {
+        for (size_t j = 1; j < candidates.size(); ++j)
+        {
+            for (size_t i = j > MAX_DUPLICATE_FAN_OUT ? j - MAX_DUPLICATE_FAN_OUT : 0; i < j; ++i)
+            {
+                const int lhs_root = find_root(candidates[i]);
+                const int rhs_root = find_root(candidates[j]);
+                if (lhs_root == rhs_root ||
+                    duplicate_index_->ShareEarlierBand(candidates[i], candidates[j], band) ||
+                    ComputeTermSetSimilarity(candidates[i], candidates[j]) < min_similarity)
+                {
+                    continue;
+                }
+                parents[std::max(lhs_root, rhs_root)] = std::min(lhs_root, rhs_root);
+            }
+        }
+    };
+    duplicate_index_->ForEachSimilarCandidates(union_candidates);
+
+    std::vector<int> duplicates;
+    for (const auto &[document_id, parent] : parents)
+    {
+        if (find_root(document_id) != document_id)
+        {
+            duplicates.push_back(document_id);
+        }
+    }
+    std::sort(duplicates.begin(), duplicates.end());
+    return duplicates;
+}
+
+size_t SearchServer::GetDuplicateIndexMemoryUsage() const
+{
+    return duplicate_index_ ? duplicate_index_->GetMemoryUsage() : 0;
+}
+
+void SearchServer::BuildImpactIndex(ImpactPrecision precision)
+{
+    std::vector<double> inverse_document_freqs(term_id_to_word_.size(), 0.0);
+    double max_impact = 0.0;
+    size_t posting_count = 0;
+    size_t document_id_bytes = 0;
+    for (size_t term_id = 0; term_id < term_id_to_word_.size(); ++term_id)
+    {
+        const auto postings = word_to_document_freqs_.find(term_id_to_word_[term_id]);
+        if (postings == word_to_document_freqs_.end() || postings->second.empty())
+        {
+            continue;
+        }
+        inverse_document_freqs[term_id] = TfIdfRanking::ComputeInverseDocumentFreq(GetDocumentCount(),
+                                                                                   postings->second.size());
+        posting_count += postings->second.size();
+        int previous_document_id = 0;
+        for (const auto &[document_id, term_freq] : postings->second)
+        {
+            max_impact = std::max(max_impact, term_freq * inverse_document_freqs[term_id]);
+            document_id_bytes += GetVarintSize(static_cast<uint32_t>(document_id - previous_document_id));
+            previous_document_id = document_id;
+        }
+    }
+
+    static const std::map<int, double> no_postings;
+    ImpactIndex impact_index(precision, max_impact);
+    impact_index.Reserve(term_id_to_word_.size(), posting_count, document_id_bytes);
+    for (size_t term_id = 0; term_id < term_id_to_word_.size(); ++term_id)
+    {
+        const auto postings = word_to_document_freqs_.find(term_id_to_word_[term_id]);
+        impact_index.AddTerm(postings == word_to_document_freqs_.end() ? no_postings : postings->second,
+                             inverse_document_freqs[term_id]);
+    }
+    impact_index_ = std::move(impact_index);
+}
+
+bool SearchServer::IsImpactIndexBuilt() const
+{
+    return impact_index_.has_value();
+}
+
+size_t SearchServer::GetImpactIndexMemoryUsage() const
+{
+    return impact_index_ ? impact_index_->GetMemoryUsage() : 0;
+}
+
+size_t SearchServer::GetImpactIndexPostingCount() const
+{
+    return impact_index_ ? impact_index_->GetPostingCount() : 0;
+}
+
+MemoryUsage SearchServer::GetMemoryUsage() const
+{
+    MemoryUsage usage;
+    for (const auto &[word, postings] : word_to_document_freqs_)
+    {
+        usage.posting_lists += sizeof(std::pair<const std::string_view, std::map<int, double>>) + TREE_NODE_OVERHEAD +
+                               postings.size() * (sizeof(std::pair<const int, double>) + TREE_NODE_OVERHEAD);
+    }
+    usage.forward_index = ids_of_docs_to_word_freqs_.capacity() * sizeof(TermFrequency) +
+                          forward_index_offsets_.capacity() * sizeof(size_t);
+    usage.document_texts = document_texts_.GetMemoryUsage();
+    usage.documents = documents_.size() * (sizeof(std::pair<const int, DocumentData>) + TREE_NODE_OVERHEAD);
+    usage.document_ids = document_ids_.capacity() * sizeof(int);
+
+    usage.term_dictionary = term_pool_.GetMemoryUsage() +
+                            word_to_term_id_.size() * (sizeof(std::pair<const std::string_view, int>) + TREE_NODE_OVERHEAD) +
+                            term_id_to_word_.capacity() * sizeof(std::string_view) +
+                            term_max_freqs_.capacity() * sizeof(double) +
+                            prefix_dictionary_.GetMemoryUsage();
+    for (const std::string &stop_word : stop_words_)
+    {
+        usage.term_dictionary += sizeof(std::string) + TREE_NODE_OVERHEAD;
+        const char *object = reinterpret_cast<const char *>(&stop_word);
+        if (stop_word.data() < object || stop_word.data() >= object + sizeof(std::string))
+        {
+            usage.term_dictionary += stop_word.capacity() + 1;
+        }
+    }
+
+    usage.positional_index = GetPositionalIndexMemoryUsage();
+    usage.fuzzy_index = GetFuzzyIndexMemoryUsage();
+    usage.duplicate_index = GetDuplicateIndexMemoryUsage();
+    usage.impact_index = GetImpactIndexMemoryUsage();
+    usage.attribute_index = document_attributes_.GetMemoryUsage();
+    return usage;
+}
+
+TermMemoryUsage SearchServer::GetTermMemoryUsage(std::string_view word) const
+{
+    const auto postings = word_to_document_freqs_.find(word);
+    if (postings == word_to_document_freqs_.end())
+    {
+        return {};
+    }
+    return GetTermMemoryUsage(postings->first, postings->second);
+}
+
+std::vector<TermMemoryUsage> SearchServer::GetHeaviestTerms(size_t count) const
+{
+    std::vector<TermMemoryUsage> terms;
+    terms.reserve(word_to_document_freqs_.size());
+    for (const auto &[word, postings] : word_to_document_freqs_)
+    {
+        terms.push_back(GetTermMemoryUsage(word, postings));
+    }
+
+    count = std::min(count, terms.size());
+    std::partial_sort(terms.begin(), terms.begin() + count, terms.end(),
+                      [](const TermMemoryUsage &lhs, const TermMemoryUsage &rhs)
+                      {
+                          return lhs.bytes > rhs.bytes || (lhs.bytes == rhs.bytes && lhs.word < rhs.word);
+                      });
+    terms.resize(count);
+    return terms;
+}
+
+void SearchServer::SetMemoryBudget(size_t max_bytes)
+{
+    memory_budget_ = max_bytes;
+    budgeted_memory_usage_ = GetMemoryUsage().GetTotal();
+    documents_since_memory_recount_ = 0;
+}
+
+bool SearchServer::FitsMemoryBudget(std::string_view document) const
+{
+    if (!HasMemoryBudget())
+    {
+        return true;
+    }
+    const size_t bytes = EstimateDocumentMemoryUsage(document, SplitIntoWordsNoStop(document));
+    return budgeted_memory_usage_ + bytes <= memory_budget_ ||
+           GetMemoryUsage().GetTotal() + bytes <= memory_budget_;
+}
+
+std::vector<int>::const_iterator SearchServer::begin() const
+{
+    return document_ids_.begin();
+}
+
+std::vector<int>::const_iterator SearchServer::end() const
+{
+    return document_ids_.end();
+}
+
+WordFrequenciesView SearchServer::GetWordFrequencies(int document_id) const
+{
+    const auto document = documents_.find(document_id);
+    if (document == documents_.end())
+    {
+        return {};
+    }
+    const size_t slot = document->second.forward_index_slot;
+    return {ids_of_docs_to_word_freqs_.data() + forward_index_offsets_[slot],
+            ids_of_docs_to_word_freqs_.data() + forward_index_offsets_[slot + 1],
+            term_id_to_word_};
+}
+
+std::map<std::string_view, double> SearchServer::GetWordFrequenciesMap(int document_id) const
+{
+    return GetWordFrequencies(document_id).ToMap();
+}
+
+void SearchServer::RemoveDocument(int document_id)
+{
+    RemoveDocument(std::execution::seq, document_id);
+}
+
+void SearchServer::RemoveDocument(const std::execution::sequenced_policy &, int document_id)
+{
+    auto temporary = std::find(document_ids_.begin(), document_ids_.end(), document_id);
+
+    if (temporary == document_ids_.end())
+    {
+        return;
+    }
+    else
+    {
+        document_ids_.erase(temporary);
+    }
+
+    impact_index_.reset();
+    if (duplicate_index_)
+    {
+        duplicate_index_->Remove(document_id);
+    }
+    document_attributes_.Remove(document_id);
+    ReleaseMemoryBudget(document_id);
+    const auto &document_data = documents_.at(document_id);
+    total_word_count_ -= document_data.word_count;
+    document_texts_.Release(document_data.text);
+    documents_.erase(document_id);
+
+    std::for_each(word_to_document_freqs_.begin(),
+                  word_to_document_freqs_.end(),
+                  [&](auto &temporary)
+                  {
+                      temporary.second.erase(document_id);
+                  });
+}
+
+void SearchServer::RemoveDocument(const std::execution::parallel_policy &,
+                                  int document_id)
+{
+    auto temporary = std::find(std::execution::par,
+                               document_ids_.begin(),
+                               document_ids_.end(),
+                               document_id);
+
+    if (temporary == document_ids_.end())
+    {
+        return;
+    }
+    else
+    {
+        document_ids_.erase(temporary);
+    }
+
+    impact_index_.reset();
+    if (duplicate_index_)
+    {
+        duplicate_index_->Remove(document_id);
+    }
+    document_attributes_.Remove(document_id);
+    ReleaseMemoryBudget(document_id);
+    const auto &document_data = documents_.at(document_id);
+    total_word_count_ -= document_data.word_count;
+    document_texts_.Release(document_data.text);
+    documents_.erase(document_id);
+
+    std::for_each(std::execution::par,
+                  word_to_document_freqs_.begin(),
+                  word_to_document_freqs_.end(),
+                  [&](auto &temporary)
+                  {
+                      temporary.second.erase(document_id);
+                  });
+}
+
+void SearchServer::CompactDocumentStorage()
+{
+    TextArena document_texts(DOCUMENT_TEXT_CHUNK_SIZE);
+    std::vector<TermFrequency> forward_index;
+    std::vector<size_t> forward_index_offsets = {0};
+    std::vector<uint8_t> term_positions;
+    std::vector<size_t> term_positions_offsets = {0};
+
+    for (auto &[document_id, document_data] : documents_)
+    {
+        document_data.text = document_texts.Store(document_data.text);
+
+        const size_t slot = document_data.forward_index_slot;
+        for (size_t entry = forward_index_offsets_[slot]; entry < forward_index_offsets_[slot + 1]; ++entry)
+        {
+            forward_index.push_back(ids_of_docs_to_word_freqs_[entry]);
+            if (positional_index_enabled_)
+            {
+                term_positions.insert(term_positions.end(),
+                                      term_positions_.begin() + term_positions_offsets_[entry],
+                                      term_positions_.begin() + term_positions_offsets_[entry + 1]);
+                term_positions_offsets.push_back(term_positions.size());
+            }
+        }
+        document_data.forward_index_slot = forward_index_offsets.size() - 1;
+        forward_index_offsets.push_back(forward_index.size());
+    }
+
+    document_texts_ = std::move(document_texts);
+    ids_of_docs_to_word_freqs_ = std::move(forward_index);
+    forward_index_offsets_ = std::move(forward_index_offsets);
+    term_positions_ = std::move(term_positions);
+    term_positions_offsets_ = std::move(term_positions_offsets);
+    if (HasMemoryBudget())
+    {
+        budgeted_memory_usage_ = GetMemoryUsage().GetTotal();
+        documents_since_memory_recount_ = 0;
+    }
+}
+
+void SearchServer::ValidateNewDocumentIds(const std::vector<NewDocument> &batch) const
+{
+    std::vector<int> document_ids;
+    document_ids.reserve(batch.size());
+    for (const auto &document : batch)
+    {
+        if ((document.id < 0) || (documents_.count(document.id) > 0))
+        {
+            throw std::invalid_argument("Invalid document ID"s);
+        }
+        document_ids.push_back(document.id);
+    }
+
+    std::sort(document_ids.begin(), document_ids.end());
+    if (std::adjacent_find(document_ids.begin(), document_ids.end()) != document_ids.end())
+    {
+        throw std::invalid_argument("Duplicate document ID in batch"s);
+    }
+}
+
+bool SearchServer::IsDocumentStorageFragmented() const
+{
+    return document_texts_.GetReleasedBytes() > document_texts_.GetLiveBytes();
+}
+
+FacetResult SearchServer::CountMatchedDocuments(std::string_view raw_query, const FacetDimensions &dimensions,
+                                                const DocumentFilter &filter, size_t chunk_count) const
+{
+    QueryArena arena;
+    const Query query = ParseQuery(raw_query, arena);
+
+    std::vector<const std::map<int, double> *> plus_postings;
+    for (const std::string_view word : query.plus_words)
+    {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings != word_to_document_freqs_.end())
+        {
+            plus_postings.push_back(&postings->second);
+        }
+    }
+    // Counting only needs the union of a prefix's words, so their postings are not merged
+    for (const auto &prefix : query.prefixes)
+    {
+        for (const int term_id : prefix.term_ids)
+        {
+            const auto postings = word_to_document_freqs_.find(term_id_to_word_[term_id]);
+            if (postings != word_to_document_freqs_.end())
+            {
+                plus_postings.push_back(&postings->second);
+            }
+        }
+    }
+    for (const auto &correction : query.corrections)
+    {
+        plus_postings.push_back(&word_to_document_freqs_.at(term_id_to_word_[correction.term_id]));
+    }
+    std::vector<const std::map<int, double> *> minus_postings;
+    for (const std::string_view word : query.minus_words)
+    {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings != word_to_document_freqs_.end())
+        {
+            minus_postings.push_back(&postings->second);
+        }
+    }
+    const std::vector<int> phrase_documents = FindPhraseDocuments(query.phrases);
+    const bool counts_every_match = query.phrases.empty() && filter.MatchesAll() &&
+                                    !dimensions.by_status && dimensions.rating_bounds.empty();
+
+    // Chunks cover whole 64-bit words of positions, so every chunk owns its bitmap.
+    const size_t document_count = document_attributes_.GetSize();
+    const size_t word_count = (document_count + 63) / 64;
+    chunk_count = std::clamp<size_t>(chunk_count, 1, std::max<size_t>(word_count, 1));
+    std::vector<FacetResult> results(chunk_count, FacetResult(dimensions));
+    const auto count_chunk = [&](size_t chunk)
+    {
+        const size_t first_position = 64 * (word_count * chunk / chunk_count);
+        const size_t last_position = std::min(document_count, 64 * (word_count * (chunk + 1) / chunk_count));
+        std::vector<uint64_t> matched((last_position - first_position + 63) / 64, 0);
+        for (const auto *postings : plus_postings)
+        {
+            document_attributes_.ForEachPosition(*postings, first_position, last_position,
+                                                 [&](size_t position, double)
+                                                 {
+                                                     const size_t bit = position - first_position;
+                                                     matched[bit / 64] |= uint64_t{1} << (bit % 64);
+                                                     return true;
+                                                 });
+        }
+        for (const auto *postings : minus_postings)
+        {
+            document_attributes_.ForEachPosition(*postings, first_position, last_position,
+                                                 [&](size_t position, double)
+                                                 {
+                                                     const size_t bit = position - first_position;
+                                                     matched[bit / 64] &= ~(uint64_t{1} << (bit % 64));
+                                                     return true;
+                                                 });
+        }
+
+        FacetResult &result = results[chunk];
+        for (size_t word = 0; word < matched.size(); ++word)
+        {
+            if (counts_every_match)
+            {
+                result.counts[0][0] += std::bitset<64>(matched[word]).count();
+                continue;
+            }
+            for (uint64_t bits = matched[word]; bits != 0; bits &= bits - 1)
+            {
+                const size_t bit = std::bitset<64>((bits & (~bits + 1)) - 1).count();
+                const size_t position = first_position + 64 * word + bit;
+                const int document_id = document_attributes_.GetDocumentId(position);
+                const DocumentStatus status = document_attributes_.GetStatus(position);
+                const int rating = document_attributes_.GetRating(position);
+                if (!query.phrases.empty() &&
+                    !std::binary_search(phrase_documents.begin(), phrase_documents.end(), document_id))
+                {
+                    continue;
+                }
+                if (filter(document_id, status, rating))
+                {
+                    result.Add(status, rating);
+                }
+            }
+        }
+    };
+
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    if (chunk_count == 1)
+    {
+        count_chunk(0);
+    }
+    else
+    {
+        std::for_each(std::execution::par, chunks.begin(), chunks.end(), count_chunk);
+    }
+    for (size_t chunk = 1; chunk < chunk_count; ++chunk)
+    {
+        results.front().Merge(results[chunk]);
+    }
+    return results.front();
+}
+
+bool SearchServer::HasMemoryBudget() const
+{
+    return memory_budget_ != std::numeric_limits<size_t>::max();
+}
+
+TermMemoryUsage SearchServer::GetTermMemoryUsage(std::string_view word, const std::map<int, double> &postings) const
+{
+    return {word,
+            postings.size(),
+            sizeof(std::pair<const std::string_view, std::map<int, double>>) + TREE_NODE_OVERHEAD +
+                postings.size() * (sizeof(std::pair<const int, double>) + TREE_NODE_OVERHEAD + sizeof(TermFrequency)) +
+                word.size() + sizeof(std::pair<const std::string_view, int>) + TREE_NODE_OVERHEAD +
+                sizeof(std::string_view) + sizeof(double)};
+}
+
+size_t SearchServer::EstimateDocumentMemoryUsage(std::string_view document, const std::vector<std::string_view> &words) const
+{
+    const std::set<std::string_view> unique_words(words.begin(), words.end());
+
+    size_t bytes = document.size() + sizeof(std::pair<const int, DocumentData>) + TREE_NODE_OVERHEAD +
+                   sizeof(int) + sizeof(size_t) +
+                   2 * sizeof(int) + sizeof(DocumentStatus) + sizeof(uint32_t) +
+                   sizeof(std::pair<int, int>) + TREE_NODE_OVERHEAD;
+    for (const std::string_view word : unique_words)
+    {
+        bytes += sizeof(std::pair<const int, double>) + TREE_NODE_OVERHEAD + sizeof(TermFrequency);
+        if (word_to_term_id_.count(word) == 0)
+        {
+            bytes += GetTermMemoryUsage(word, {}).bytes + sizeof(int);
+        }
+    }
+    if (positional_index_enabled_)
+    {
+        bytes += words.size() * sizeof(uint32_t) + unique_words.size() * sizeof(size_t);
+    }
+    return bytes;
+}
+
+void SearchServer::ReserveMemoryBudget(size_t bytes, size_t document_count)
+{
+    documents_since_memory_recount_ += document_count;
+    if (budgeted_memory_usage_ + bytes > memory_budget_ ||
+        documents_since_memory_recount_ >= MEMORY_RECOUNT_INTERVAL)
+    {
+        budgeted_memory_usage_ = GetMemoryUsage().GetTotal();
+        documents_since_memory_recount_ = 0;
+    }
+    if (budgeted_memory_usage_ + bytes > memory_budget_)
+    {
+        throw std::runtime_error("Memory budget exceeded"s);
+    }
+    budgeted_memory_usage_ += bytes;
+}
+
+void SearchServer::ReleaseMemoryBudget(int document_id)
+{
+    if (!HasMemoryBudget())
+    {
+        return;
+    }
+    // The document's postings and its entry go back at once; its text and forward index
+    // entries stay allocated until the storage is compacted.
+    const size_t slot = documents_.at(document_id).forward_index_slot;
+    const size_t bytes = (forward_index_offsets_[slot + 1] - forward_index_offsets_[slot]) *
+                             (sizeof(std::pair<const int, double>) + TREE_NODE_OVERHEAD) +
+                         sizeof(std::pair<const int, DocumentData>) + TREE_NODE_OVERHEAD;
+    budgeted_memory_usage_ -= std::min(bytes, budgeted_memory_usage_);
+}
+
+void SearchServer::AddDuplicateFingerprint(int document_id)
+{
+    if (!duplicate_index_)
+    {
+        return;
+    }
+    const size_t slot = documents_.at(document_id).forward_index_slot;
+    duplicate_index_->Add(document_id,
+                          ids_of_docs_to_word_freqs_.data() + forward_index_offsets_[slot],
+                          ids_of_docs_to_word_freqs_.data() + forward_index_offsets_[slot + 1]);
+}
+
+bool SearchServer::HaveSameTermSet(int lhs_document_id, int rhs_document_id) const
+{
+    const size_t lhs_slot = documents_.at(lhs_document_id).forward_index_slot;
+    const size_t rhs_slot = documents_.at(rhs_document_id).forward_index_slot;
+    return std::equal(ids_of_docs_to_word_freqs_.begin() + forward_index_offsets_[lhs_slot],
+                      ids_of_docs_to_word_freqs_.begin() + forward_index_offsets_[lhs_slot + 1],
+                      ids_of_docs_to_word_freqs_.begin() + forward_index_offsets_[rhs_slot],
+                      ids_of_docs_to_word_freqs_.begin() + forward_index_offsets_[rhs_slot + 1],
+                      [](const TermFrequency &lhs, const TermFrequency &rhs)
+                      {
+                          return lhs.term_id == rhs.term_id;
+                      });
+}
+
+double SearchServer::ComputeTermSetSimilarity(int lhs_document_id, int rhs_document_id) const
+{
+    const size_t lhs_slot = documents_.at(lhs_document_id).forward_index_slot;
+    const size_t rhs_slot = documents_.at(rhs_document_id).forward_index_slot;
+    size_t lhs = forward_index_offsets_[lhs_slot];
+    size_t rhs = forward_index_offsets_[rhs_slot];
+    const size_t lhs_end = forward_index_offsets_[lhs_slot + 1];
+    const size_t rhs_end = forward_index_offsets_[rhs_slot + 1];
+    const size_t union_size = (lhs_end - lhs) + (rhs_end - rhs);
+
+    size_t common = 0;
+    while (lhs < lhs_end && rhs < rhs_end)
+    {
+        const int lhs_term = ids_of_docs_to_word_freqs_[lhs].term_id;
+        const int rhs_term = ids_of_docs_to_word_freqs_[rhs].term_id;
+        common += lhs_term == rhs_term;
+        lhs += lhs_term <= rhs_term;
+        rhs += rhs_term <= lhs_term;
+    }
+    return union_size == common ? 1.0 : static_cast<double>(common) / (union_size - common);
+}
+
+void SearchServer::OpenIndex(const std::string &index_path)
+{
+    if (!documents_.empty() || positional_index_enabled_)
+    {
+        throw std::invalid_argument("Index can be opened only by an empty server without positional index"s);
+    }
+
+    std::ifstream input(index_path, std::ios::binary);
+    if (ReadIndexHeader(input, index_path) != stop_words_)
+    {
+        throw std::invalid_argument("Index file was built with other stop words"s);
+    }
+
+    // The index is loaded into a separate server, so a broken file leaves this one empty.
+    SearchServer loaded(stop_words_);
+    loaded.fuzzy_search_enabled_ = fuzzy_search_enabled_;
+    loaded.fuzzy_dictionary_ = fuzzy_dictionary_;
+    loaded.fuzzy_penalty_per_edit_ = fuzzy_penalty_per_edit_;
+    loaded.duplicate_index_ = duplicate_index_;
+    loaded.ReadIndex(input);
+
+    term_pool_ = std::move(loaded.term_pool_);
+    word_to_term_id_ = std::move(loaded.word_to_term_id_);
+    term_id_to_word_ = std::move(loaded.term_id_to_word_);
+    prefix_dictionary_ = std::move(loaded.prefix_dictionary_);
+    fuzzy_dictionary_ = std::move(loaded.fuzzy_dictionary_);
+    term_max_freqs_ = std::move(loaded.term_max_freqs_);
+    duplicate_index_ = std::move(loaded.duplicate_index_);
+    word_to_document_freqs_ = std::move(loaded.word_to_document_freqs_);
+    ids_of_docs_to_word_freqs_ = std::move(loaded.ids_of_docs_to_word_freqs_);
+    forward_index_offsets_ = std::move(loaded.forward_index_offsets_);
+    documents_ = std::move(loaded.documents_);
+    document_attributes_ = std::move(loaded.document_attributes_);
+    document_ids_ = std::move(loaded.document_ids_);
+    total_word_count_ = loaded.total_word_count_;
+    impact_index_.reset();
+}
+
+void SearchServer::ReadIndex(std::istream &input)
+{
+    std::vector<std::vector<TermFrequency>> forward_index;
+    std::map<int, size_t> document_slots;
+    for (auto count = ReadBinary<uint64_t>(input); count > 0; --count)
+    {
+        const IndexDocument document = ReadIndexDocument(input);
+        if (!document_slots.emplace(document.id, forward_index.size()).second)
+        {
+            throw std::invalid_argument("Invalid document ID"s);
+        }
+        documents_.emplace(document.id, DocumentData{{}, document.rating, document.status, forward_index.size(),
+                                                     document.word_count});
+        document_ids_.push_back(document.id);
+        document_attributes_.Add(document.id, document.rating, document.status, document.word_count);
+        forward_index.emplace_back();
+        total_word_count_ += document.word_count;
+    }
+
+    std::string word;
+    for (ReadBinaryString(input, word); !word.empty(); ReadBinaryString(input, word))
+    {
+        const int term_id = GetOrAddTermId(word);
+        auto &postings = word_to_document_freqs_[term_id_to_word_[term_id]];
+        for (int document_id = ReadBinary<int>(input); document_id >= 0; document_id = ReadBinary<int>(input))
+        {
+            const double term_freq = ReadBinary<double>(input);
+            const auto slot = document_slots.find(document_id);
+            if (slot == document_slots.end())
+            {
+                throw std::invalid_argument("Invalid document in index file"s);
+            }
+            postings.emplace_hint(postings.end(), document_id, term_freq);
+            forward_index[slot->second].push_back({term_id, term_freq});
+            term_max_freqs_[term_id] = std::max(term_max_freqs_[term_id], term_freq);
+        }
+    }
+
+    for (const auto &entries : forward_index)
+    {
+        ids_of_docs_to_word_freqs_.insert(ids_of_docs_to_word_freqs_.end(), entries.begin(), entries.end());
+        forward_index_offsets_.push_back(ids_of_docs_to_word_freqs_.size());
+    }
+    for (const auto &[document_id, slot] : document_slots)
+    {
+        AddDuplicateFingerprint(document_id);
+    }
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query,
+                                                                                      int document_id) const
+{
+    return MatchDocument(std::execution::seq, raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy &,
+                                                                                      std::string_view raw_query,
+                                                                                      int document_id) const
+{
+
+    if ((document_id < 0) || (documents_.count(document_id) <= 0))
     {
-        throw std::invalid_argument("Invalid document ID"s);
+        throw std::invalid_argument("Non-existent document ID"s);
     }
 
-    auto [doc_id_, doc_data_] = documents_.emplace(document_id,
-                                                   DocumentData{
-                                                       std::string(document),
-                                                       ComputeAverageRating(ratings),
-                                                       status});
-    document_ids_.push_back(document_id);
+    QueryArena arena;
+    return MatchQueryTerms(ResolveQueryTerms(ParseQuery(raw_query, arena)), document_id);
+}
 
-    const auto words = SplitIntoWordsNoStop(doc_id_->second.data_string_);
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(std::string_view raw_query,
+                                                                                                    const std::vector<int> &document_ids) const
+{
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
 
-    const double inv_word_count = 1.0 / words.size();
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(const std::execution::sequenced_policy &,
+                                                                                                    std::string_view raw_query,
+                                                                                                    const std::vector<int> &document_ids) const
+{
+    ValidateMatchedDocumentIds(document_ids);
+    QueryArena arena;
+    const auto query_terms = ResolveQueryTerms(ParseQuery(raw_query, arena));
 
-    for (auto word : words)
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> result;
+    result.reserve(document_ids.size());
+    for (const int document_id : document_ids)
     {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        ids_of_docs_to_word_freqs_[document_id][word] += inv_word_count;
+        result.push_back(MatchQueryTerms(query_terms, document_id));
     }
+    return result;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(const std::execution::parallel_policy &,
+                                                                                                    std::string_view raw_query,
+                                                                                                    const std::vector<int> &document_ids) const
 {
-    return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
-}
+    ValidateMatchedDocumentIds(document_ids);
+    QueryArena arena;
+    const auto query_terms = ResolveQueryTerms(ParseQuery(raw_query, arena));
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const
-{
-    return FindTopDocuments(std::execution::seq, raw_query, status);
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> result(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), result.begin(),
+                   [this, &query_terms](int document_id)
+                   {
+                       return MatchQueryTerms(query_terms, document_id);
+                   });
+    return result;
 }
 
-int SearchServer::GetDocumentCount() const
+void SearchServer::ValidateMatchedDocumentIds(const std::vector<int> &document_ids) const
 {
-    return documents_.size();
+    for (const int document_id : document_ids)
+    {
+        if ((document_id < 0) || (documents_.count(document_id) <= 0))
+        {
+            throw std::invalid_argument("Non-existent document ID"s);
+        }
+    }
 }
 
-std::vector<int>::const_iterator SearchServer::begin() const
+int SearchServer::GetOrAddTermId(std::string_view word)
 {
-    return document_ids_.begin();
-}
+    const auto existing = word_to_term_id_.find(word);
+    if (existing != word_to_term_id_.end())
+    {
+        return existing->second;
+    }
 
-std::vector<int>::const_iterator SearchServer::end() const
-{
-    return document_ids_.end();
+    const int term_id = static_cast<int>(term_id_to_word_.size());
+    const std::string_view term = term_pool_.Store(word);
+    word_to_term_id_.emplace(term, term_id);
+    term_id_to_word_.push_back(term);
+    term_max_freqs_.push_back(0.0);
+    prefix_dictionary_.Add(term_id, term_id_to_word_);
+    if (fuzzy_search_enabled_)
+    {
+        fuzzy_dictionary_.Add(term_id, term);
+    }
+    return term_id;
 }
 
-const std::map<std::string_view, double> &SearchServer::GetWordFrequencies(int document_id) const
+std::vector<int> SearchServer::FindTermIds(const std::pmr::vector<std::string_view> &words) const
 {
-    static const std::map<std::string_view, double> emptyes;
-    return (!ids_of_docs_to_word_freqs_.count(document_id)) ? emptyes : ids_of_docs_to_word_freqs_.at(document_id);
+    std::vector<int> term_ids;
+    term_ids.reserve(words.size());
+    for (std::string_view word : words)
+    {
+        const auto it = word_to_term_id_.find(word);
+        if (it != word_to_term_id_.end())
+        {
+            term_ids.push_back(it->second);
+        }
+    }
+    std::sort(term_ids.begin(), term_ids.end());
+    return term_ids;
 }
 
-void SearchServer::RemoveDocument(int document_id)
+SearchServer::PhraseTerms SearchServer::ResolvePhrase(const QueryPhrase &phrase) const
 {
-    RemoveDocument(std::execution::seq, document_id);
+    PhraseTerms result{{}, phrase.offsets, phrase.slop};
+    for (std::string_view word : phrase.words)
+    {
+        const auto it = word_to_term_id_.find(word);
+        result.term_ids.push_back(it == word_to_term_id_.end() ? -1 : it->second);
+    }
+    return result;
 }
 
-void SearchServer::RemoveDocument(const std::execution::sequenced_policy &, int document_id)
+SearchServer::QueryTerms SearchServer::ResolveQueryTerms(const Query &query) const
 {
-    auto temporary = std::find(document_ids_.begin(), document_ids_.end(), document_id);
-
-    if (temporary == document_ids_.end())
+    QueryTerms result{FindTermIds(query.plus_words), FindTermIds(query.minus_words), {}};
+    for (const auto &prefix : query.prefixes)
     {
-        return;
+        result.plus_terms.insert(result.plus_terms.end(), prefix.term_ids.begin(), prefix.term_ids.end());
     }
-    else
+    for (const auto &correction : query.corrections)
     {
-        document_ids_.erase(temporary);
+        result.plus_terms.push_back(correction.term_id);
     }
-
-    documents_.erase(document_id);
-
-    std::for_each(word_to_document_freqs_.begin(),
-                  word_to_document_freqs_.end(),
-                  [&](auto &temporary)
-                  {
-                      temporary.second.erase(document_id);
-                  });
-}
-
-void SearchServer::RemoveDocument(const std::execution::parallel_policy &,
-                                  int document_id)
-{
-    auto temporary = std::find(std::execution::par,
-                               document_ids_.begin(),
-                               document_ids_.end(),
-                               document_id);
-
-    if (temporary == document_ids_.end())
+    std::sort(result.plus_terms.begin(), result.plus_terms.end());
+    result.plus_terms.erase(std::unique(result.plus_terms.begin(), result.plus_terms.end()),
+                            result.plus_terms.end());
+    if (!query.phrases.empty() && !positional_index_enabled_)
     {
-        return;
+        throw std::invalid_argument("Phrase queries require the positional index"s);
     }
-    else
+    for (const auto &phrase : query.phrases)
     {
-        document_ids_.erase(temporary);
+        result.phrases.push_back(ResolvePhrase(phrase));
     }
-
-    documents_.erase(document_id);
-
-    std::for_each(std::execution::par,
-                  word_to_document_freqs_.begin(),
-                  word_to_document_freqs_.end(),
-                  [&](auto &temporary)
-                  {
-                      temporary.second.erase(document_id);
-                  });
+    return result;
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query,
-                                                                                      int document_id) const
+std::vector<uint32_t> SearchServer::GetTermPositions(const DocumentData &document, int term_id) const
 {
-    return MatchDocument(std::execution::seq, raw_query, document_id);
+    const auto terms_begin = ids_of_docs_to_word_freqs_.begin() + forward_index_offsets_[document.forward_index_slot];
+    const auto terms_end = ids_of_docs_to_word_freqs_.begin() + forward_index_offsets_[document.forward_index_slot + 1];
+    const auto term = GallopingLowerBound(terms_begin, terms_end, term_id,
+                                          [](const TermFrequency &term, int term_id)
+                                          {
+                                              return term.term_id < term_id;
+                                          });
+    if (term == terms_end || term->term_id != term_id)
+    {
+        return {};
+    }
+    const size_t entry = term - ids_of_docs_to_word_freqs_.begin();
+    return DecodeDeltaEncoded(term_positions_.data() + term_positions_offsets_[entry],
+                              term_positions_.data() + term_positions_offsets_[entry + 1]);
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy &,
-                                                                                      std::string_view raw_query,
-                                                                                      int document_id) const
+bool SearchServer::MatchesPhrase(const PhraseTerms &phrase, const DocumentData &document) const
 {
-
-    if ((document_id < 0) || (documents_.count(document_id) <= 0))
+    std::vector<std::vector<uint32_t>> positions;
+    positions.reserve(phrase.term_ids.size());
+    for (const int term_id : phrase.term_ids)
     {
-        throw std::invalid_argument("Non-existent document ID"s);
+        if (term_id < 0)
+        {
+            return false;
+        }
+        positions.push_back(GetTermPositions(document, term_id));
+        if (positions.back().empty())
+        {
+            return false;
+        }
     }
 
-    const auto result = ParseQuery(raw_query);
-    std::vector<std::string_view> matched_words;
-
-    for (auto word : result.minus_words)
+    size_t anchor = 0;
+    for (size_t i = 1; i < positions.size(); ++i)
     {
-        if (word_to_document_freqs_.count(word) == 0)
-        {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id))
+        if (positions[i].size() < positions[anchor].size())
         {
-            return {{}, documents_.at(document_id).status};
+            anchor = i;
         }
     }
 
-    for (auto word : result.plus_words)
+    for (const uint32_t anchor_position : positions[anchor])
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        const int64_t start = static_cast<int64_t>(anchor_position) - phrase.offsets[anchor];
+        bool matched = true;
+        for (size_t i = 0; i < positions.size() && matched; ++i)
         {
-            continue;
+            if (i == anchor)
+            {
+                continue;
+            }
+            const int64_t expected = start + phrase.offsets[i];
+            const int64_t lowest = std::max<int64_t>(expected - phrase.slop, 0);
+            const auto found = std::lower_bound(positions[i].begin(), positions[i].end(), lowest);
+            matched = found != positions[i].end() && *found <= expected + phrase.slop;
         }
-        if (word_to_document_freqs_.at(word).count(document_id))
+        if (matched)
         {
-            matched_words.push_back(word);
+            return true;
         }
     }
-
-    return {matched_words,
-            documents_.at(document_id).status};
+    return false;
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy &,
-                                                                                      std::string_view raw_query,
-                                                                                      int document_id) const
+std::vector<int> SearchServer::FindPhraseDocuments(const std::pmr::vector<QueryPhrase> &phrases) const
 {
+    if (phrases.empty())
+    {
+        return {};
+    }
+    if (!positional_index_enabled_)
+    {
+        throw std::invalid_argument("Phrase queries require the positional index"s);
+    }
 
-    if ((document_id < 0) || (documents_.count(document_id) <= 0))
+    std::vector<int> result;
+    for (size_t phrase_index = 0; phrase_index < phrases.size(); ++phrase_index)
     {
-        throw std::invalid_argument("Non-existent document ID"s);
+        const PhraseTerms phrase = ResolvePhrase(phrases[phrase_index]);
+        if (std::count(phrase.term_ids.begin(), phrase.term_ids.end(), -1) > 0)
+        {
+            return {};
+        }
+
+        std::vector<const std::map<int, double> *> postings;
+        for (const int term_id : phrase.term_ids)
+        {
+            postings.push_back(&word_to_document_freqs_.at(term_id_to_word_[term_id]));
+        }
+        std::sort(postings.begin(), postings.end(),
+                  [](const auto *lhs, const auto *rhs)
+                  {
+                      return lhs->size() < rhs->size();
+                  });
+
+        std::vector<int> candidates;
+        for (const auto &[document_id, _] : *postings.front())
+        {
+            if (phrase_index > 0 && !std::binary_search(result.begin(), result.end(), document_id))
+            {
+                continue;
+            }
+            const bool in_all_postings = std::all_of(postings.begin() + 1, postings.end(),
+                                                     [document_id](const auto *term_postings)
+                                                     {
+                                                         return term_postings->count(document_id) > 0;
+                                                     });
+            if (in_all_postings && MatchesPhrase(phrase, documents_.at(document_id)))
+            {
+                candidates.push_back(document_id);
+            }
+        }
+        result = std::move(candidates);
+        if (result.empty())
+        {
+            break;
+        }
     }
+    return result;
+}
 
-    const auto &result = ParseQuery(raw_query);
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchQueryTerms(const QueryTerms &query_terms,
+                                                                                        int document_id) const
+{
+    const auto &document_data = documents_.at(document_id);
+    const DocumentStatus status = document_data.status;
+    const auto terms_begin = ids_of_docs_to_word_freqs_.begin() + forward_index_offsets_[document_data.forward_index_slot];
+    const auto terms_end = ids_of_docs_to_word_freqs_.begin() + forward_index_offsets_[document_data.forward_index_slot + 1];
 
-    const auto &checker = [this, document_id](std::string_view word)
+    const auto by_term_id = [](const TermFrequency &term, int term_id)
     {
-        const auto temporary = word_to_document_freqs_.find(word);
-        return temporary != word_to_document_freqs_.end() &&
-               temporary->second.count(document_id);
+        return term.term_id < term_id;
     };
 
-    if (std::any_of(std::execution::par,
-                    result.minus_words.begin(),
-                    result.minus_words.end(),
-                    checker))
+    auto position = terms_begin;
+    for (const int term_id : query_terms.minus_terms)
     {
-        return {{}, documents_.at(document_id).status};
+        position = GallopingLowerBound(position, terms_end, term_id, by_term_id);
+        if (position == terms_end)
+        {
+            break;
+        }
+        if (position->term_id == term_id)
+        {
+            return {std::vector<std::string_view>{}, status};
+        }
     }
 
-    std::vector<std::string_view> matched_words(result.plus_words.size());
-
-    auto end = std::copy_if(std::execution::par,
-                            result.plus_words.begin(),
-                            result.plus_words.end(),
-                            matched_words.begin(),
-                            checker);
+    for (const auto &phrase : query_terms.phrases)
+    {
+        if (!MatchesPhrase(phrase, document_data))
+        {
+            return {std::vector<std::string_view>{}, status};
+        }
+    }
 
-    std::sort(matched_words.begin(), end);
-    end = std::unique(std::execution::par, matched_words.begin(), end);
+    std::vector<std::string_view> matched_words;
+    position = terms_begin;
+    for (const int term_id : query_terms.plus_terms)
+    {
+        position = GallopingLowerBound(position, terms_end, term_id, by_term_id);
+        if (position == terms_end)
+        {
+            break;
+        }
+        if (position->term_id == term_id)
+        {
+            matched_words.push_back(term_id_to_word_[term_id]);
+        }
+    }
 
-    matched_words.erase(end, matched_words.end());
-    return {matched_words, documents_.at(document_id).status};
+    std::sort(matched_words.begin(), matched_words.end());
+    return {matched_words, status};
 }
 
 bool SearchServer::IsStopWord(std::string_view word) const
@@ -263,26 +2053,121 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view &text) con
         text = text.substr(1);
     }
 
+    bool is_prefix = false;
+
+    if (text.size() > 1 && text.back() == '*')
+    {
+        is_prefix = true;
+        text.remove_suffix(1);
+    }
+
     if (text.empty() || text[0] == '-' || !IsValidWord(text))
     {
         throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
     }
-    return {text, is_minus, IsStopWord(text)};
+    return {text, is_minus, !is_prefix && IsStopWord(text), is_prefix};
 }
 
-SearchServer::Query SearchServer::ParseQuery(std::string_view &text) const
+size_t SearchServer::ParseQueryPhrase(const std::pmr::vector<std::string_view> &words, size_t first, Query &query) const
 {
-    Query result;
+    QueryPhrase phrase;
+    int offset = 0;
+    bool is_closed = false;
+    size_t last = first;
 
-    for (std::string_view &word : SplitIntoWords(text))
+    for (; last < words.size() && !is_closed; ++last)
+    {
+        std::string_view word = words[last];
+        if (last == first)
+        {
+            word.remove_prefix(1);
+        }
+
+        const auto quote = word.find('"');
+        if (quote != word.npos)
+        {
+            std::string_view slop = word.substr(quote + 1);
+            word = word.substr(0, quote);
+            is_closed = true;
+
+            if (!slop.empty())
+            {
+                const auto [end, error] = std::from_chars(slop.data() + 1, slop.data() + slop.size(), phrase.slop);
+                if (slop[0] != '~' || slop.size() == 1 || error != std::errc() || end != slop.data() + slop.size())
+                {
+                    throw std::invalid_argument("Query phrase proximity "s + std::string(slop) + " is invalid"s);
+                }
+            }
+        }
+
+        if (word.empty())
+        {
+            continue;
+        }
+        if (word[0] == '-' || !IsValidWord(word))
+        {
+            throw std::invalid_argument("Query word "s + std::string(word) + " is invalid"s);
+        }
+        if (!IsStopWord(word))
+        {
+            phrase.words.push_back(word);
+            phrase.offsets.push_back(offset);
+            query.plus_words.push_back(word);
+        }
+        ++offset;
+    }
+
+    if (!is_closed)
+    {
+        throw std::invalid_argument("Query phrase is not closed"s);
+    }
+    if (phrase.words.size() > 1)
+    {
+        query.phrases.push_back(std::move(phrase));
+    }
+    return last - 1;
+}
+
+SearchServer::Query SearchServer::ParseQuery(std::string_view &text, QueryArena &arena) const
+{
+    Query result(arena);
+
+    auto words = SplitIntoWords(text, arena.GetResource());
+    for (size_t i = 0; i < words.size(); ++i)
     {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop)
+        if (words[i][0] == '"')
+        {
+            i = ParseQueryPhrase(words, i, result);
+            continue;
+        }
+        const auto query_word = ParseQueryWord(words[i]);
+        if (query_word.is_prefix)
+        {
+            const auto term_ids = prefix_dictionary_.FindByPrefix(query_word.data, term_id_to_word_,
+                                                                  max_prefix_expansions_);
+            if (query_word.is_minus)
+            {
+                for (const int term_id : term_ids)
+                {
+                    result.minus_words.push_back(term_id_to_word_[term_id]);
+                }
+                result.minus_prefixes.push_back(query_word.data);
+            }
+            else
+            {
+                result.prefixes.push_back({term_ids, query_word.data});
+            }
+        }
+        else if (!query_word.is_stop)
         {
             if (query_word.is_minus)
             {
                 result.minus_words.push_back(query_word.data);
             }
+            else if (fuzzy_search_enabled_ && !HasPostings(query_word.data))
+            {
+                AddQueryCorrections(query_word.data, result);
+            }
             else
             {
                 result.plus_words.push_back(query_word.data);
@@ -300,10 +2185,152 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view &text) const
                                         result.plus_words.end()),
                             result.plus_words.end());
 
+    std::sort(result.corrections.begin(), result.corrections.end(),
+              [](const QueryCorrection &lhs, const QueryCorrection &rhs)
+              {
+                  return lhs.term_id < rhs.term_id || (lhs.term_id == rhs.term_id && lhs.weight > rhs.weight);
+              });
+    result.corrections.erase(std::unique(result.corrections.begin(), result.corrections.end(),
+                                         [](const QueryCorrection &lhs, const QueryCorrection &rhs)
+                                         {
+                                             return lhs.term_id == rhs.term_id;
+                                         }),
+                             result.corrections.end());
+    result.corrections.erase(std::remove_if(result.corrections.begin(), result.corrections.end(),
+                                            [this, &result](const QueryCorrection &correction)
+                                            {
+                                                return std::binary_search(result.plus_words.begin(),
+                                                                          result.plus_words.end(),
+                                                                          term_id_to_word_[correction.term_id]);
+                                            }),
+                             result.corrections.end());
+
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view &word) const
+bool SearchServer::HasPostings(std::string_view word) const
+{
+    const auto postings = word_to_document_freqs_.find(word);
+    return postings != word_to_document_freqs_.end() && !postings->second.empty();
+}
+
+std::vector<SearchServer::QueryCorrection> SearchServer::FindCorrections(std::string_view word) const
+{
+    // The closest words that still have postings; words of removed documents stay in the
+    // fuzzy dictionary and must not shadow farther ones.
+    std::vector<QueryCorrection> corrections;
+    int best_distance = fuzzy_dictionary_.GetMaxDistance() + 1;
+    for (const auto &[term_id, distance] : fuzzy_dictionary_.FindWithinDistance(word, term_id_to_word_))
+    {
+        if (distance > best_distance || !HasPostings(term_id_to_word_[term_id]))
+        {
+            continue;
+        }
+        if (distance < best_distance)
+        {
+            best_distance = distance;
+            corrections.clear();
+        }
+        corrections.push_back({term_id, std::pow(fuzzy_penalty_per_edit_, distance)});
+    }
+    return corrections;
+}
+
+void SearchServer::AddQueryCorrections(std::string_view word, Query &query) const
+{
+    auto &group = query.correction_groups.emplace_back();
+    for (const auto &correction : FindCorrections(word))
+    {
+        query.corrections.push_back(correction);
+        group.term_ids.push_back(correction.term_id);
+    }
+}
+
+double SearchServer::GetAverageWordCount() const
+{
+    return documents_.empty() ? 0.0 : static_cast<double>(total_word_count_) / documents_.size();
+}
+
+int64_t SearchServer::QuantizeRelevance(double relevance) const
+{
+    return std::llround(relevance / EPSILON);
+}
+
+bool SearchServer::RanksBefore(const Document &lhs, const Document &rhs) const
+{
+    const int64_t lhs_relevance = QuantizeRelevance(lhs.relevance);
+    const int64_t rhs_relevance = QuantizeRelevance(rhs.relevance);
+    if (lhs_relevance != rhs_relevance)
+    {
+        return lhs_relevance > rhs_relevance;
+    }
+    if (lhs.rating != rhs.rating)
+    {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+bool SearchServer::RanksAfterCursor(const SearchCursor &after, int document_id, double relevance, int rating) const
+{
+    if (!after.has_position_)
+    {
+        return true;
+    }
+    return RanksBefore({after.id_, after.relevance_, after.rating_}, {document_id, relevance, rating});
+}
+
+double SearchServer::GetRelevanceCeiling(const SearchCursor &after) const
+{
+    // Anything more than EPSILON above the cursor is quantized into a higher step
+    return after.has_position_ ? after.relevance_ + EPSILON : std::numeric_limits<double>::infinity();
+}
+
+SearchServer::MergedPostings SearchServer::MergePrefixPostings(const QueryPrefix &prefix, QueryArena &arena) const
 {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+    using PostingRange = std::pair<std::map<int, double>::const_iterator, std::map<int, double>::const_iterator>;
+
+    std::pmr::vector<PostingRange> ranges(arena.GetResource());
+    ranges.reserve(prefix.term_ids.size());
+    size_t posting_count = 0;
+    for (const int term_id : prefix.term_ids)
+    {
+        const auto term_postings = word_to_document_freqs_.find(term_id_to_word_[term_id]);
+        if (term_postings != word_to_document_freqs_.end() && !term_postings->second.empty())
+        {
+            ranges.push_back({term_postings->second.begin(), term_postings->second.end()});
+            posting_count += term_postings->second.size();
+        }
+    }
+
+    // A min-heap of the words by their next document id yields the postings in id order
+    const auto is_after = [](const PostingRange &lhs, const PostingRange &rhs)
+    {
+        return lhs.first->first > rhs.first->first;
+    };
+    std::make_heap(ranges.begin(), ranges.end(), is_after);
+    MergedPostings postings(arena.GetResource());
+    postings.reserve(posting_count);
+    while (!ranges.empty())
+    {
+        std::pop_heap(ranges.begin(), ranges.end(), is_after);
+        auto &[posting, last] = ranges.back();
+        if (!postings.empty() && postings.back().first == posting->first)
+        {
+            postings.back().second += posting->second;
+        }
+        else
+        {
+            postings.push_back(*posting);
+        }
+        if (++posting == last)
+        {
+            ranges.pop_back();
+        }
+        else
+        {
+            std::push_heap(ranges.begin(), ranges.end(), is_after);
+        }
+    }
+    return postings;
 }
\ No newline at end of file
@@ -1,9 +1,11 @@
 #pragma once
 #include <tuple>
+#include <array>
 #include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <set>
 #include <stdexcept>
 #include <execution>
@@ -12,13 +14,42 @@
 #include <type_traits>
 #include <random>
 #include <future>
-#include "concurrent_map.h"
+#include <optional>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <variant>
 #include "read_input_functions.h"
 #include "string_processing.h"
 #include "log_duration.h"
+#include "search_cursor.h"
+#include "galloping_search.h"
+#include "word_frequencies_view.h"
+#include "varint_coding.h"
+#include "prefix_dictionary.h"
+#include "fuzzy_dictionary.h"
+#include "ranking.h"
+#include "impact_index.h"
+#include "text_arena.h"
+#include "query_arena.h"
+#include "query_options.h"
+#include "query_budget.h"
+#include "query_executor.h"
+#include "duplicate_index.h"
+#include "boolean_query.h"
+#include "query_plan.h"
+#include "document_filter.h"
+#include "document_attributes.h"
+#include "memory_usage.h"
+#include "facet.h"
+#include "scoring_kernel.h"
 
 using namespace std::string_literals;
 
+#ifdef __cpp_impl_coroutine
+class SearchAwaitable;
+#endif
+
 class SearchServer
 {
 public:
@@ -27,66 +58,266 @@ public:
     SearchServer(const std::string &stop_words_text) : SearchServer(SplitIntoWords(stop_words_text)) {}
     SearchServer(std::string_view &stop_words_text) : SearchServer(SplitIntoWords(stop_words_text)) {}
     SearchServer() = default;
+    // A copy stores its own terms and document texts and shares the query executor.
+    SearchServer(const SearchServer &other);
+    SearchServer(SearchServer &&) = default;
 
     void AddDocument(int document_id,
                      std::string_view document,
                      DocumentStatus status,
                      const std::vector<int> &ratings);
 
-    template <typename DocumentPredicate>
+    void AddDocuments(const std::vector<NewDocument> &batch);
+    void AddDocuments(const std::execution::sequenced_policy &, const std::vector<NewDocument> &batch);
+    void AddDocuments(const std::execution::parallel_policy &, const std::vector<NewDocument> &batch);
+
+    // Words of a document with their positions in its text, stop words dropped.
+    struct TokenizedDocument
+    {
+        std::vector<std::string_view> words;
+        std::vector<uint32_t> positions;
+    };
+
+    // Tokenizing reads nothing but the stop words, so a pipeline can split the next batch while
+    // the current one is added. The words are views into the texts of the batch.
+    std::vector<TokenizedDocument> TokenizeDocuments(const std::execution::parallel_policy &,
+                                                     const std::vector<NewDocument> &batch) const;
+    void AddDocuments(const std::execution::parallel_policy &, const std::vector<NewDocument> &batch,
+                      const std::vector<TokenizedDocument> &tokenized);
+
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
 
-    template <typename ExecutionPolicy, typename DocumentPredicate>
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
 
-    template <typename ExecutionPolicy>
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query, DocumentStatus status) const;
 
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
 
-    template <typename ExecutionPolicy>
+    template <typename Ranking>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query) const;
 
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+    template <typename Ranking>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy, typename DocumentPredicate>
+    SearchPage FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                const SearchCursor &after) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
+    SearchPage FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query, DocumentStatus status,
+                                const SearchCursor &after) const;
+
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
+    SearchPage FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                const SearchCursor &after) const;
+
+    SearchPage FindTopDocuments(std::string_view raw_query, DocumentStatus status, const SearchCursor &after) const;
+
+    template <typename Ranking>
+    SearchPage FindTopDocuments(std::string_view raw_query, DocumentStatus status, const SearchCursor &after) const;
+
+    SearchPage FindTopDocuments(std::string_view raw_query, const SearchCursor &after) const;
+
+    template <typename Ranking>
+    SearchPage FindTopDocuments(std::string_view raw_query, const SearchCursor &after) const;
+
+    // Picks the cheapest strategy for the query from posting list lengths; the parallel dense
+    // accumulator is considered only under the parallel policy. Explain reports the plan
+    // without running the query, with the operator tree of ALL and BOOLEAN queries.
+    SearchResult FindTopDocuments(std::string_view raw_query, const QueryOptions &options) const;
+
+    template <typename Ranking>
+    SearchResult FindTopDocuments(std::string_view raw_query, const QueryOptions &options) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
+    SearchResult FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query, const QueryOptions &options) const;
+
+    template <typename Ranking = TfIdfRanking>
+    QueryPlan Explain(std::string_view raw_query, const QueryOptions &options = {}) const;
+
+    template <typename Ranking = TfIdfRanking, typename ExecutionPolicy>
+    QueryPlan Explain(ExecutionPolicy &&policy, std::string_view raw_query, const QueryOptions &options = {}) const;
+
+    // Count documents matching the plus and minus words without ranking them. The parallel
+    // versions split the documents into position ranges, each marked in its own bitmap.
+    size_t CountDocuments(std::string_view raw_query, const DocumentFilter &filter = {}) const;
+    size_t CountDocuments(const std::execution::sequenced_policy &, std::string_view raw_query,
+                          const DocumentFilter &filter = {}) const;
+    size_t CountDocuments(const std::execution::parallel_policy &, std::string_view raw_query,
+                          const DocumentFilter &filter = {}) const;
+
+    FacetResult Facet(std::string_view raw_query, const FacetDimensions &dimensions,
+                      const DocumentFilter &filter = {}) const;
+    FacetResult Facet(const std::execution::sequenced_policy &, std::string_view raw_query,
+                      const FacetDimensions &dimensions, const DocumentFilter &filter = {}) const;
+    FacetResult Facet(const std::execution::parallel_policy &, std::string_view raw_query,
+                      const FacetDimensions &dimensions, const DocumentFilter &filter = {}) const;
+
+    // Runs on the executor started by EnableAsyncQueries and resumes the caller there;
+    // without it the query runs inline. Copies of the server share the executor.
+    // Requires C++20 coroutines.
+    void EnableAsyncQueries(size_t thread_count);
+#ifdef __cpp_impl_coroutine
+    SearchAwaitable FindTopDocumentsAsync(std::string_view raw_query, QueryOptions options = {}) const;
+#endif
+
     int GetDocumentCount() const;
 
+    void EnablePositionalIndex();
+    size_t GetPositionalIndexMemoryUsage() const;
+
+    void SetMaxPrefixExpansions(size_t max_expansions);
+
+    void EnableFuzzySearch(int max_distance, double penalty_per_edit);
+    size_t GetFuzzyIndexMemoryUsage() const;
+
+    // Returns every document of a duplicate group except the one with the smallest id.
+    // Without a threshold term sets must be identical; a threshold below 1 compares Jaccard
+    // similarity of term sets and needs the LSH index built by EnableDuplicateDetection.
+    void EnableDuplicateDetection(int band_count, int rows_per_band);
+    std::vector<int> FindDuplicates() const;
+    std::vector<int> FindDuplicates(double min_similarity) const;
+    size_t GetDuplicateIndexMemoryUsage() const;
+
+    void BuildImpactIndex(ImpactPrecision precision);
+    bool IsImpactIndexBuilt() const;
+    size_t GetImpactIndexMemoryUsage() const;
+    size_t GetImpactIndexPostingCount() const;
+
+    MemoryUsage GetMemoryUsage() const;
+    TermMemoryUsage GetTermMemoryUsage(std::string_view word) const;
+    std::vector<TermMemoryUsage> GetHeaviestTerms(size_t count) const;
+
+    // GetMemoryUsage estimates the heap use from container sizes and capacities with a fixed
+    // overhead per tree node, so it tracks growth rather than what the allocator holds.
+    // Adding documents throws std::runtime_error instead of growing the index past the budget.
+    // Growth is estimated per document and checked against a recount when the estimate runs
+    // out; removals give back their postings. Arrays and arenas allocate ahead, so the usage
+    // can pass the budget by their spare capacity. FitsMemoryBudget lets callers hold a
+    // document back instead.
+    void SetMemoryBudget(size_t max_bytes);
+    bool FitsMemoryBudget(std::string_view document) const;
+
     std::vector<int>::const_iterator begin() const;
     std::vector<int>::const_iterator end() const;
 
-    const std::map<std::string_view, double> &GetWordFrequencies(int document_id) const;
+    WordFrequenciesView GetWordFrequencies(int document_id) const;
+    std::map<std::string_view, double> GetWordFrequenciesMap(int document_id) const;
 
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy &, int document_id);
     void RemoveDocument(const std::execution::parallel_policy &, int document_id);
 
+    // Removal only releases document texts and forward index entries. The space is reclaimed by
+    // CompactDocumentStorage, which copies every live document and is meant to run between
+    // batches of updates once IsDocumentStorageFragmented reports more released than live bytes.
+    bool IsDocumentStorageFragmented() const;
+    void CompactDocumentStorage();
+
+    void OpenIndex(const std::string &index_path);
+
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query,
                                                                             int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy &,
                                                                             std::string_view raw_query,
                                                                             int document_id) const;
-    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy &,
-                                                                            std::string_view raw_query,
-                                                                            int document_id) const;
+
+    // Parses the query once for the whole batch. A single document is matched by a few
+    // galloping steps over its forward index, so only the batch has a parallel version,
+    // which matches the documents on separate threads.
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(std::string_view raw_query,
+                                                                                          const std::vector<int> &document_ids) const;
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(const std::execution::sequenced_policy &,
+                                                                                          std::string_view raw_query,
+                                                                                          const std::vector<int> &document_ids) const;
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(const std::execution::parallel_policy &,
+                                                                                          std::string_view raw_query,
+                                                                                          const std::vector<int> &document_ids) const;
 
 private:
+    friend class SegmentedSearchServer;
+    friend class OfflineIndexer;
+    friend class FrozenSearchServer;
+
     struct DocumentData
     {
-        std::string data_string_;
+        std::string_view text;
         int rating;
         DocumentStatus status;
+        size_t forward_index_slot;
+        uint32_t word_count;
     };
 
     const double EPSILON = 1e-6;
     const int MAX_RESULT_DOCUMENT_COUNT = 5;
+    static const size_t DOCUMENT_TEXT_CHUNK_SIZE = 1 << 20;
+    static const size_t TERM_CHUNK_SIZE = 1 << 16;
 
     const std::set<std::string, std::less<>> stop_words_;
 
+    TextArena document_texts_{DOCUMENT_TEXT_CHUNK_SIZE};
+    TextArena term_pool_{TERM_CHUNK_SIZE};
+
+    std::map<std::string_view, int> word_to_term_id_;
+    std::vector<std::string_view> term_id_to_word_;
+    PrefixDictionary prefix_dictionary_;
+    size_t max_prefix_expansions_ = 64;
+
+    bool fuzzy_search_enabled_ = false;
+    FuzzyDictionary fuzzy_dictionary_;
+    double fuzzy_penalty_per_edit_ = 1.0;
+
+    std::optional<ImpactIndex> impact_index_;
+    std::vector<double> term_max_freqs_;
+    std::optional<DuplicateIndex> duplicate_index_;
+
     std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> ids_of_docs_to_word_freqs_;
+    std::vector<TermFrequency> ids_of_docs_to_word_freqs_;
+    std::vector<size_t> forward_index_offsets_ = {0};
+
+    bool positional_index_enabled_ = false;
+    std::vector<uint8_t> term_positions_;
+    std::vector<size_t> term_positions_offsets_ = {0};
 
     std::map<int, DocumentData> documents_;
+    DocumentAttributeIndex document_attributes_;
     std::vector<int> document_ids_;
+    uint64_t total_word_count_ = 0;
+
+    std::shared_ptr<QueryExecutor> query_executor_;
+
+    static const size_t MEMORY_RECOUNT_INTERVAL = 4096;
+    // Estimated bookkeeping of one std::map node: the parent and child links and the colour,
+    // padded to a pointer. Allocator headers and fragmentation are not counted.
+    static const size_t TREE_NODE_OVERHEAD = 4 * sizeof(void *);
+    size_t memory_budget_ = std::numeric_limits<size_t>::max();
+    size_t budgeted_memory_usage_ = 0;
+    size_t documents_since_memory_recount_ = 0;
+
+    bool HasMemoryBudget() const;
+    TermMemoryUsage GetTermMemoryUsage(std::string_view word, const std::map<int, double> &postings) const;
+    size_t EstimateDocumentMemoryUsage(std::string_view document, const std::vector<std::string_view> &words) const;
+    void ReserveMemoryBudget(size_t bytes, size_t document_count);
+    void ReleaseMemoryBudget(int document_id);
+
+    void AddDuplicateFingerprint(int document_id);
+    bool HaveSameTermSet(int lhs_document_id, int rhs_document_id) const;
+    double ComputeTermSetSimilarity(int lhs_document_id, int rhs_document_id) const;
+
+    void ValidateNewDocumentIds(const std::vector<NewDocument> &batch) const;
+    void AddTokenizedDocument(int document_id,
+                              std::string_view document,
+                              DocumentStatus status,
+                              const std::vector<int> &ratings,
+                              const std::vector<std::string_view> &words);
 
     bool IsStopWord(std::string_view word) const;
     static bool IsValidWord(std::string_view word);
@@ -100,31 +331,242 @@ private:
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix;
     };
 
     QueryWord ParseQueryWord(std::string_view &text) const;
 
+    struct QueryPhrase
+    {
+        std::vector<std::string_view> words;
+        std::vector<int> offsets;
+        int slop = 0;
+    };
+
+    struct QueryPrefix
+    {
+        std::vector<int> term_ids;
+        std::string_view text;
+    };
+
+    struct QueryCorrection
+    {
+        int term_id;
+        double weight;
+    };
+
+    // Corrections of one misspelled word; an empty group means the word has none.
+    struct QueryCorrectionGroup
+    {
+        std::vector<int> term_ids;
+    };
+
     struct Query
     {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        explicit Query(QueryArena &arena) : arena(&arena),
+                                            plus_words(arena.GetResource()),
+                                            minus_words(arena.GetResource()),
+                                            phrases(arena.GetResource()),
+                                            prefixes(arena.GetResource()),
+                                            minus_prefixes(arena.GetResource()),
+                                            corrections(arena.GetResource()),
+                                            correction_groups(arena.GetResource()) {}
+
+        QueryArena *arena;
+        QueryBudget *budget = nullptr;
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
+        std::pmr::vector<QueryPhrase> phrases;
+        std::pmr::vector<QueryPrefix> prefixes;
+        // Minus prefixes are expanded into minus_words; the text is kept for SegmentedSearchServer,
+        // which expands prefixes over all of its segments.
+        std::pmr::vector<std::string_view> minus_prefixes;
+        std::pmr::vector<QueryCorrection> corrections;
+        std::pmr::vector<QueryCorrectionGroup> correction_groups;
+    };
+
+    // Figures of a collection spread over several indexes, so that each of them scores its
+    // documents like a single index would; SegmentedSearchServer sums them over its segments.
+    struct CollectionStatistics
+    {
+        int document_count = 0;
+        double average_word_count = 0.0;
+        std::map<std::string_view, size_t> word_document_freqs;
+        std::vector<size_t> prefix_document_freqs;
     };
 
-    Query ParseQuery(std::string_view &text) const;
+    // Term-at-a-time scoring of plus words, prefixes and corrections less the minus words, with
+    // document frequencies of this server unless statistics are given.
+    template <typename Ranking, typename DocumentPredicate>
+    void ScoreTermsAtATime(const Query &query, DocumentPredicate document_predicate,
+                           const CollectionStatistics *statistics,
+                           std::pmr::map<int, double> &document_to_relevance) const;
 
-    double ComputeWordInverseDocumentFreq(std::string_view &word) const;
+    bool HasPostings(std::string_view word) const;
+    std::vector<QueryCorrection> FindCorrections(std::string_view word) const;
+    void AddQueryCorrections(std::string_view word, Query &query) const;
+
+    size_t ParseQueryPhrase(const std::pmr::vector<std::string_view> &words, size_t first, Query &query) const;
+    Query ParseQuery(std::string_view &text, QueryArena &arena) const;
+
+    struct PhraseTerms
+    {
+        std::vector<int> term_ids;
+        std::vector<int> offsets;
+        int slop = 0;
+    };
+
+    struct QueryTerms
+    {
+        std::vector<int> plus_terms;
+        std::vector<int> minus_terms;
+        std::vector<PhraseTerms> phrases;
+    };
+
+    int GetOrAddTermId(std::string_view word);
+    void ReadIndex(std::istream &input);
+    std::vector<int> FindTermIds(const std::pmr::vector<std::string_view> &words) const;
+    PhraseTerms ResolvePhrase(const QueryPhrase &phrase) const;
+    QueryTerms ResolveQueryTerms(const Query &query) const;
+
+    std::vector<uint32_t> GetTermPositions(const DocumentData &document, int term_id) const;
+    bool MatchesPhrase(const PhraseTerms &phrase, const DocumentData &document) const;
+    std::vector<int> FindPhraseDocuments(const std::pmr::vector<QueryPhrase> &phrases) const;
+
+    void ValidateMatchedDocumentIds(const std::vector<int> &document_ids) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchQueryTerms(const QueryTerms &query_terms,
+                                                                              int document_id) const;
+
+    template <typename Ranking>
+    double ComputeInverseDocumentFreq(size_t document_freq) const;
+    double GetAverageWordCount() const;
+    // The postings of a prefix's words merged into one stream ascending by id, with the term
+    // frequencies of a document's words summed.
+    using MergedPostings = std::pmr::vector<std::pair<int, double>>;
+    using TermPostings = std::variant<const std::map<int, double> *, const MergedPostings *>;
+    MergedPostings MergePrefixPostings(const QueryPrefix &prefix, QueryArena &arena) const;
+
+    FacetResult CountMatchedDocuments(std::string_view raw_query, const FacetDimensions &dimensions,
+                                      const DocumentFilter &filter, size_t chunk_count) const;
+
+    // Relevances are compared in steps of EPSILON so that near-equal scores fall back to rating
+    // and id while the order stays a strict weak ordering for sorts, heaps and cursors
+    int64_t QuantizeRelevance(double relevance) const;
+    bool RanksBefore(const Document &lhs, const Document &rhs) const;
+    bool RanksAfterCursor(const SearchCursor &after, int document_id, double relevance, int rating) const;
+    double GetRelevanceCeiling(const SearchCursor &after) const;
+
+    template <typename Ranking, typename ExecutionPolicy, typename DocumentPredicate>
+    SearchPage FindTopDocumentsPage(ExecutionPolicy &&policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                    const SearchCursor &after, QueryBudget &budget, const QueryOptions *options) const;
+
+    // Planner costs, relative to adding one posting to a tree accumulator. They were fitted to
+    // the timings of main.cpp and only need to order the strategies correctly.
+    // One step down a std::map, scaled by the log2 of its size
+    static constexpr double MAP_STEP_COST = 0.5;
+    // Testing one bit of the minus-word bitmap
+    static constexpr double BITMAP_CHECK_COST = 0.1;
+    // Clearing or scanning one slot of a dense array indexed by document id or position
+    static constexpr double DENSE_SLOT_COST = 0.05;
+    // One posting on the parallel dense path, with the attribute reads and the range's heap
+    static constexpr double DENSE_POSTING_COST = 3.0;
+    // Starting one range task and merging its results
+    static constexpr double PARALLEL_TASK_COST = 2000.0;
+    // One posting under MaxScore, with its bound checks, besides the document lookup
+    static constexpr double DOCUMENT_AT_A_TIME_POSTING_COST = 2.0;
+    // Dense per-id arrays are used while ids span at most this many times the document count
+    static const size_t DENSE_ID_RANGE_FACTOR = 4;
+
+    template <typename Ranking>
+    QueryPlan PlanQuery(const Query &query, const QueryBudget &budget, bool can_run_parallel) const;
+    QueryPlan PlanQuery(const Query &query, bool can_change_strategy, bool can_prune, bool can_run_parallel) const;
+    std::vector<bool> MarkMinusDocuments(const Query &query) const;
+
+    std::pmr::vector<std::string_view> OrderPlusWords(const Query &query) const;
+
+    struct BooleanPlanNode
+    {
+        BooleanOperator op;
+        const std::map<int, double> *postings;
+        std::vector<int> children;
+        std::string_view word = {};
+    };
+
+    struct BooleanPlan
+    {
+        std::vector<BooleanPlanNode> nodes;
+        int root = -1;
+        std::vector<std::pair<int, double>> scored_terms;
+    };
+
+    BooleanPlan MakeConjunctivePlan(const Query &query) const;
+    BooleanPlan MakeBooleanPlan(std::string_view raw_query) const;
+    int AddBooleanPlanNode(const BooleanQuery &boolean_query, int node, bool is_negated, BooleanPlan &plan) const;
+    int AddBooleanPlanTerm(std::string_view word, double weight, bool is_scored, BooleanPlan &plan) const;
+    int AddBooleanPlanAlternatives(const std::vector<QueryCorrection> &terms, bool is_scored, BooleanPlan &plan) const;
+    int AddBooleanPlanOperator(BooleanOperator op, std::vector<int> children, BooleanPlan &plan) const;
+    std::string FormatBooleanPlan(const BooleanPlan &plan, int node) const;
+
+    std::vector<int> MatchBooleanNode(const BooleanPlan &plan, int node, QueryBudget::Meter &meter) const;
+    std::vector<int> IntersectBooleanNodes(const BooleanPlan &plan, const std::vector<int> &nodes,
+                                           QueryBudget::Meter &meter) const;
+
+    template <typename Ranking, typename DocumentPredicate>
+    std::pmr::vector<Document> FindBooleanDocuments(const Query &query,
+                                                    const BooleanPlan &plan,
+                                                    DocumentPredicate document_predicate,
+                                                    const SearchCursor &after) const;
+
+    template <typename DocumentToRelevance>
+    std::pmr::vector<Document> CollectMatchedDocuments(const Query &query,
+                                                  const DocumentToRelevance &document_to_relevance,
+                                                  double relevance_scale,
+                                                  const SearchCursor &after) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query &query,
-                                           DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy &,
+    std::pmr::vector<Document> FindAllDocumentsByImpact(const Query &query,
+                                                   DocumentPredicate document_predicate,
+                                                   const SearchCursor &after) const;
+
+    static const size_t RATING_INDEX_SELECTIVITY = 16;
+    static const size_t SCORE_BLOCK_SIZE = 256;
+    static const size_t MIN_DOCUMENTS_PER_RANGE = 4096;
+    static const size_t MAX_DUPLICATE_FAN_OUT = 64;
+
+    template <typename Ranking>
+    std::pmr::vector<Document> FindAllDocumentsFiltered(const Query &query,
+                                                        const DocumentFilter &filter,
+                                                        const SearchCursor &after) const;
+
+    template <typename Ranking, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocumentsDense(const Query &query,
+                                                     DocumentPredicate document_predicate,
+                                                     const SearchCursor &after) const;
+
+    template <typename Ranking, typename DocumentPredicate>
+    std::pmr::vector<Document> FindTopDocumentsByMaxScore(const Query &query,
+                                                          DocumentPredicate document_predicate,
+                                                          const SearchCursor &after) const;
+
+    template <typename Ranking, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(const QueryPlan &plan,
+                                                const Query &query,
+                                                DocumentPredicate document_predicate,
+                                                const SearchCursor &after) const;
+    template <typename Ranking, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(const Query &query,
+                                           DocumentPredicate document_predicate,
+                                           const SearchCursor &after) const;
+    template <typename Ranking, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(const std::execution::sequenced_policy &,
                                            const Query &query,
-                                           DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy &,
+                                           DocumentPredicate document_predicate,
+                                           const SearchCursor &after) const;
+    template <typename Ranking, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(const std::execution::parallel_policy &,
                                            const Query &query,
-                                           DocumentPredicate document_predicate) const;
+                                           DocumentPredicate document_predicate,
+                                           const SearchCursor &after) const;
 };
 
 template <typename StringContainer>
@@ -136,85 +578,807 @@ SearchServer::SearchServer(const StringContainer &stop_words) : stop_words_(Make
     }
 }
 
-template <typename DocumentPredicate>
+template <typename Ranking, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const
 {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, document_predicate);
 }
 
-template <typename ExecutionPolicy, typename DocumentPredicate>
+template <typename Ranking, typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query, DocumentPredicate document_predicate) const
 {
-    const auto query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    return FindTopDocuments<Ranking>(policy, raw_query, document_predicate, SearchCursor{}).documents;
+}
 
-    sort(policy, matched_documents.begin(), matched_documents.end(),
-         [this](const Document &lhs, const Document &rhs)
-         {
-             if (std::abs(lhs.relevance - rhs.relevance) < EPSILON)
-             {
-                 return lhs.rating > rhs.rating;
-             }
-             else
-             {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
+template <typename Ranking, typename ExecutionPolicy, typename DocumentPredicate>
+SearchPage SearchServer::FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                          const SearchCursor &after) const
+{
+    QueryBudget budget(nullptr);
+    return FindTopDocumentsPage<Ranking>(policy, raw_query, document_predicate, after, budget, nullptr);
+}
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+template <typename Ranking>
+SearchResult SearchServer::FindTopDocuments(std::string_view raw_query, const QueryOptions &options) const
+{
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, options);
+}
+
+template <typename Ranking, typename ExecutionPolicy>
+SearchResult SearchServer::FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query,
+                                            const QueryOptions &options) const
+{
+    QueryBudget budget(&options);
+    auto page = FindTopDocumentsPage<Ranking>(policy, raw_query,
+                                              [&options](int, DocumentStatus document_status, int)
+                                              {
+                                                  return document_status == options.status;
+                                              },
+                                              SearchCursor{}, budget, &options);
+    return {std::move(page.documents), budget.IsExhausted()};
+}
+
+template <typename Ranking, typename ExecutionPolicy, typename DocumentPredicate>
+SearchPage SearchServer::FindTopDocumentsPage(ExecutionPolicy &&policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                              const SearchCursor &after, QueryBudget &budget, const QueryOptions *options) const
+{
+    const QueryMode mode = options ? options->mode : QueryMode::ANY;
+    budget.ThrowIfCancelled();
+    if (after.IsEnd())
+    {
+        return {{}, SearchCursor::End()};
+    }
+    const size_t query_hash = std::hash<std::string_view>{}(raw_query);
+    if (after.has_position_ && after.query_hash_ != query_hash)
     {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        throw std::invalid_argument("Search cursor belongs to another query"s);
     }
 
-    return matched_documents;
+    QueryArena arena;
+    auto query = mode == QueryMode::BOOLEAN ? Query(arena) : ParseQuery(raw_query, arena);
+    query.budget = &budget;
+    std::pmr::vector<Document> matched_documents(arena.GetResource());
+    if (mode == QueryMode::ANY && options)
+    {
+        constexpr bool is_parallel = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>;
+        matched_documents = FindAllDocuments<Ranking>(PlanQuery<Ranking>(query, budget, is_parallel), query,
+                                                      document_predicate, after);
+    }
+    else if (mode == QueryMode::ANY)
+    {
+        matched_documents = FindAllDocuments<Ranking>(policy, query, document_predicate, after);
+    }
+    else
+    {
+        const auto plan = mode == QueryMode::ALL ? MakeConjunctivePlan(query) : MakeBooleanPlan(raw_query);
+        matched_documents = FindBooleanDocuments<Ranking>(query, plan, document_predicate, after);
+    }
+    budget.ThrowIfCancelled();
+
+    const size_t page_size = std::min(matched_documents.size(),
+                                      static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+    std::partial_sort(policy, matched_documents.begin(), matched_documents.begin() + page_size, matched_documents.end(),
+                      [this](const Document &lhs, const Document &rhs)
+                      {
+                          return RanksBefore(lhs, rhs);
+                      });
+    std::vector<Document> page(matched_documents.begin(), matched_documents.begin() + page_size);
+
+    if (page_size < static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT))
+    {
+        return {std::move(page), SearchCursor::End()};
+    }
+    SearchCursor next(page.back(), query_hash);
+    return {std::move(page), next};
+}
+
+template <typename Ranking>
+QueryPlan SearchServer::Explain(std::string_view raw_query, const QueryOptions &options) const
+{
+    return Explain<Ranking>(std::execution::seq, raw_query, options);
+}
+
+template <typename Ranking, typename ExecutionPolicy>
+QueryPlan SearchServer::Explain(ExecutionPolicy &&, std::string_view raw_query, const QueryOptions &options) const
+{
+    QueryArena arena;
+    QueryBudget budget(&options);
+    if (options.mode == QueryMode::ANY)
+    {
+        constexpr bool is_parallel = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>;
+        return PlanQuery<Ranking>(ParseQuery(raw_query, arena), budget, is_parallel);
+    }
+
+    const auto boolean_plan = options.mode == QueryMode::ALL ? MakeConjunctivePlan(ParseQuery(raw_query, arena))
+                                                             : MakeBooleanPlan(raw_query);
+    QueryPlan plan;
+    plan.strategy = QueryStrategy::INTERSECTION;
+    plan.result_count = MAX_RESULT_DOCUMENT_COUNT;
+    for (const auto &node : boolean_plan.nodes)
+    {
+        plan.plus_posting_count += node.postings ? node.postings->size() : 0;
+    }
+    plan.estimated_cost = plan.plus_posting_count;
+    if (boolean_plan.root >= 0)
+    {
+        plan.operator_tree = FormatBooleanPlan(boolean_plan, boolean_plan.root);
+    }
+    return plan;
+}
+
+template <typename Ranking>
+QueryPlan SearchServer::PlanQuery(const Query &query, const QueryBudget &budget, bool can_run_parallel) const
+{
+    bool is_impact_scored = false;
+    if constexpr (std::is_same_v<Ranking, QuantizedTfIdfRanking>)
+    {
+        is_impact_scored = impact_index_.has_value();
+    }
+    return PlanQuery(query, !budget.IsLimited() && !is_impact_scored, HasTermScoreBound<Ranking>::value, can_run_parallel);
+}
+
+template <typename Ranking, typename ExecutionPolicy>
+SearchPage SearchServer::FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query, DocumentStatus status,
+                                          const SearchCursor &after) const
+{
+    return FindTopDocuments<Ranking>(policy, raw_query,
+                            [status](int, DocumentStatus document_status, int)
+                            {
+                                return document_status == status;
+                            },
+                            after);
 }
 
-template <typename ExecutionPolicy>
+template <typename Ranking, typename DocumentPredicate>
+SearchPage SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                          const SearchCursor &after) const
+{
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, document_predicate, after);
+}
+
+template <typename Ranking>
+SearchPage SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                          const SearchCursor &after) const
+{
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, status, after);
+}
+
+template <typename Ranking>
+SearchPage SearchServer::FindTopDocuments(std::string_view raw_query, const SearchCursor &after) const
+{
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, DocumentStatus::ACTUAL, after);
+}
+
+template <typename Ranking, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query,
                                                      DocumentStatus status) const
 {
-    return FindTopDocuments(policy, raw_query,
-                            [&status](int document_id,
-                                      DocumentStatus document_status, int rating)
+    return FindTopDocuments<Ranking>(policy, raw_query,
+                            [&status](int, DocumentStatus document_status, int)
                             {
                                 return document_status == status;
                             });
 }
 
-template <typename ExecutionPolicy>
+template <typename Ranking, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &&policy, std::string_view raw_query) const
 {
-    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    return FindTopDocuments<Ranking>(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query &query,
-                                                     DocumentPredicate document_predicate) const
+template <typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const
 {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, status);
 }
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy &,
+
+template <typename Ranking>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const
+{
+    return FindTopDocuments<Ranking>(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Ranking>
+double SearchServer::ComputeInverseDocumentFreq(size_t document_freq) const
+{
+    return Ranking::ComputeInverseDocumentFreq(GetDocumentCount(), document_freq);
+}
+
+template <typename Ranking, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const QueryPlan &plan,
+                                                          const Query &query,
+                                                          DocumentPredicate document_predicate,
+                                                          const SearchCursor &after) const
+{
+    if (plan.strategy == QueryStrategy::PARALLEL_DENSE)
+    {
+        return FindAllDocumentsDense<Ranking>(query, document_predicate, after);
+    }
+    if constexpr (HasTermScoreBound<Ranking>::value)
+    {
+        if (plan.strategy == QueryStrategy::DOCUMENT_AT_A_TIME)
+        {
+            return FindTopDocumentsByMaxScore<Ranking>(query, document_predicate, after);
+        }
+    }
+    if (!plan.filters_minus_words_first)
+    {
+        return FindAllDocuments<Ranking>(std::execution::seq, query, document_predicate, after);
+    }
+
+    const std::vector<bool> excluded_documents = MarkMinusDocuments(query);
+    const int first_document_id = documents_.begin()->first;
+    Query filtered_query = query;
+    filtered_query.minus_words.clear();
+    return FindAllDocuments<Ranking>(std::execution::seq, filtered_query,
+                                     [&](int document_id, DocumentStatus status, int rating)
+                                     {
+                                         return !excluded_documents[document_id - first_document_id] &&
+                                                document_predicate(document_id, status, rating);
+                                     },
+                                     after);
+}
+
+template <typename Ranking>
+std::pmr::vector<Document> SearchServer::FindAllDocumentsFiltered(const Query &query,
+                                                                  const DocumentFilter &filter,
+                                                                  const SearchCursor &after) const
+{
+    std::pmr::vector<MergedPostings> prefix_postings(query.arena->GetResource());
+    prefix_postings.reserve(query.prefixes.size());
+    std::vector<std::pair<TermPostings, double>> terms;
+    for (const std::string_view word : OrderPlusWords(query))
+    {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings != word_to_document_freqs_.end() && !postings->second.empty())
+        {
+            terms.push_back({&postings->second, 1.0});
+        }
+    }
+    for (const auto &prefix : query.prefixes)
+    {
+        prefix_postings.push_back(MergePrefixPostings(prefix, *query.arena));
+        if (!prefix_postings.back().empty())
+        {
+            terms.push_back({&prefix_postings.back(), 1.0});
+        }
+    }
+    for (const auto &correction : query.corrections)
+    {
+        terms.push_back({&word_to_document_freqs_.at(term_id_to_word_[correction.term_id]), correction.weight});
+    }
+
+    const double average_word_count = GetAverageWordCount();
+    std::pmr::map<int, double> document_to_relevance(query.arena->GetResource());
+    QueryBudget::Meter meter(*query.budget);
+
+    // A narrow rating range is cheaper to walk through the rating index and probe postings
+    // for its documents; otherwise postings are scanned, skipping blocks the filter rules out.
+    const auto get_size = [](const auto *postings)
+    {
+        return postings->size();
+    };
+    size_t posting_count = 0;
+    for (const auto &[postings, weight] : terms)
+    {
+        posting_count += std::visit(get_size, postings);
+    }
+    const bool has_rating_range = filter.min_rating != std::numeric_limits<int>::min() ||
+                                  filter.max_rating != std::numeric_limits<int>::max();
+    const auto candidates = has_rating_range
+                                ? document_attributes_.FindByRating(filter, posting_count / RATING_INDEX_SELECTIVITY)
+                                : std::nullopt;
+
+    for (const auto &[term_postings, weight] : terms)
+    {
+        const double inverse_document_freq = ComputeInverseDocumentFreq<Ranking>(std::visit(get_size, term_postings));
+        const auto add_score = [&, inverse_document_freq, weight = weight](int document_id, double term_freq, uint32_t word_count)
+        {
+            if (!meter.Consume())
+            {
+                return false;
+            }
+            const double score = Ranking::ComputeTermScore(term_freq, inverse_document_freq, word_count, average_word_count);
+            document_to_relevance[document_id] += score * weight;
+            return true;
+        };
+
+        std::visit([&](const auto *postings)
+                   {
+                       if (!candidates)
+                       {
+                           document_attributes_.ForEachMatch(*postings, filter, add_score);
+                           return;
+                       }
+                       auto posting = postings->begin();
+                       for (const int document_id : *candidates)
+                       {
+                           posting = SeekPosting(*postings, posting, document_id);
+                           if (posting == postings->end())
+                           {
+                               break;
+                           }
+                           if (posting->first == document_id &&
+                               !add_score(document_id, posting->second, documents_.at(document_id).word_count))
+                           {
+                               break;
+                           }
+                       }
+                   },
+                   term_postings);
+    }
+
+    for (const std::string_view word : query.minus_words)
+    {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings == word_to_document_freqs_.end())
+        {
+            continue;
+        }
+        for (const auto &[document_id, _] : postings->second)
+        {
+            document_to_relevance.erase(document_id);
+        }
+    }
+
+    return CollectMatchedDocuments(query, document_to_relevance, 1.0, after);
+}
+
+template <typename Ranking, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocumentsDense(const Query &query,
+                                                               DocumentPredicate document_predicate,
+                                                               const SearchCursor &after) const
+{
+    struct ScoredTerm
+    {
+        TermPostings postings;
+        double inverse_document_freq;
+        double weight;
+    };
+
+    std::pmr::vector<MergedPostings> prefix_postings(query.arena->GetResource());
+    prefix_postings.reserve(query.prefixes.size());
+    std::pmr::vector<ScoredTerm> terms(query.arena->GetResource());
+    const auto add_term = [&](const auto &postings, double weight)
+    {
+        if (!postings.empty())
+        {
+            terms.push_back({&postings, ComputeInverseDocumentFreq<Ranking>(postings.size()), weight});
+        }
+    };
+    for (const std::string_view word : OrderPlusWords(query))
+    {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings != word_to_document_freqs_.end())
+        {
+            add_term(postings->second, 1.0);
+        }
+    }
+    for (const auto &prefix : query.prefixes)
+    {
+        prefix_postings.push_back(MergePrefixPostings(prefix, *query.arena));
+        add_term(prefix_postings.back(), 1.0);
+    }
+    for (const auto &correction : query.corrections)
+    {
+        add_term(word_to_document_freqs_.at(term_id_to_word_[correction.term_id]), correction.weight);
+    }
+    std::pmr::vector<const std::map<int, double> *> minus_postings(query.arena->GetResource());
+    for (const std::string_view word : query.minus_words)
+    {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings != word_to_document_freqs_.end())
+        {
+            minus_postings.push_back(&postings->second);
+        }
+    }
+    const std::vector<int> phrase_documents = FindPhraseDocuments(query.phrases);
+    const double average_word_count = GetAverageWordCount();
+
+    // Each range of document positions is scored across all terms by one task into its own
+    // dense accumulator, with statuses and ratings read from the attribute columns and TF-IDF
+    // scores added by the SIMD kernel in blocks. A range then keeps only the documents that
+    // can reach the page: a min-heap holds the best relevances seen so far, and once it is
+    // full the SIMD scan skips slots below the worst of them, less EPSILON since closer
+    // relevances are ordered by rating. Slots above the relevance of the page cursor were
+    // returned on earlier pages and are dropped before their attributes are read. Every task
+    // keeps its scratch in a QueryArena of its own thread and appends the surviving documents
+    // to the result under a lock.
+    const size_t document_count = document_attributes_.GetSize();
+    const double relevance_ceiling = GetRelevanceCeiling(after);
+    const size_t range_count = std::clamp<size_t>(std::max<size_t>(std::thread::hardware_concurrency(), 1) * 4, 1,
+                                                  std::max<size_t>(document_count / MIN_DOCUMENTS_PER_RANGE, 1));
+    const size_t result_count = static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT);
+    std::pmr::vector<Document> matched_documents(query.arena->GetResource());
+    std::mutex matched_documents_mutex;
+    std::pmr::vector<size_t> ranges(range_count, query.arena->GetResource());
+    std::iota(ranges.begin(), ranges.end(), 0);
+    std::for_each(std::execution::par, ranges.begin(), ranges.end(),
+                  [&](size_t range)
+                  {
+                      QueryBudget::Meter meter(*query.budget);
+                      QueryArena range_arena;
+                      const size_t first_position = document_count * range / range_count;
+                      const size_t last_position = document_count * (range + 1) / range_count;
+                      std::pmr::vector<double> relevances(last_position - first_position, 0.0, range_arena.GetResource());
+                      std::pmr::vector<char> is_matched(last_position - first_position, 0, range_arena.GetResource());
+                      std::array<uint32_t, SCORE_BLOCK_SIZE> slots;
+                      std::array<double, SCORE_BLOCK_SIZE> term_freqs;
+                      for (const ScoredTerm &term : terms)
+                      {
+                          const bool uses_kernel = std::is_same_v<Ranking, TfIdfRanking> && term.weight == 1.0;
+                          size_t block_size = 0;
+                          bool has_budget = true;
+                          const auto score_position = [&](size_t position, double term_freq)
+                          {
+                              has_budget = meter.Consume();
+                              if (!has_budget)
+                              {
+                                  return false;
+                              }
+                              if (!document_predicate(document_attributes_.GetDocumentId(position),
+                                                      document_attributes_.GetStatus(position),
+                                                      document_attributes_.GetRating(position)))
+                              {
+                                  return true;
+                              }
+                              const size_t slot = position - first_position;
+                              is_matched[slot] = 1;
+                              if (uses_kernel)
+                              {
+                                  slots[block_size] = static_cast<uint32_t>(slot);
+                                  term_freqs[block_size] = term_freq;
+                                  if (++block_size == SCORE_BLOCK_SIZE)
+                                  {
+                                      ScoreTermBlock(slots.data(), term_freqs.data(), block_size,
+                                                     term.inverse_document_freq, relevances.data());
+                                      block_size = 0;
+                                  }
+                              }
+                              else
+                              {
+                                  relevances[slot] += Ranking::ComputeTermScore(term_freq, term.inverse_document_freq,
+                                                                                document_attributes_.GetWordCount(position),
+                                                                                average_word_count) *
+                                                      term.weight;
+                              }
+                              return true;
+                          };
+                          std::visit([&](const auto *postings)
+                                     {
+                                         document_attributes_.ForEachPosition(*postings, first_position, last_position,
+                                                                              score_position);
+                                     },
+                                     term.postings);
+                          ScoreTermBlock(slots.data(), term_freqs.data(), block_size, term.inverse_document_freq, relevances.data());
+                          if (!has_budget)
+                          {
+                              break;
+                          }
+                      }
+                      for (const auto *postings : minus_postings)
+                      {
+                          document_attributes_.ForEachPosition(*postings, first_position, last_position,
+                                                               [&](size_t position, double)
+                                                               {
+                                                                   is_matched[position - first_position] = 0;
+                                                                   return true;
+                                                               });
+                      }
+
+                      std::pmr::vector<Document> documents(range_arena.GetResource());
+                      std::pmr::vector<double> best_relevances(range_arena.GetResource());
+                      best_relevances.reserve(result_count + 1);
+                      double threshold = -std::numeric_limits<double>::infinity();
+                      for (size_t slot = 0; slot < relevances.size(); ++slot)
+                      {
+                          if (best_relevances.size() == result_count)
+                          {
+                              slot = FindNextAtLeast(relevances.data(), slot, relevances.size(), threshold);
+                              if (slot == relevances.size())
+                              {
+                                  break;
+                              }
+                          }
+                          if (!is_matched[slot] || relevances[slot] > relevance_ceiling)
+                          {
+                              continue;
+                          }
+                          const size_t position = first_position + slot;
+                          const int document_id = document_attributes_.GetDocumentId(position);
+                          const int rating = document_attributes_.GetRating(position);
+                          if ((!query.phrases.empty() &&
+                               !std::binary_search(phrase_documents.begin(), phrase_documents.end(), document_id)) ||
+                              !RanksAfterCursor(after, document_id, relevances[slot], rating))
+                          {
+                              continue;
+                          }
+                          documents.push_back({document_id, relevances[slot], rating});
+                          best_relevances.push_back(relevances[slot]);
+                          std::push_heap(best_relevances.begin(), best_relevances.end(), std::greater<>());
+                          if (best_relevances.size() > result_count)
+                          {
+                              std::pop_heap(best_relevances.begin(), best_relevances.end(), std::greater<>());
+                              best_relevances.pop_back();
+                          }
+                          if (best_relevances.size() == result_count)
+                          {
+                              threshold = best_relevances.front() - EPSILON;
+                          }
+                      }
+                      documents.erase(std::remove_if(documents.begin(), documents.end(),
+                                                     [threshold](const Document &document)
+                                                     {
+                                                         return document.relevance < threshold;
+                                                     }),
+                                      documents.end());
+
+                      std::lock_guard lock(matched_documents_mutex);
+                      matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+                  });
+    return matched_documents;
+}
+
+template <typename Ranking, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindTopDocumentsByMaxScore(const Query &query,
+                                                                    DocumentPredicate document_predicate,
+                                                                    const SearchCursor &after) const
+{
+    struct ScoredTerm
+    {
+        DocumentIdCursor cursor;
+        double inverse_document_freq;
+        double score_bound;
+    };
+
+    const double average_word_count = GetAverageWordCount();
+    std::vector<ScoredTerm> terms;
+    for (const std::string_view word : query.plus_words)
+    {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings == word_to_document_freqs_.end() || postings->second.empty())
+        {
+            continue;
+        }
+        const double inverse_document_freq = ComputeInverseDocumentFreq<Ranking>(postings->second.size());
+        const double max_term_freq = term_max_freqs_[word_to_term_id_.at(word)];
+        terms.push_back({DocumentIdCursor(postings->second), inverse_document_freq,
+                         Ranking::ComputeTermScoreBound(max_term_freq, inverse_document_freq, average_word_count)});
+    }
+    std::sort(terms.begin(), terms.end(),
+              [](const ScoredTerm &lhs, const ScoredTerm &rhs)
+              {
+                  return lhs.score_bound < rhs.score_bound;
+              });
+    std::vector<double> bound_sums = {0.0};
+    for (const auto &term : terms)
+    {
+        bound_sums.push_back(bound_sums.back() + term.score_bound);
+    }
+
+    std::vector<DocumentIdCursor> minus_cursors;
+    for (const std::string_view word : query.minus_words)
+    {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings != word_to_document_freqs_.end())
+        {
+            minus_cursors.emplace_back(postings->second);
+        }
+    }
+
+    // MaxScore: once the top is full, terms whose bounds together stay below its worst
+    // relevance cannot bring a document in on their own, so only the rest drive the scan.
+    const size_t result_count = static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT);
+    const auto ranks_before = [this](const Document &lhs, const Document &rhs)
+    {
+        return RanksBefore(lhs, rhs);
+    };
+    std::pmr::vector<Document> top_documents(query.arena->GetResource());
+    size_t first_essential = 0;
+    QueryBudget::Meter meter(*query.budget);
+
+    while (meter.Consume())
+    {
+        int document_id = std::numeric_limits<int>::max();
+        for (size_t i = first_essential; i < terms.size(); ++i)
+        {
+            if (!terms[i].cursor.IsEnd())
+            {
+                document_id = std::min(document_id, terms[i].cursor.GetDocumentId());
+            }
+        }
+        if (document_id == std::numeric_limits<int>::max())
+        {
+            break;
+        }
+
+        const auto &document_data = documents_.at(document_id);
+        bool is_skipped = !document_predicate(document_id, document_data.status, document_data.rating) ||
+                          std::any_of(minus_cursors.begin(), minus_cursors.end(),
+                                      [document_id](DocumentIdCursor &cursor)
+                                      {
+                                          cursor.SeekTo(document_id);
+                                          return !cursor.IsEnd() && cursor.GetDocumentId() == document_id;
+                                      });
+
+        double relevance = 0.0;
+        for (size_t i = first_essential; i < terms.size(); ++i)
+        {
+            auto &cursor = terms[i].cursor;
+            if (!cursor.IsEnd() && cursor.GetDocumentId() == document_id)
+            {
+                relevance += Ranking::ComputeTermScore(cursor.GetTermFreq(), terms[i].inverse_document_freq,
+                                                       document_data.word_count, average_word_count);
+                cursor.Next();
+            }
+        }
+        for (size_t i = first_essential; i > 0 && !is_skipped; --i)
+        {
+            if (top_documents.size() == result_count &&
+                relevance + bound_sums[i] < top_documents.front().relevance - EPSILON)
+            {
+                is_skipped = true;
+                break;
+            }
+            auto &cursor = terms[i - 1].cursor;
+            cursor.SeekTo(document_id);
+            if (!cursor.IsEnd() && cursor.GetDocumentId() == document_id)
+            {
+                relevance += Ranking::ComputeTermScore(cursor.GetTermFreq(), terms[i - 1].inverse_document_freq,
+                                                       document_data.word_count, average_word_count);
+            }
+        }
+        if (is_skipped || !RanksAfterCursor(after, document_id, relevance, document_data.rating))
+        {
+            continue;
+        }
+
+        const Document document{document_id, relevance, document_data.rating};
+        if (top_documents.size() < result_count)
+        {
+            top_documents.push_back(document);
+            std::push_heap(top_documents.begin(), top_documents.end(), ranks_before);
+        }
+        else if (RanksBefore(document, top_documents.front()))
+        {
+            std::pop_heap(top_documents.begin(), top_documents.end(), ranks_before);
+            top_documents.back() = document;
+            std::push_heap(top_documents.begin(), top_documents.end(), ranks_before);
+        }
+        if (top_documents.size() == result_count)
+        {
+            while (first_essential < terms.size() &&
+                   bound_sums[first_essential + 1] < top_documents.front().relevance - EPSILON)
+            {
+                ++first_essential;
+            }
+        }
+    }
+
+    return top_documents;
+}
+
+template <typename Ranking, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const Query &query,
+                                                     DocumentPredicate document_predicate,
+                                                     const SearchCursor &after) const
+{
+    return FindAllDocuments<Ranking>(std::execution::seq, query, document_predicate, after);
+}
+template <typename Ranking, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy &,
                                                      const Query &query,
-                                                     DocumentPredicate document_predicate) const
+                                                     DocumentPredicate document_predicate,
+                                                     const SearchCursor &after) const
+{
+    if constexpr (std::is_same_v<Ranking, QuantizedTfIdfRanking>)
+    {
+        if (impact_index_)
+        {
+            return FindAllDocumentsByImpact(query, document_predicate, after);
+        }
+    }
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>)
+    {
+        return FindAllDocumentsFiltered<Ranking>(query, document_predicate, after);
+    }
+
+    std::pmr::map<int, double> document_to_relevance(query.arena->GetResource());
+    ScoreTermsAtATime<Ranking>(query, document_predicate, nullptr, document_to_relevance);
+    return CollectMatchedDocuments(query, document_to_relevance, 1.0, after);
+}
+
+template <typename Ranking, typename DocumentPredicate>
+void SearchServer::ScoreTermsAtATime(const Query &query, DocumentPredicate document_predicate,
+                                     const CollectionStatistics *statistics,
+                                     std::pmr::map<int, double> &document_to_relevance) const
 {
-    std::map<int, double> document_to_relevance;
+    const double average_word_count = statistics ? statistics->average_word_count : GetAverageWordCount();
+    const auto compute_word_idf = [this, statistics](std::string_view word)
+    {
+        const size_t document_freq = word_to_document_freqs_.at(word).size();
+        if (!statistics)
+        {
+            return ComputeInverseDocumentFreq<Ranking>(document_freq);
+        }
+        const auto global_freq = statistics->word_document_freqs.find(word);
+        return Ranking::ComputeInverseDocumentFreq(statistics->document_count,
+                                                   global_freq != statistics->word_document_freqs.end()
+                                                       ? global_freq->second
+                                                       : document_freq);
+    };
+    QueryBudget::Meter meter(*query.budget);
 
-    for (std::string_view word : query.plus_words)
+    for (std::string_view word : OrderPlusWords(query))
     {
         if (word_to_document_freqs_.count(word) == 0)
         {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
+        const double inverse_document_freq = compute_word_idf(word);
+        for (const auto &[document_id, term_freq] : word_to_document_freqs_.at(word))
+        {
+            if (!meter.Consume())
+            {
+                break;
+            }
+            const auto &document_data = documents_.at(document_id);
+            if (document_predicate(document_id,
+                                   document_data.status,
+                                   document_data.rating))
+            {
+                document_to_relevance[document_id] += Ranking::ComputeTermScore(term_freq, inverse_document_freq,
+                                                                                document_data.word_count, average_word_count);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < query.prefixes.size(); ++i)
+    {
+        const auto postings = MergePrefixPostings(query.prefixes[i], *query.arena);
+        if (postings.empty())
+        {
+            continue;
+        }
+        const double inverse_document_freq =
+            statistics ? Ranking::ComputeInverseDocumentFreq(statistics->document_count, statistics->prefix_document_freqs[i])
+                       : ComputeInverseDocumentFreq<Ranking>(postings.size());
+        for (const auto &[document_id, term_freq] : postings)
+        {
+            if (!meter.Consume())
+            {
+                break;
+            }
+            const auto &document_data = documents_.at(document_id);
+            if (document_predicate(document_id,
+                                   document_data.status,
+                                   document_data.rating))
+            {
+                document_to_relevance[document_id] += Ranking::ComputeTermScore(term_freq, inverse_document_freq,
+                                                                                document_data.word_count, average_word_count);
+            }
+        }
+    }
+
+    for (const auto &correction : query.corrections)
+    {
+        std::string_view word = term_id_to_word_[correction.term_id];
+        const double inverse_document_freq = compute_word_idf(word);
+        for (const auto &[document_id, term_freq] : word_to_document_freqs_.at(word))
         {
+            if (!meter.Consume())
+            {
+                break;
+            }
             const auto &document_data = documents_.at(document_id);
             if (document_predicate(document_id,
                                    document_data.status,
                                    document_data.rating))
             {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                const double score = Ranking::ComputeTermScore(term_freq, inverse_document_freq,
+                                                               document_data.word_count, average_word_count);
+                document_to_relevance[document_id] += score * correction.weight;
             }
         }
     }
@@ -225,71 +1389,203 @@ std::vector<Document> SearchServer::FindAllDocuments(const std::execution::seque
         {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word))
+        for (const auto &[document_id, _] : word_to_document_freqs_.at(word))
         {
             document_to_relevance.erase(document_id);
         }
     }
+}
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance)
+template <typename Ranking, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy &,
+                                                     const Query &query,
+                                                     DocumentPredicate document_predicate,
+                                                     const SearchCursor &after) const
+{
+    if constexpr (std::is_same_v<Ranking, QuantizedTfIdfRanking>)
+    {
+        if (impact_index_)
+        {
+            return FindAllDocumentsByImpact(query, document_predicate, after);
+        }
+    }
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>)
     {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+        return FindAllDocumentsFiltered<Ranking>(query, document_predicate, after);
     }
 
-    return matched_documents;
+    return FindAllDocumentsDense<Ranking>(query, document_predicate, after);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy &,
-                                                     const Query &query,
-                                                     DocumentPredicate document_predicate) const
+template <typename Ranking, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindBooleanDocuments(const Query &query,
+                                                              const BooleanPlan &plan,
+                                                              DocumentPredicate document_predicate,
+                                                              const SearchCursor &after) const
 {
-    const int BUCKET_COUNT = 101;
-    ConcurrentMap<int, double> document_to_relevance(BUCKET_COUNT);
+    std::vector<int> document_ids;
+    if (plan.root >= 0)
+    {
+        QueryBudget::Meter meter(*query.budget);
+        document_ids = MatchBooleanNode(plan, plan.root, meter);
+    }
 
-    const auto plus_func = [this,
-                            &document_predicate,
-                            &document_to_relevance](std::string_view word)
+    std::vector<std::pair<int, double>> scored_terms;
+    for (const auto &[term_id, weight] : plan.scored_terms)
     {
-        if (word_to_document_freqs_.count(word) == 0)
-        { //
-            return;
+        const auto &postings = word_to_document_freqs_.at(term_id_to_word_[term_id]);
+        scored_terms.push_back({term_id, weight * ComputeInverseDocumentFreq<Ranking>(postings.size())});
+    }
+    const auto by_term_id = [](const TermFrequency &term, int term_id)
+    {
+        return term.term_id < term_id;
+    };
+    const double average_word_count = GetAverageWordCount();
+
+    std::pmr::vector<std::pair<int, double>> document_to_relevance(query.arena->GetResource());
+    for (const int document_id : document_ids)
+    {
+        const auto &document_data = documents_.at(document_id);
+        if (!document_predicate(document_id, document_data.status, document_data.rating))
+        {
+            continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto &[document_id, term_freq] : word_to_document_freqs_.at(word))
+        const auto terms_begin = ids_of_docs_to_word_freqs_.begin() + forward_index_offsets_[document_data.forward_index_slot];
+        const auto terms_end = ids_of_docs_to_word_freqs_.begin() + forward_index_offsets_[document_data.forward_index_slot + 1];
+        auto position = terms_begin;
+        double relevance = 0.0;
+        for (const auto &[term_id, weighted_inverse_document_freq] : scored_terms)
         {
-            const auto &document_data = documents_.at(document_id); //
-            if (document_predicate(document_id, document_data.status, document_data.rating))
+            position = GallopingLowerBound(position, terms_end, term_id, by_term_id);
+            if (position != terms_end && position->term_id == term_id)
             {
-                document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+                relevance += Ranking::ComputeTermScore(position->freq, weighted_inverse_document_freq,
+                                                       document_data.word_count, average_word_count);
             }
         }
-    };
+        document_to_relevance.push_back({document_id, relevance});
+    }
 
-    for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), plus_func);
+    return CollectMatchedDocuments(query, document_to_relevance, 1.0, after);
+}
 
-    const auto minus_erase_func = [&](std::string_view word)
+template <typename DocumentToRelevance>
+std::pmr::vector<Document> SearchServer::CollectMatchedDocuments(const Query &query,
+                                                            const DocumentToRelevance &document_to_relevance,
+                                                            double relevance_scale,
+                                                            const SearchCursor &after) const
+{
+    const std::vector<int> phrase_documents = FindPhraseDocuments(query.phrases);
+    const double relevance_ceiling = GetRelevanceCeiling(after);
+
+    std::pmr::vector<Document> matched_documents(query.arena->GetResource());
+    for (const auto &[document_id, score] : document_to_relevance)
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        if (!query.phrases.empty() &&
+            !std::binary_search(phrase_documents.begin(), phrase_documents.end(), document_id))
         {
-            return;
+            continue;
         }
-        for (const auto &[document_id, _] : word_to_document_freqs_.at(word))
+        const double relevance = score * relevance_scale;
+        if (relevance > relevance_ceiling)
         {
-            document_to_relevance.erase(document_id);
+            continue;
         }
-    };
+        const int rating = documents_.at(document_id).rating;
+        if (RanksAfterCursor(after, document_id, relevance, rating))
+        {
+            matched_documents.push_back({document_id, relevance, rating});
+        }
+    }
 
-    for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), minus_erase_func);
+    return matched_documents;
+}
+
+template <typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocumentsByImpact(const Query &query,
+                                                             DocumentPredicate document_predicate,
+                                                             const SearchCursor &after) const
+{
+    std::pmr::map<int, uint32_t> document_to_impact(query.arena->GetResource());
+    QueryBudget::Meter meter(*query.budget);
+    bool is_exhausted = false;
 
-    const auto &document_to_relevance_bom = document_to_relevance.BuildOrdinaryMap();
+    const auto add_term = [this, &document_predicate, &document_to_impact, &meter, &is_exhausted](int term_id, double weight)
+    {
+        impact_index_->ForEachImpact(term_id, [&](int document_id, uint32_t impact)
+                                     {
+                                         if (!meter.Consume())
+                                         {
+                                             is_exhausted = true;
+                                             return false;
+                                         }
+                                         const auto &document_data = documents_.at(document_id);
+                                         if (document_predicate(document_id, document_data.status, document_data.rating))
+                                         {
+                                             document_to_impact[document_id] +=
+                                                 weight == 1.0 ? impact : static_cast<uint32_t>(std::lround(impact * weight));
+                                         }
+                                         return true;
+                                     });
+    };
+
+    for (const int term_id : FindTermIds(query.plus_words))
+    {
+        if (is_exhausted)
+        {
+            break;
+        }
+        add_term(term_id, 1.0);
+    }
+    // A prefix is scored like one term over its merged postings, as in the exact search, so its
+    // impacts are quantized at query time from the idf of the merged document count.
+    for (const auto &prefix : query.prefixes)
+    {
+        if (is_exhausted)
+        {
+            break;
+        }
+        const auto postings = MergePrefixPostings(prefix, *query.arena);
+        const double inverse_document_freq = ComputeInverseDocumentFreq<TfIdfRanking>(postings.size());
+        for (const auto &[document_id, term_freq] : postings)
+        {
+            if (!meter.Consume())
+            {
+                is_exhausted = true;
+                break;
+            }
+            const auto &document_data = documents_.at(document_id);
+            if (document_predicate(document_id, document_data.status, document_data.rating))
+            {
+                document_to_impact[document_id] += impact_index_->Quantize(term_freq * inverse_document_freq);
+            }
+        }
+    }
+    for (const auto &correction : query.corrections)
+    {
+        if (is_exhausted)
+        {
+            break;
+        }
+        add_term(correction.term_id, correction.weight);
+    }
 
-    std::vector<Document> matched_documents;
-    for (const auto &[document_id, relevance] : document_to_relevance_bom)
+    for (const auto word : query.minus_words)
     {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings == word_to_document_freqs_.end())
+        {
+            continue;
+        }
+        for (const auto &[document_id, _] : postings->second)
+        {
+            document_to_impact.erase(document_id);
+        }
     }
 
-    return matched_documents;
-}
\ No newline at end of file
+    return CollectMatchedDocuments(query, document_to_impact, impact_index_->GetScale(), after);
+}
+
+#ifdef __cpp_impl_coroutine
+#include "async_search.h"
+#endif
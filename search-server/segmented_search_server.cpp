@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <numeric>
+
+#include "segmented_search_server.h"
+
+SegmentedSearchServer::~SegmentedSearchServer()
+{
+    {
+        std::lock_guard lock(mutex_);
+        is_stopping_ = true;
+    }
+    merge_state_changed_.notify_all();
+    merge_thread_.join();
+}
+
+void SegmentedSearchServer::AddDocument(int document_id,
+                                        std::string_view document,
+                                        DocumentStatus status,
+                                        const std::vector<int> &ratings)
+{
+    std::unique_lock lock(mutex_);
+
+    for (const auto &segment : segments_)
+    {
+        if (segment->ContainsDocument(document_id))
+        {
+            throw std::invalid_argument("Invalid document ID"s);
+        }
+    }
+    mutable_segment_->AddDocument(document_id, document, status, ratings);
+
+    if (static_cast<size_t>(mutable_segment_->GetDocumentCount()) >= options_.max_mutable_documents)
+    {
+        SealMutableSegment();
+    }
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id)
+{
+    std::unique_lock lock(mutex_);
+
+    if (mutable_segment_->documents_.count(document_id) > 0)
+    {
+        mutable_segment_->RemoveDocument(document_id);
+        return;
+    }
+    for (const auto &segment : segments_)
+    {
+        if (segment->RemoveDocument(document_id))
+        {
+            merge_state_changed_.notify_all();
+            return;
+        }
+    }
+}
+
+void SegmentedSearchServer::Flush()
+{
+    std::unique_lock lock(mutex_);
+    SealMutableSegment();
+}
+
+void SegmentedSearchServer::WaitForMerges()
+{
+    std::unique_lock lock(mutex_);
+    merge_state_changed_.wait(lock, [this]
+                              {
+                                  return !is_merging_ && PickSegmentsToMerge().empty();
+                              });
+}
+
+int SegmentedSearchServer::GetDocumentCount() const
+{
+    std::shared_lock lock(mutex_);
+    size_t document_count = mutable_segment_->GetDocumentCount();
+    for (const auto &segment : segments_)
+    {
+        document_count += segment->GetLiveDocumentCount();
+    }
+    return static_cast<int>(document_count);
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const
+{
+    std::shared_lock lock(mutex_);
+    return segments_.size();
+}
+
+size_t SegmentedSearchServer::GetMemoryUsage() const
+{
+    std::shared_lock lock(mutex_);
+    size_t memory_usage = mutable_segment_->GetMemoryUsage().GetTotal();
+    for (const auto &segment : segments_)
+    {
+        memory_usage += segment->GetMemoryUsage();
+    }
+    return memory_usage;
+}
+
+void SegmentedSearchServer::SealMutableSegment()
+{
+    if (mutable_segment_->GetDocumentCount() == 0)
+    {
+        return;
+    }
+
+    IndexSegment::Builder builder;
+    std::vector<std::pair<std::string_view, double>> word_freqs;
+    for (const int document_id : *mutable_segment_)
+    {
+        const auto &document_data = mutable_segment_->documents_.at(document_id);
+        const auto document_word_freqs = mutable_segment_->GetWordFrequencies(document_id);
+        word_freqs.assign(document_word_freqs.begin(), document_word_freqs.end());
+        builder.AddDocument({document_id, document_data.rating, document_data.status, document_data.word_count},
+                            word_freqs);
+    }
+
+    segments_.push_back(std::make_shared<IndexSegment>(builder.Build()));
+    mutable_segment_ = std::make_unique<SearchServer>(stop_words_);
+    merge_state_changed_.notify_all();
+}
+
+std::vector<std::shared_ptr<IndexSegment>> SegmentedSearchServer::PickSegmentsToMerge() const
+{
+    std::map<int, std::vector<std::shared_ptr<IndexSegment>>> segments_by_tier;
+    for (const auto &segment : segments_)
+    {
+        const size_t document_count = segment->GetDocumentCount();
+        if (document_count - segment->GetLiveDocumentCount() > options_.max_deleted_share * document_count)
+        {
+            return {segment};
+        }
+
+        int tier = 0;
+        for (size_t tier_size = options_.max_mutable_documents; document_count > tier_size;
+             tier_size *= options_.merge_factor)
+        {
+            ++tier;
+        }
+        auto &tier_segments = segments_by_tier[tier];
+        tier_segments.push_back(segment);
+        if (tier_segments.size() == options_.merge_factor)
+        {
+            return tier_segments;
+        }
+    }
+    return {};
+}
+
+void SegmentedSearchServer::MergeSegments(std::unique_lock<std::shared_mutex> &lock)
+{
+    const auto sources = PickSegmentsToMerge();
+    std::vector<std::vector<bool>> deleted_before_merge;
+    for (const auto &source : sources)
+    {
+        deleted_before_merge.push_back(source->GetDeletedDocuments());
+    }
+    is_merging_ = true;
+
+    lock.unlock();
+    IndexSegment::Builder builder;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        sources[i]->AppendLiveDocuments(builder, deleted_before_merge[i]);
+    }
+    auto merged = std::make_shared<IndexSegment>(builder.Build());
+    lock.lock();
+
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        for (uint32_t document_index = 0; document_index < sources[i]->GetDocumentCount(); ++document_index)
+        {
+            if (sources[i]->IsDeleted(document_index) && !deleted_before_merge[i][document_index])
+            {
+                merged->RemoveDocument(sources[i]->GetDocument(document_index).id);
+            }
+        }
+    }
+
+    segments_.erase(std::remove_if(segments_.begin(), segments_.end(),
+                                   [&sources](const std::shared_ptr<IndexSegment> &segment)
+                                   {
+                                       return std::find(sources.begin(), sources.end(), segment) != sources.end();
+                                   }),
+                    segments_.end());
+    if (merged->GetLiveDocumentCount() > 0)
+    {
+        segments_.push_back(std::move(merged));
+    }
+    is_merging_ = false;
+    merge_state_changed_.notify_all();
+}
+
+void SegmentedSearchServer::RunMerges()
+{
+    std::unique_lock lock(mutex_);
+    while (true)
+    {
+        merge_state_changed_.wait(lock, [this]
+                                  {
+                                      return is_stopping_ || !PickSegmentsToMerge().empty();
+                                  });
+        if (is_stopping_)
+        {
+            return;
+        }
+        MergeSegments(lock);
+    }
+}
+
+SegmentedSearchServer::SegmentedQuery SegmentedSearchServer::ParseQuery(std::string_view raw_query, QueryArena &arena,
+                                                                        QueryBudget &budget) const
+{
+    for (std::string_view word : SplitIntoWords(raw_query))
+    {
+        if (word[0] == '"')
+        {
+            throw std::invalid_argument("Phrase queries are not supported by the segmented index"s);
+        }
+    }
+
+    SegmentedQuery result{mutable_segment_->ParseQuery(raw_query, arena), {}};
+    result.query.budget = &budget;
+
+    // The mutable segment keeps only those of its prefix words that are among the first
+    // expansions over all segments
+    const auto &mutable_words = mutable_segment_->term_id_to_word_;
+    for (auto &prefix : result.query.prefixes)
+    {
+        auto words = ExpandPrefix(prefix.text);
+        prefix.term_ids.erase(std::remove_if(prefix.term_ids.begin(), prefix.term_ids.end(),
+                                             [&words, &mutable_words](int term_id)
+                                             {
+                                                 return !std::binary_search(words.begin(), words.end(),
+                                                                            mutable_words[term_id]);
+                                             }),
+                              prefix.term_ids.end());
+        result.prefix_words.push_back(std::move(words));
+    }
+    for (const std::string_view prefix : result.query.minus_prefixes)
+    {
+        for (const std::string_view word : ExpandPrefix(prefix))
+        {
+            result.query.minus_words.push_back(word);
+        }
+    }
+    return result;
+}
+
+std::vector<std::string_view> SegmentedSearchServer::ExpandPrefix(std::string_view prefix) const
+{
+    const size_t max_count = mutable_segment_->max_prefix_expansions_;
+    const auto &mutable_words = mutable_segment_->term_id_to_word_;
+
+    std::vector<std::string_view> words;
+    for (const int term_id : mutable_segment_->prefix_dictionary_.FindByPrefix(prefix, mutable_words, max_count))
+    {
+        words.push_back(mutable_words[term_id]);
+    }
+    for (const auto &segment : segments_)
+    {
+        for (const uint32_t term : segment->FindTermsByPrefix(prefix, max_count))
+        {
+            words.push_back(segment->GetTerm(term));
+        }
+    }
+
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    if (words.size() > max_count)
+    {
+        words.resize(max_count);
+    }
+    return words;
+}
+
+SearchServer::CollectionStatistics SegmentedSearchServer::ComputeQueryStatistics(const SegmentedQuery &query) const
+{
+    size_t document_count = mutable_segment_->GetDocumentCount();
+    uint64_t word_count = mutable_segment_->total_word_count_;
+    for (const auto &segment : segments_)
+    {
+        document_count += segment->GetLiveDocumentCount();
+        word_count += segment->GetLiveWordCount();
+    }
+
+    SearchServer::CollectionStatistics statistics;
+    statistics.document_count = static_cast<int>(document_count);
+    statistics.average_word_count = document_count == 0 ? 0.0 : static_cast<double>(word_count) / document_count;
+    for (std::string_view word : query.query.plus_words)
+    {
+        const auto postings = mutable_segment_->word_to_document_freqs_.find(word);
+        size_t document_freq = postings == mutable_segment_->word_to_document_freqs_.end() ? 0 : postings->second.size();
+        for (const auto &segment : segments_)
+        {
+            document_freq += segment->GetLiveDocumentFreq(word);
+        }
+        statistics.word_document_freqs[word] = document_freq;
+    }
+
+    // A document counts once per prefix however many of its words it contains
+    for (size_t i = 0; i < query.prefix_words.size(); ++i)
+    {
+        size_t document_freq = mutable_segment_->MergePrefixPostings(query.query.prefixes[i], *query.query.arena).size();
+        for (const auto &segment : segments_)
+        {
+            std::vector<uint32_t> document_indexes;
+            for (const std::string_view word : query.prefix_words[i])
+            {
+                const auto term = segment->FindTerm(word);
+                if (!term)
+                {
+                    continue;
+                }
+                const auto [first, last] = segment->GetPostings(*term);
+                for (auto posting = first; posting != last; ++posting)
+                {
+                    if (!segment->IsDeleted(posting->document_index))
+                    {
+                        document_indexes.push_back(posting->document_index);
+                    }
+                }
+            }
+            std::sort(document_indexes.begin(), document_indexes.end());
+            document_freq += std::unique(document_indexes.begin(), document_indexes.end()) - document_indexes.begin();
+        }
+        statistics.prefix_document_freqs.push_back(document_freq);
+    }
+    return statistics;
+}
+
+void SegmentedSearchServer::KeepTopDocuments(std::vector<Document> &documents) const
+{
+    const size_t page_size = std::min(documents.size(),
+                                      static_cast<size_t>(mutable_segment_->MAX_RESULT_DOCUMENT_COUNT));
+    std::partial_sort(documents.begin(), documents.begin() + page_size, documents.end(),
+                      [this](const Document &lhs, const Document &rhs)
+                      {
+                          return mutable_segment_->RanksBefore(lhs, rhs);
+                      });
+    documents.resize(page_size);
+}
@@ -0,0 +1,286 @@
+#pragma once
+#include <condition_variable>
+#include <memory>
+#include <shared_mutex>
+#include <thread>
+#include "index_segment.h"
+#include "search_server.h"
+
+struct SegmentedIndexOptions
+{
+    size_t max_mutable_documents = 1 << 12;
+    size_t merge_factor = 4;
+    double max_deleted_share = 0.5;
+};
+
+// Writes go to a small mutable SearchServer that is sealed into an immutable IndexSegment
+// once it holds max_mutable_documents. Removing a sealed document only sets its tombstone.
+// A background thread merges merge_factor segments of the same size tier and rewrites
+// segments where tombstones exceed max_deleted_share. Queries score every segment with
+// document frequencies summed over all segments, so relevance matches a single SearchServer;
+// the mutable segment is scored by SearchServer itself. Prefixes expand to the first words
+// over all segments. Phrases are rejected, and segments keep no fuzzy dictionary.
+class SegmentedSearchServer
+{
+public:
+    template <typename StringContainer>
+    explicit SegmentedSearchServer(const StringContainer &stop_words, const SegmentedIndexOptions &options = {});
+    explicit SegmentedSearchServer(const std::string &stop_words_text, const SegmentedIndexOptions &options = {})
+        : SegmentedSearchServer(SplitIntoWords(stop_words_text), options) {}
+
+    SegmentedSearchServer(const SegmentedSearchServer &) = delete;
+    SegmentedSearchServer &operator=(const SegmentedSearchServer &) = delete;
+    ~SegmentedSearchServer();
+
+    void AddDocument(int document_id,
+                     std::string_view document,
+                     DocumentStatus status,
+                     const std::vector<int> &ratings);
+
+    void RemoveDocument(int document_id);
+
+    void Flush();
+    void WaitForMerges();
+
+    template <typename Ranking = TfIdfRanking, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    template <typename Ranking = TfIdfRanking>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+
+    template <typename Ranking = TfIdfRanking>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+    size_t GetSegmentCount() const;
+    size_t GetMemoryUsage() const;
+
+private:
+    struct SegmentedQuery
+    {
+        SearchServer::Query query;
+        // Expansions of query.prefixes over all segments, in the same order
+        std::vector<std::vector<std::string_view>> prefix_words;
+    };
+
+    const std::vector<std::string> stop_words_;
+    const SegmentedIndexOptions options_;
+
+    mutable std::shared_mutex mutex_;
+    std::condition_variable_any merge_state_changed_;
+    std::unique_ptr<SearchServer> mutable_segment_;
+    std::vector<std::shared_ptr<IndexSegment>> segments_;
+    bool is_merging_ = false;
+    bool is_stopping_ = false;
+    std::thread merge_thread_;
+
+    void SealMutableSegment();
+
+    std::vector<std::shared_ptr<IndexSegment>> PickSegmentsToMerge() const;
+    void MergeSegments(std::unique_lock<std::shared_mutex> &lock);
+    void RunMerges();
+
+    SegmentedQuery ParseQuery(std::string_view raw_query, QueryArena &arena, QueryBudget &budget) const;
+    std::vector<std::string_view> ExpandPrefix(std::string_view prefix) const;
+    SearchServer::CollectionStatistics ComputeQueryStatistics(const SegmentedQuery &query) const;
+
+    template <typename Ranking, typename DocumentPredicate>
+    std::vector<Document> FindMutableSegmentDocuments(const SegmentedQuery &query,
+                                                      const SearchServer::CollectionStatistics &statistics,
+                                                      DocumentPredicate document_predicate) const;
+
+    template <typename Ranking, typename DocumentPredicate>
+    std::vector<Document> FindSegmentDocuments(const IndexSegment &segment,
+                                               const SegmentedQuery &query,
+                                               const SearchServer::CollectionStatistics &statistics,
+                                               DocumentPredicate document_predicate) const;
+
+    void KeepTopDocuments(std::vector<Document> &documents) const;
+};
+
+template <typename StringContainer>
+SegmentedSearchServer::SegmentedSearchServer(const StringContainer &stop_words, const SegmentedIndexOptions &options)
+    : stop_words_(stop_words.begin(), stop_words.end()),
+      options_(options),
+      mutable_segment_(std::make_unique<SearchServer>(stop_words_))
+{
+    if (options_.max_mutable_documents == 0 || options_.merge_factor < 2)
+    {
+        throw std::invalid_argument("Invalid segmented index options"s);
+    }
+    merge_thread_ = std::thread([this]
+                                {
+                                    RunMerges();
+                                });
+}
+
+template <typename Ranking, typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query,
+                                                              DocumentPredicate document_predicate) const
+{
+    std::shared_lock lock(mutex_);
+
+    QueryArena arena;
+    QueryBudget budget(nullptr);
+    const auto query = ParseQuery(raw_query, arena, budget);
+    const auto statistics = ComputeQueryStatistics(query);
+
+    auto matched_documents = FindMutableSegmentDocuments<Ranking>(query, statistics, document_predicate);
+    for (const auto &segment : segments_)
+    {
+        const auto segment_documents = FindSegmentDocuments<Ranking>(*segment, query, statistics, document_predicate);
+        matched_documents.insert(matched_documents.end(), segment_documents.begin(), segment_documents.end());
+    }
+    KeepTopDocuments(matched_documents);
+    return matched_documents;
+}
+
+template <typename Ranking>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments<Ranking>(raw_query, [status](int, DocumentStatus document_status, int)
+                                     {
+                                         return document_status == status;
+                                     });
+}
+
+template <typename Ranking>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query) const
+{
+    return FindTopDocuments<Ranking>(raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Ranking, typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindMutableSegmentDocuments(const SegmentedQuery &query,
+                                                                         const SearchServer::CollectionStatistics &statistics,
+                                                                         DocumentPredicate document_predicate) const
+{
+    std::pmr::map<int, double> document_to_relevance(query.query.arena->GetResource());
+    mutable_segment_->ScoreTermsAtATime<Ranking>(query.query, document_predicate, &statistics, document_to_relevance);
+    const auto collected_documents = mutable_segment_->CollectMatchedDocuments(query.query, document_to_relevance,
+                                                                               1.0, SearchCursor());
+
+    std::vector<Document> matched_documents(collected_documents.begin(), collected_documents.end());
+    KeepTopDocuments(matched_documents);
+    return matched_documents;
+}
+
+template <typename Ranking, typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindSegmentDocuments(const IndexSegment &segment,
+                                                                  const SegmentedQuery &query,
+                                                                  const SearchServer::CollectionStatistics &statistics,
+                                                                  DocumentPredicate document_predicate) const
+{
+    enum class State : uint8_t
+    {
+        UNSEEN,
+        MATCHED,
+        SKIPPED,
+    };
+
+    std::vector<State> states(segment.GetDocumentCount(), State::UNSEEN);
+    std::vector<double> relevances(segment.GetDocumentCount(), 0.0);
+    std::vector<uint32_t> matched_indexes;
+
+    const auto add_score = [&](uint32_t document_index, double term_freq, double inverse_document_freq)
+    {
+        auto &state = states[document_index];
+        const auto &document = segment.GetDocument(document_index);
+        if (state == State::UNSEEN)
+        {
+            const bool is_matched = !segment.IsDeleted(document_index) &&
+                                    document_predicate(document.id, document.status, document.rating);
+            state = is_matched ? State::MATCHED : State::SKIPPED;
+            if (is_matched)
+            {
+                matched_indexes.push_back(document_index);
+            }
+        }
+        if (state == State::MATCHED)
+        {
+            relevances[document_index] += Ranking::ComputeTermScore(term_freq, inverse_document_freq,
+                                                                    document.word_count,
+                                                                    statistics.average_word_count);
+        }
+    };
+
+    for (const std::string_view word : query.query.plus_words)
+    {
+        const auto term = segment.FindTerm(word);
+        if (!term)
+        {
+            continue;
+        }
+        const double inverse_document_freq = Ranking::ComputeInverseDocumentFreq(statistics.document_count,
+                                                                                  statistics.word_document_freqs.at(word));
+        const auto [first, last] = segment.GetPostings(*term);
+        for (auto posting = first; posting != last; ++posting)
+        {
+            add_score(posting->document_index, posting->term_freq, inverse_document_freq);
+        }
+    }
+
+    // Like SearchServer, a prefix scores once per document with the term frequencies of its
+    // words summed, here in a dense column indexed like the documents
+    std::vector<double> prefix_term_freqs;
+    std::vector<uint32_t> prefix_indexes;
+    for (size_t i = 0; i < query.prefix_words.size(); ++i)
+    {
+        prefix_term_freqs.resize(segment.GetDocumentCount(), 0.0);
+        prefix_indexes.clear();
+        for (const std::string_view word : query.prefix_words[i])
+        {
+            const auto term = segment.FindTerm(word);
+            if (!term)
+            {
+                continue;
+            }
+            const auto [first, last] = segment.GetPostings(*term);
+            for (auto posting = first; posting != last; ++posting)
+            {
+                if (prefix_term_freqs[posting->document_index] == 0.0)
+                {
+                    prefix_indexes.push_back(posting->document_index);
+                }
+                prefix_term_freqs[posting->document_index] += posting->term_freq;
+            }
+        }
+        if (prefix_indexes.empty())
+        {
+            continue;
+        }
+        const double inverse_document_freq = Ranking::ComputeInverseDocumentFreq(statistics.document_count,
+                                                                                  statistics.prefix_document_freqs[i]);
+        for (const uint32_t document_index : prefix_indexes)
+        {
+            add_score(document_index, prefix_term_freqs[document_index], inverse_document_freq);
+            prefix_term_freqs[document_index] = 0.0;
+        }
+    }
+
+    for (std::string_view word : query.query.minus_words)
+    {
+        const auto term = segment.FindTerm(word);
+        if (!term)
+        {
+            continue;
+        }
+        const auto [first, last] = segment.GetPostings(*term);
+        for (auto posting = first; posting != last; ++posting)
+        {
+            states[posting->document_index] = State::SKIPPED;
+        }
+    }
+
+    std::vector<Document> matched_documents;
+    for (const uint32_t document_index : matched_indexes)
+    {
+        if (states[document_index] == State::MATCHED)
+        {
+            const auto &document = segment.GetDocument(document_index);
+            matched_documents.push_back({document.id, relevances[document_index], document.rating});
+        }
+    }
+    KeepTopDocuments(matched_documents);
+    return matched_documents;
+}
@@ -1,20 +1,34 @@
 #include "string_processing.h"
 
-std::vector<std::string_view> SplitIntoWords(std::string_view text)
+namespace
 {
+    template <typename Words>
+    void AppendWords(std::string_view text, Words &words)
+    {
+        std::string_view delimiter = " ";
 
-    std::string_view delimiter = " ";
-    std::vector<std::string_view> words;
-
-    int64_t start_pos = text.find_first_not_of(delimiter);
-    const int64_t end_pos = text.npos;
+        int64_t start_pos = text.find_first_not_of(delimiter);
+        const int64_t end_pos = text.npos;
 
-    while (start_pos != end_pos)
-    {
-        int64_t space = text.find(' ', start_pos);
-        words.push_back(space == end_pos ? text.substr(start_pos) : text.substr(start_pos, space - start_pos));
-        start_pos = text.find_first_not_of(delimiter, space);
+        while (start_pos != end_pos)
+        {
+            int64_t space = text.find(' ', start_pos);
+            words.push_back(space == end_pos ? text.substr(start_pos) : text.substr(start_pos, space - start_pos));
+            start_pos = text.find_first_not_of(delimiter, space);
+        }
     }
+}
 
+std::vector<std::string_view> SplitIntoWords(std::string_view text)
+{
+    std::vector<std::string_view> words;
+    AppendWords(text, words);
+    return words;
+}
+
+std::pmr::vector<std::string_view> SplitIntoWords(std::string_view text, std::pmr::memory_resource *resource)
+{
+    std::pmr::vector<std::string_view> words(resource);
+    AppendWords(text, words);
     return words;
-}
\ No newline at end of file
+}
@@ -1,10 +1,12 @@
 #pragma once
+#include <memory_resource>
 #include <set>
 #include <vector>
 #include <string>
 #include <iostream>
 
 std::vector<std::string_view> SplitIntoWords(const std::string_view text);
+std::pmr::vector<std::string_view> SplitIntoWords(std::string_view text, std::pmr::memory_resource *resource);
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer &strings)
@@ -0,0 +1,1210 @@
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+
+#include "document_ingest.h"
+#include "frozen_search_server.h"
+#include "offline_indexer.h"
+#include "scoring_kernel.h"
+#include "search_server.h"
+#include "segmented_search_server.h"
+#include "test_framework.h"
+#include "text_arena.h"
+#include "test_example_functions.h"
+
+using namespace std;
+
+namespace
+{
+    void AssertSameDocuments(const vector<Document> &lhs, const vector<Document> &rhs, const string &hint)
+    {
+        AssertEqual(lhs.size(), rhs.size(), hint);
+        for (size_t i = 0; i < lhs.size(); ++i)
+        {
+            AssertEqual(lhs[i].id, rhs[i].id, hint);
+            AssertEqual(lhs[i].rating, rhs[i].rating, hint);
+            Assert(abs(lhs[i].relevance - rhs[i].relevance) < 1e-6, hint);
+        }
+    }
+
+    // Words w0..w4 occur in most documents, the rest are rare. Queries with a
+    // prefix are always scored term at a time and are not supported by the frozen index.
+    string GenerateText(mt19937 &generator, int word_count)
+    {
+        string text;
+        for (int i = 0; i < word_count; ++i)
+        {
+            const unsigned word = generator() % 2 == 0 ? generator() % 5 : generator() % 5000;
+            text += "w"s + to_string(word) + " "s;
+        }
+        return text;
+    }
+
+    vector<string> GenerateQueries(mt19937 &generator)
+    {
+        vector<string> queries;
+        for (int i = 0; i < 40; ++i)
+        {
+            string query;
+            const int word_count = 1 + static_cast<int>(generator() % 4);
+            for (int j = 0; j < word_count; ++j)
+            {
+                const unsigned word = i % 3 == 0 ? generator() % 5 : generator() % 5000;
+                query += "w"s + to_string(word) + " "s;
+            }
+            if (i % 4 == 0)
+            {
+                query += "-w"s + to_string(generator() % 5) + " "s;
+            }
+            if (i % 5 == 0)
+            {
+                query += "w"s + to_string(10 + generator() % 90) + "*"s;
+            }
+            queries.push_back(query);
+        }
+        return queries;
+    }
+
+    template <typename Ranking>
+    void AssertSearchPathsMatch(const SearchServer &search_server, const string &query)
+    {
+        const auto expected = search_server.FindTopDocuments<Ranking>(execution::seq, query);
+        AssertSameDocuments(search_server.FindTopDocuments<Ranking>(query, QueryOptions{}).documents, expected, query);
+        AssertSameDocuments(search_server.FindTopDocuments<Ranking>(execution::par, query, QueryOptions{}).documents,
+                            expected, query);
+        AssertSameDocuments(search_server.FindTopDocuments<Ranking>(execution::par, query), expected, query);
+
+        const DocumentFilter filter{{DocumentStatus::ACTUAL}, 3, 7};
+        const auto predicate = [](int, DocumentStatus status, int rating)
+        {
+            return status == DocumentStatus::ACTUAL && rating >= 3 && rating <= 7;
+        };
+        const auto expected_filtered = search_server.FindTopDocuments<Ranking>(execution::seq, query, predicate);
+        AssertSameDocuments(search_server.FindTopDocuments<Ranking>(execution::seq, query, filter), expected_filtered, query);
+        AssertSameDocuments(search_server.FindTopDocuments<Ranking>(execution::par, query, filter), expected_filtered, query);
+        AssertSameDocuments(search_server.FindTopDocuments<Ranking>(execution::par, query, predicate), expected_filtered, query);
+    }
+
+    template <typename Ranking>
+    void AssertFrozenSearchMatches(const SearchServer &search_server, const FrozenSearchServer &frozen,
+                                   const string &query)
+    {
+        const auto expected = search_server.FindTopDocuments<Ranking>(execution::seq, query);
+        AssertSameDocuments(frozen.FindTopDocuments<Ranking>(execution::seq, query), expected, query);
+        AssertSameDocuments(frozen.FindTopDocuments<Ranking>(execution::par, query), expected, query);
+    }
+
+    vector<int> FindDocumentIds(const SearchServer &search_server, const string &query, QueryMode mode)
+    {
+        QueryOptions options;
+        options.mode = mode;
+        vector<int> document_ids;
+        for (const auto &document : search_server.FindTopDocuments(query, options).documents)
+        {
+            document_ids.push_back(document.id);
+        }
+        sort(document_ids.begin(), document_ids.end());
+        return document_ids;
+    }
+
+    template <typename ExecutionPolicy>
+    vector<vector<Document>> FindAllPages(const SearchServer &search_server, ExecutionPolicy &&policy, const string &query)
+    {
+        vector<vector<Document>> pages;
+        SearchCursor cursor;
+        while (!cursor.IsEnd())
+        {
+            auto page = search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, cursor);
+            pages.push_back(move(page.documents));
+            cursor = page.next;
+        }
+        return pages;
+    }
+
+    vector<size_t> GetPageSizes(const vector<vector<Document>> &pages)
+    {
+        vector<size_t> sizes;
+        for (const auto &page : pages)
+        {
+            sizes.push_back(page.size());
+        }
+        return sizes;
+    }
+
+    void AssertAllSearchPathsMatch(const SearchServer &search_server, const vector<string> &queries)
+    {
+        const FrozenSearchServer frozen(search_server);
+        for (const string &query : queries)
+        {
+            AssertSearchPathsMatch<TfIdfRanking>(search_server, query);
+            AssertSearchPathsMatch<Bm25Ranking>(search_server, query);
+            AssertSearchPathsMatch<Bm25PlusRanking>(search_server, query);
+            if (query.find('*') == string::npos)
+            {
+                AssertFrozenSearchMatches<TfIdfRanking>(search_server, frozen, query);
+                AssertFrozenSearchMatches<Bm25Ranking>(search_server, frozen, query);
+                AssertFrozenSearchMatches<Bm25PlusRanking>(search_server, frozen, query);
+            }
+        }
+    }
+}
+
+void TestPhraseQueriesRequirePositionalIndex()
+{
+    for (const bool is_positional : {false, true})
+    {
+        SearchServer search_server("and"s);
+        if (is_positional)
+        {
+            search_server.EnablePositionalIndex();
+        }
+        search_server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(2, "cat white tail"s, DocumentStatus::ACTUAL, {2});
+
+        if (!is_positional)
+        {
+            ASSERT_THROWS(search_server.FindTopDocuments("\"white cat\""s), invalid_argument);
+            ASSERT_THROWS(search_server.MatchDocument("\"white cat\""s, 1), invalid_argument);
+            ASSERT_THROWS(search_server.MatchDocuments("\"white cat\""s, {1, 2}), invalid_argument);
+            continue;
+        }
+        ASSERT_EQUAL(get<0>(search_server.MatchDocument("\"white cat\""s, 1)).size(), 2u);
+        ASSERT(get<0>(search_server.MatchDocument("\"white cat\""s, 2)).empty());
+        ASSERT_EQUAL(search_server.FindTopDocuments("\"white cat\""s).size(), 1u);
+    }
+}
+
+void TestOpenIndexMatchesBuiltIndex()
+{
+    const vector<NewDocument> documents = {
+        {5, "white cat and fancy collar"sv, DocumentStatus::ACTUAL, {8, -3}},
+        {1, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, {7, 2, 7}},
+        {9, "groomed dog expressive eyes"sv, DocumentStatus::ACTUAL, {5, -12, 2, 1}},
+        {3, "groomed starling evgeny"sv, DocumentStatus::BANNED, {9}},
+        {12, "cat in the city"sv, DocumentStatus::IRRELEVANT, {}},
+    };
+    const auto temp_directory = filesystem::temp_directory_path();
+    const string index_path = (temp_directory / "search_server_test_index.bin"s).string();
+    const string truncated_path = (temp_directory / "search_server_test_truncated.bin"s).string();
+
+    SearchServer built("and in the"s);
+    OfflineIndexer indexer("and in the"s);
+    for (const auto &document : documents)
+    {
+        built.AddDocument(document.id, document.text, document.status, document.ratings);
+        indexer.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+    ASSERT_THROWS(indexer.AddDocument(1, "duplicate"sv, DocumentStatus::ACTUAL, {}), invalid_argument);
+    indexer.Finish(index_path);
+
+    SearchServer opened("and in the"s);
+    opened.OpenIndex(index_path);
+    const FrozenSearchServer frozen = FrozenSearchServer::OpenIndex(index_path);
+    ASSERT_EQUAL(opened.GetDocumentCount(), built.GetDocumentCount());
+    ASSERT_EQUAL(frozen.GetDocumentCount(), built.GetDocumentCount());
+    for (const string &query : {"fluffy groomed cat"s, "cat -collar"s, "evgeny"s, "dog eyes -fluffy"s, "parrot"s})
+    {
+        AssertSameDocuments(opened.FindTopDocuments(query), built.FindTopDocuments(query), query);
+        AssertSameDocuments(frozen.FindTopDocuments(query), built.FindTopDocuments(query), query);
+        AssertSameDocuments(frozen.FindTopDocuments(execution::par, query), built.FindTopDocuments(query), query);
+        AssertSameDocuments(frozen.FindTopDocuments<Bm25PlusRanking>(query),
+                            built.FindTopDocuments<Bm25PlusRanking>(query), query);
+        AssertSameDocuments(frozen.FindTopDocuments(query, DocumentStatus::BANNED),
+                            built.FindTopDocuments(query, DocumentStatus::BANNED), query);
+        for (const auto &document : documents)
+        {
+            AssertEqual(get<0>(frozen.MatchDocument(query, document.id)),
+                              get<0>(built.MatchDocument(query, document.id)), query);
+            AssertEqual(get<0>(opened.MatchDocument(query, document.id)),
+                              get<0>(built.MatchDocument(query, document.id)), query);
+        }
+    }
+    ASSERT_THROWS(frozen.GetWordFrequencies(1), logic_error);
+
+    // Typo corrections and phrase positions have no frozen form.
+    SearchServer fuzzy("and in the"s);
+    fuzzy.EnableFuzzySearch(1, 0.5);
+    ASSERT_THROWS(FrozenSearchServer{fuzzy}, invalid_argument);
+    SearchServer positional("and in the"s);
+    positional.EnablePositionalIndex();
+    ASSERT_THROWS(FrozenSearchServer{positional}, invalid_argument);
+
+    {
+        ifstream input(index_path, ios::binary);
+        const string content{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+        ofstream(truncated_path, ios::binary) << content.substr(0, content.size() / 2);
+    }
+    SearchServer truncated("and in the"s);
+    ASSERT_THROWS(truncated.OpenIndex(truncated_path), invalid_argument);
+    ASSERT_EQUAL(truncated.GetDocumentCount(), 0);
+    ASSERT(truncated.FindTopDocuments("cat"s).empty());
+
+    filesystem::remove(index_path);
+    filesystem::remove(truncated_path);
+}
+
+void TestSearchStrategiesMatchSequentialSearch()
+{
+    // Enough documents for the parallel search to split them into several ranges of 4096.
+    const int document_count = 12288;
+    mt19937 generator(42);
+    SearchServer search_server(""s);
+    for (int document_id = 0; document_id < document_count; ++document_id)
+    {
+        const auto status = document_id % 10 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        search_server.AddDocument(document_id, GenerateText(generator, 3 + static_cast<int>(generator() % 8)), status,
+                                  {static_cast<int>(generator() % 11)});
+    }
+
+    const auto queries = GenerateQueries(generator);
+    set<QueryStrategy> strategies;
+    bool filters_minus_words_first = false;
+    for (const string &query : queries)
+    {
+        // Only the parallel policy may run the query on other threads.
+        const QueryPlan plan = search_server.Explain(query);
+        ASSERT(plan.strategy != QueryStrategy::PARALLEL_DENSE);
+        filters_minus_words_first = filters_minus_words_first || plan.filters_minus_words_first;
+        strategies.insert(plan.strategy);
+        strategies.insert(search_server.Explain(execution::par, query).strategy);
+    }
+    ASSERT(strategies.count(QueryStrategy::TERM_AT_A_TIME) > 0);
+    ASSERT(strategies.count(QueryStrategy::DOCUMENT_AT_A_TIME) > 0);
+    ASSERT(strategies.count(QueryStrategy::PARALLEL_DENSE) > 0);
+    ASSERT(filters_minus_words_first);
+
+    AssertAllSearchPathsMatch(search_server, queries);
+}
+
+void TestSparseIdsAndRemovalMatchSequentialSearch()
+{
+    mt19937 generator(7);
+    SearchServer search_server(""s);
+    for (int i = 0; i < 2000; ++i)
+    {
+        search_server.AddDocument(i * 1000 + static_cast<int>(generator() % 1000),
+                                  GenerateText(generator, 3 + static_cast<int>(generator() % 8)),
+                                  DocumentStatus::ACTUAL, {static_cast<int>(generator() % 11)});
+    }
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    for (size_t i = 0; i < document_ids.size(); i += 3)
+    {
+        search_server.RemoveDocument(document_ids[i]);
+    }
+
+    AssertAllSearchPathsMatch(search_server, GenerateQueries(generator));
+}
+
+void TestConjunctiveAndBooleanQueries()
+{
+    SearchServer search_server("and in"s);
+    search_server.EnableFuzzySearch(1, 0.5);
+    search_server.AddDocument(1, "white cat fancy collar"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, {3});
+    search_server.AddDocument(4, "white dog collar"s, DocumentStatus::ACTUAL, {4});
+    search_server.AddDocument(5, "cat dog"s, DocumentStatus::ACTUAL, {5});
+
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cat collar"s, QueryMode::ALL), vector<int>({1}));
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cat -fluffy"s, QueryMode::ALL), vector<int>({1, 5}));
+    ASSERT_EQUAL(FindDocumentIds(search_server, "coll* dog"s, QueryMode::ALL), vector<int>({4}));
+    // Each misspelled word has to match through one of its own corrections.
+    ASSERT_EQUAL(FindDocumentIds(search_server, "wite dgo"s, QueryMode::ALL), vector<int>({4}));
+    ASSERT(FindDocumentIds(search_server, "wite parrot"s, QueryMode::ALL).empty());
+
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cat OR dog collar"s, QueryMode::BOOLEAN), vector<int>({1, 2, 4, 5}));
+    ASSERT_EQUAL(FindDocumentIds(search_server, "(cat OR dog) collar"s, QueryMode::BOOLEAN), vector<int>({1, 4}));
+    ASSERT_EQUAL(FindDocumentIds(search_server, "NOT cat"s, QueryMode::BOOLEAN), vector<int>({3, 4}));
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cat AND NOT (fluffy OR dog)"s, QueryMode::BOOLEAN), vector<int>({1}));
+    ASSERT_EQUAL(FindDocumentIds(search_server, "coll* OR eye*"s, QueryMode::BOOLEAN), vector<int>({1, 3, 4}));
+    ASSERT_EQUAL(FindDocumentIds(search_server, "wite AND NOT dgo"s, QueryMode::BOOLEAN), vector<int>({1}));
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cat in"s, QueryMode::BOOLEAN), vector<int>({1, 2, 5}));
+
+    QueryOptions boolean_options;
+    boolean_options.mode = QueryMode::BOOLEAN;
+    ASSERT_THROWS(search_server.FindTopDocuments("\"white cat\""s, boolean_options), invalid_argument);
+    ASSERT_THROWS(search_server.FindTopDocuments("cat OR"s, boolean_options), invalid_argument);
+    ASSERT_THROWS(search_server.FindTopDocuments("(cat dog"s, boolean_options), invalid_argument);
+    ASSERT_THROWS(search_server.FindTopDocuments("cat -dog"s, boolean_options), invalid_argument);
+
+    ASSERT(search_server.Explain("cat dog"s).operator_tree.empty());
+    ASSERT_EQUAL(search_server.Explain("(cat OR dog) AND NOT fluffy"s, boolean_options).operator_tree,
+                 "AND(OR(cat[3], dog[3]), NOT(fluffy[1]))"s);
+    QueryOptions conjunctive_options;
+    conjunctive_options.mode = QueryMode::ALL;
+    ASSERT_EQUAL(search_server.Explain("cat coll* parrot -fluffy"s, conjunctive_options).operator_tree,
+                 "AND(cat[3], collar[2], NOTHING, NOT(fluffy[1]))"s);
+
+    // The rarest operand drives the intersection: collar steps twice, cat would use up
+    // the three postings of the budget.
+    for (const auto mode : {QueryMode::ALL, QueryMode::BOOLEAN})
+    {
+        QueryOptions options;
+        options.mode = mode;
+        options.max_postings = 3;
+        const auto result = search_server.FindTopDocuments("cat collar"s, options);
+        ASSERT(!result.is_partial);
+        ASSERT_EQUAL(result.documents.size(), 1u);
+        ASSERT_EQUAL(result.documents[0].id, 1);
+    }
+}
+
+void TestPaginationVisitsEveryDocumentOnce()
+{
+    // Equal texts tie on relevance, so pages follow rating and then id.
+    SearchServer search_server(""s);
+    for (int id = 0; id < 12; ++id)
+    {
+        search_server.AddDocument(id, "cat"s, DocumentStatus::ACTUAL, {id % 3});
+    }
+    const vector<int> expected_ids = {2, 5, 8, 11, 1, 4, 7, 10, 0, 3, 6, 9};
+    for (const auto &pages : {FindAllPages(search_server, execution::seq, "cat"s),
+                              FindAllPages(search_server, execution::par, "cat"s)})
+    {
+        ASSERT_EQUAL(GetPageSizes(pages), vector<size_t>({5, 5, 2}));
+        vector<int> ids;
+        for (const auto &page : pages)
+        {
+            for (const auto &document : page)
+            {
+                ids.push_back(document.id);
+            }
+        }
+        ASSERT_EQUAL(ids, expected_ids);
+    }
+
+    // A full last page still hands out a cursor, which then yields an empty end page.
+    search_server.RemoveDocument(10);
+    search_server.RemoveDocument(11);
+    ASSERT_EQUAL(GetPageSizes(FindAllPages(search_server, execution::seq, "cat"s)), vector<size_t>({5, 5, 0}));
+
+    const auto first_page = search_server.FindTopDocuments("cat"s, SearchCursor{});
+    ASSERT_THROWS(search_server.FindTopDocuments("dog"s, first_page.next), invalid_argument);
+
+    mt19937 generator(11);
+    SearchServer random_server(""s);
+    size_t matched_count = 0;
+    for (int id = 0; id < 600; ++id)
+    {
+        const string text = GenerateText(generator, 2 + static_cast<int>(generator() % 6));
+        random_server.AddDocument(id, text, DocumentStatus::ACTUAL, {static_cast<int>(generator() % 3)});
+        matched_count += get<0>(random_server.MatchDocument("w1 w2 w7"s, id)).empty() ? 0 : 1;
+    }
+    const auto pages = FindAllPages(random_server, execution::seq, "w1 w2 w7"s);
+    const auto par_pages = FindAllPages(random_server, execution::par, "w1 w2 w7"s);
+    ASSERT_EQUAL(pages.size(), par_pages.size());
+    set<int> ids;
+    const Document *previous = nullptr;
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        AssertSameDocuments(par_pages[i], pages[i], "page "s + to_string(i));
+        for (const auto &document : pages[i])
+        {
+            ASSERT(ids.insert(document.id).second);
+            ASSERT(!previous || previous->relevance + 1e-6 >= document.relevance);
+            previous = &document;
+        }
+    }
+    ASSERT_EQUAL(ids.size(), matched_count);
+}
+
+void TestTextArenaReleasesChunks()
+{
+    TextArena arena(8);
+    const string_view cat = arena.Store("cat"sv);
+    const string_view dog = arena.Store("dog"sv);
+    const string_view long_text = arena.Store("longer than a chunk"sv);
+    const string_view tail = arena.Store("tail"sv);
+    ASSERT_EQUAL(cat, "cat"sv);
+    ASSERT_EQUAL(long_text, "longer than a chunk"sv);
+    ASSERT(arena.Store(""sv).empty());
+    ASSERT_EQUAL(arena.GetLiveBytes(), 29u);
+
+    arena.Release(cat);
+    ASSERT_EQUAL(arena.GetReleasedBytes(), 3u);
+    const size_t memory_usage = arena.GetMemoryUsage();
+    // Releasing the last string of a chunk frees it together with its released bytes.
+    arena.Release(dog);
+    ASSERT_EQUAL(arena.GetReleasedBytes(), 0u);
+    ASSERT(arena.GetMemoryUsage() < memory_usage);
+    ASSERT_EQUAL(dog.size(), 3u);
+    // The chunk being filled stays allocated even when empty.
+    arena.Release(tail);
+    ASSERT_EQUAL(arena.GetReleasedBytes(), 4u);
+    ASSERT_EQUAL(arena.GetLiveBytes(), long_text.size());
+}
+
+void TestRemovalDefersCompaction()
+{
+    SearchServer search_server("and"s);
+    for (int id = 0; id < 100; ++id)
+    {
+        search_server.AddDocument(id, "cat and dog number"s + to_string(id), DocumentStatus::ACTUAL, {id});
+    }
+    const auto word_frequencies = search_server.GetWordFrequenciesMap(99);
+    for (int id = 0; id < 90; ++id)
+    {
+        search_server.RemoveDocument(id);
+    }
+    ASSERT(search_server.IsDocumentStorageFragmented());
+    const auto expected = search_server.FindTopDocuments("cat number95"s);
+
+    search_server.CompactDocumentStorage();
+    ASSERT(!search_server.IsDocumentStorageFragmented());
+    AssertSameDocuments(search_server.FindTopDocuments("cat number95"s), expected, "after compaction"s);
+    ASSERT_EQUAL(search_server.GetWordFrequenciesMap(99), word_frequencies);
+    search_server.AddDocument(100, "cat number100"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(search_server.FindTopDocuments("number100"s).size(), 1u);
+}
+
+void TestFindDuplicates()
+{
+    for (const bool has_index : {false, true})
+    {
+        SearchServer search_server("and"s);
+        if (has_index)
+        {
+            search_server.EnableDuplicateDetection(16, 2);
+        }
+        search_server.AddDocument(4, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7});
+        search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1});
+        // Word order, repeats and stop words do not matter.
+        search_server.AddDocument(3, "rat nasty pet funny funny"s, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(7, "curly hair with funny pet"s, DocumentStatus::BANNED, {9});
+        search_server.AddDocument(9, "nasty rat"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_EQUAL(search_server.FindDuplicates(), vector<int>({4, 7}));
+        ASSERT_EQUAL(search_server.FindDuplicates(1.0), vector<int>({4, 7}));
+    }
+
+    SearchServer search_server(""s);
+    ASSERT_THROWS(search_server.FindDuplicates(0.5), invalid_argument);
+    search_server.EnableDuplicateDetection(20, 2);
+    ASSERT_THROWS(search_server.FindDuplicates(0.0), invalid_argument);
+    const string text = "a0 a1 a2 a3 a4 a5 a6 a7 a8 a9 a10 a11 a12 a13 a14 a15 a16 a17 a18 "s;
+    search_server.AddDocument(1, text + "a19"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, text + "b19"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(3, "c0 c1 c2 c3 c4 c5 c6 c7 c8 c9"s, DocumentStatus::ACTUAL, {1});
+    // 19 shared terms out of 21 in total
+    ASSERT_EQUAL(search_server.FindDuplicates(0.9), vector<int>({2}));
+    ASSERT(search_server.FindDuplicates(0.95).empty());
+    ASSERT(search_server.FindDuplicates().empty());
+
+    // A bucket far above the fan-out still joins all of its copies into one group.
+    for (int id = 10; id < 300; ++id)
+    {
+        search_server.AddDocument(id, "c0 c1 c2 c3 c4 c5 c6 c7 c8 c9"s, DocumentStatus::ACTUAL, {1});
+    }
+    const auto duplicates = search_server.FindDuplicates(0.9);
+    ASSERT_EQUAL(duplicates.size(), 291u);
+    ASSERT_EQUAL(duplicates.front(), 2);
+    ASSERT_EQUAL(duplicates[1], 10);
+}
+
+void TestIngestDocuments()
+{
+    string records;
+    SearchServer expected("and"s);
+    for (int id = 0; id < 300; ++id)
+    {
+        const string text = "word"s + to_string(id % 17) + " and text number"s + to_string(id);
+        const bool is_banned = id % 3 == 0;
+        records += to_string(id) + (is_banned ? "\tBANNED\t"s : "\tACTUAL\t"s) + to_string(id % 5) + " 2\t"s + text + "\n"s;
+        expected.AddDocument(id, text, is_banned ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 5, 2});
+    }
+    IngestOptions options;
+    options.chunk_size = 256;
+    options.queue_capacity = 2;
+    const string records_path = (filesystem::temp_directory_path() / "search_server_test_records.tsv"s).string();
+    ofstream(records_path, ios::binary) << records;
+
+    for (const bool is_file : {false, true})
+    {
+        SearchServer search_server("and"s);
+        istringstream input(records);
+        const auto stats = is_file ? IngestDocumentsFromFile(search_server, records_path, options)
+                                   : IngestDocuments(search_server, input, options);
+        ASSERT_EQUAL(stats.document_count, 300u);
+        ASSERT_EQUAL(stats.byte_count, records.size());
+        for (const string &query : {"word3"s, "number42 word5"s, "text -word1"s})
+        {
+            AssertSameDocuments(search_server.FindTopDocuments(query), expected.FindTopDocuments(query), query);
+            AssertSameDocuments(search_server.FindTopDocuments(query, DocumentStatus::BANNED),
+                                expected.FindTopDocuments(query, DocumentStatus::BANNED), query);
+        }
+    }
+    filesystem::remove(records_path);
+
+    // Chunks indexed before a bad record stay in the server and are reported as committed.
+    SearchServer search_server("and"s);
+    istringstream input(records + "300\tUNKNOWN\t1\tbad status\n"s);
+    bool is_reported = false;
+    try
+    {
+        IngestDocuments(search_server, input, options);
+    }
+    catch (const IngestError &error)
+    {
+        is_reported = true;
+        ASSERT_EQUAL(error.GetCommittedStats().document_count, static_cast<size_t>(search_server.GetDocumentCount()));
+        ASSERT(search_server.GetDocumentCount() > 0 && search_server.GetDocumentCount() < 300);
+        ASSERT_THROWS(rethrow_if_nested(error), invalid_argument);
+    }
+    ASSERT(is_reported);
+
+    // Without line breaks the reader gives up at the record length limit.
+    options.max_line_length = 1000;
+    istringstream endless_input("1\tACTUAL\t1\t"s + string(5000, 'a'));
+    ASSERT_THROWS(IngestDocuments(search_server, endless_input, options), IngestError);
+}
+
+void TestSegmentedIndexMatchesSearchServer()
+{
+    mt19937 generator(37);
+    SearchServer expected("and"s);
+    SegmentedSearchServer segmented("and"s, SegmentedIndexOptions{64, 2, 0.3});
+    ASSERT_THROWS(segmented.FindTopDocuments("\"w1 w2\""s), invalid_argument);
+
+    // Prefixes are kept short of max_prefix_expansions_ words, which a single server counts
+    // over every word it has seen and segments only over the words of their live documents.
+    vector<string> queries;
+    for (int i = 0; i < 40; ++i)
+    {
+        string query = "w"s + to_string(generator() % 5) + " w"s + to_string(generator() % 5000);
+        if (i % 2 == 0)
+        {
+            query += " w"s + to_string(100 + generator() % 400) + "*"s;
+        }
+        if (i % 3 == 0)
+        {
+            query += " -w"s + to_string(100 + generator() % 400) + "*"s;
+        }
+        if (i % 4 == 0)
+        {
+            query += " -w"s + to_string(generator() % 5);
+        }
+        queries.push_back(query);
+    }
+    const auto assert_same_results = [&](const string &hint)
+    {
+        ASSERT_EQUAL(segmented.GetDocumentCount(), expected.GetDocumentCount());
+        for (const string &query : queries)
+        {
+            AssertSameDocuments(segmented.FindTopDocuments(query), expected.FindTopDocuments(query), hint + query);
+            AssertSameDocuments(segmented.FindTopDocuments<Bm25Ranking>(query, DocumentStatus::BANNED),
+                                expected.FindTopDocuments<Bm25Ranking>(query, DocumentStatus::BANNED), hint + query);
+        }
+    };
+
+    for (int id = 0; id < 600; ++id)
+    {
+        const string text = GenerateText(generator, 5 + static_cast<int>(generator() % 20));
+        const DocumentStatus status = id % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        expected.AddDocument(id, text, status, {id % 10});
+        segmented.AddDocument(id, text, status, {id % 10});
+        // Removes documents from the mutable segment as well as from sealed ones
+        if (id % 5 == 0)
+        {
+            const int removed_id = static_cast<int>(generator() % (id + 1));
+            expected.RemoveDocument(removed_id);
+            segmented.RemoveDocument(removed_id);
+        }
+    }
+    assert_same_results("with a mutable segment: "s);
+    segmented.Flush();
+    segmented.WaitForMerges();
+    assert_same_results("after merges: "s);
+    ASSERT(segmented.GetMemoryUsage() > 0);
+}
+
+void TestSegmentedIndexKeepsTombstonesAcrossMerges()
+{
+    SegmentedSearchServer segmented(""s, SegmentedIndexOptions{16, 2, 0.9});
+    for (int id = 0; id < 256; ++id)
+    {
+        segmented.AddDocument(id, "common unique"s + to_string(id), DocumentStatus::ACTUAL, {1});
+        // Sealing starts merges in the background, which must not bring removed documents back
+        if (id % 16 == 15)
+        {
+            for (int removed_id = id - 15; removed_id <= id; removed_id += 3)
+            {
+                segmented.RemoveDocument(removed_id);
+            }
+        }
+    }
+    segmented.WaitForMerges();
+
+    int live_count = 0;
+    for (int id = 0; id < 256; ++id)
+    {
+        const bool is_removed = id % 16 % 3 == 0;
+        ASSERT_EQUAL(segmented.FindTopDocuments("unique"s + to_string(id)).size(), is_removed ? 0u : 1u);
+        live_count += is_removed ? 0 : 1;
+    }
+    ASSERT_EQUAL(segmented.GetDocumentCount(), live_count);
+    const size_t memory_usage = segmented.GetMemoryUsage();
+    segmented.AddDocument(1000, "common"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(segmented.GetMemoryUsage() > memory_usage);
+}
+
+void TestMemoryBudgetRejectsDocuments()
+{
+    SearchServer search_server("and"s);
+    search_server.AddDocument(0, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {1});
+    search_server.SetMemoryBudget(search_server.GetMemoryUsage().GetTotal() + 20000);
+
+    // Documents of new words are added until the next one would not fit.
+    int document_id = 1;
+    const auto make_text = [](int id)
+    {
+        return "word"s + to_string(id) + " term"s + to_string(id) + " text"s + to_string(id);
+    };
+    while (search_server.FitsMemoryBudget(make_text(document_id)))
+    {
+        search_server.AddDocument(document_id, make_text(document_id), DocumentStatus::ACTUAL, {1});
+        ++document_id;
+    }
+    const int document_count = search_server.GetDocumentCount();
+    ASSERT(document_count > 10);
+    ASSERT_THROWS(search_server.AddDocument(document_id, make_text(document_id), DocumentStatus::ACTUAL, {1}),
+                  runtime_error);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), document_count);
+    ASSERT(search_server.FindTopDocuments(make_text(document_id)).empty());
+
+    // A batch that does not fit is rejected as a whole.
+    vector<string> texts;
+    for (int id = document_id; id < document_id + 50; ++id)
+    {
+        texts.push_back(make_text(id));
+    }
+    vector<NewDocument> batch;
+    for (size_t i = 0; i < texts.size(); ++i)
+    {
+        batch.push_back({document_id + static_cast<int>(i), texts[i], DocumentStatus::ACTUAL, {1}});
+    }
+    ASSERT_THROWS(search_server.AddDocuments(execution::seq, batch), runtime_error);
+    ASSERT_THROWS(search_server.AddDocuments(execution::par, batch), runtime_error);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), document_count);
+
+    // Removed documents give their room back.
+    for (int id = 1; id <= 10; ++id)
+    {
+        search_server.RemoveDocument(id);
+    }
+    search_server.AddDocument(document_id, "funny pet"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(search_server.GetDocumentCount(), document_count - 9);
+}
+
+void TestScoringKernelsMatchScalar()
+{
+    mt19937 generator(48);
+    const SimdLevel supported_level = GetSupportedSimdLevel();
+    for (const SimdLevel level : {SimdLevel::SCALAR, SimdLevel::AVX2, SimdLevel::AVX512})
+    {
+        if (static_cast<int>(level) > static_cast<int>(supported_level))
+        {
+            continue;
+        }
+        SetSimdLevel(level);
+        const string hint = string(GetSimdLevelName(level));
+        // Counts cover every tail of 4 and 8 lanes.
+        for (size_t count = 0; count <= 40; ++count)
+        {
+            vector<uint32_t> slots(64);
+            iota(slots.begin(), slots.end(), 0);
+            shuffle(slots.begin(), slots.end(), generator);
+            slots.resize(count);
+            vector<double> term_freqs(count);
+            for (double &term_freq : term_freqs)
+            {
+                term_freq = generator() % 1000 / 7.0;
+            }
+            vector<double> accumulators(64);
+            for (double &accumulator : accumulators)
+            {
+                accumulator = generator() % 1000 / 3.0;
+            }
+            vector<double> expected = accumulators;
+            for (size_t i = 0; i < count; ++i)
+            {
+                expected[slots[i]] += term_freqs[i] * 0.37;
+            }
+            ScoreTermBlock(slots.data(), term_freqs.data(), count, 0.37, accumulators.data());
+            Assert(accumulators == expected, hint);
+
+            for (size_t first = 0; first <= count; ++first)
+            {
+                const double threshold = 200.0;
+                size_t expected_position = first;
+                while (expected_position < count && !(accumulators[expected_position] >= threshold))
+                {
+                    ++expected_position;
+                }
+                AssertEqual(FindNextAtLeast(accumulators.data(), first, count, threshold), expected_position, hint);
+            }
+        }
+    }
+    SetSimdLevel(supported_level);
+}
+
+void TestCopiedServerIsIndependent()
+{
+    SearchServer search_server("and"s);
+    search_server.EnableFuzzySearch(1, 1.0);
+    search_server.EnableAsyncQueries(1);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7});
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1});
+
+    SearchServer copy = search_server;
+    search_server.RemoveDocument(1);
+    search_server.AddDocument(3, "curly rat"s, DocumentStatus::ACTUAL, {2});
+    search_server.CompactDocumentStorage();
+
+    ASSERT_EQUAL(FindDocumentIds(copy, "rat pet"s, QueryMode::ANY), vector<int>({1, 2}));
+    ASSERT_EQUAL(FindDocumentIds(copy, "curl*"s, QueryMode::ANY), vector<int>({2}));
+    ASSERT_EQUAL(FindDocumentIds(copy, "nsty"s, QueryMode::ANY), vector<int>({1}));
+    ASSERT_EQUAL(get<0>(copy.MatchDocument("nasty rat"s, 1)), vector<string_view>({"nasty"sv, "rat"sv}));
+    ASSERT_EQUAL(FindDocumentIds(search_server, "rat pet"s, QueryMode::ANY), vector<int>({2, 3}));
+}
+
+void TestQueryCancellation()
+{
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7});
+    CancellationSource source;
+    QueryOptions options;
+    options.cancellation = source.GetToken();
+    ASSERT_EQUAL(search_server.FindTopDocuments("rat"s, options).documents.size(), 1u);
+    source.Cancel();
+    ASSERT_THROWS(search_server.FindTopDocuments("rat"s, options), QueryCancelled);
+}
+
+void TestPrefixQueries()
+{
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat catalog"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "caterpillar"s, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, "dog catapult"s, DocumentStatus::ACTUAL, {3});
+    search_server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, {4});
+
+    // A prefix scores like one word whose postings sum the term frequencies of its words.
+    const auto documents = search_server.FindTopDocuments("cat*"s);
+    ASSERT_EQUAL(documents.size(), 3u);
+    const double inverse_document_freq = log(4.0 / 3.0);
+    for (const auto &document : documents)
+    {
+        ASSERT(abs(document.relevance - (document.id == 3 ? 0.5 : 1.0) * inverse_document_freq) < 1e-6);
+    }
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cata* caterpillar"s, QueryMode::ANY), vector<int>({1, 2, 3}));
+    ASSERT_EQUAL(search_server.CountDocuments("cat*"s), 3u);
+    ASSERT_EQUAL(search_server.CountDocuments(execution::par, "cat* -dog"s), 2u);
+
+    ASSERT_EQUAL(FindDocumentIds(search_server, "dog -cata*"s, QueryMode::ANY), vector<int>({4}));
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cat* -caterp*"s, QueryMode::ANY), vector<int>({1, 3}));
+    ASSERT(FindDocumentIds(search_server, "parrot*"s, QueryMode::ANY).empty());
+
+    search_server.BuildImpactIndex(ImpactPrecision::BITS_16);
+    for (const string &query : {"cat* dog"s, "catap* cat"s, "dog -cat*"s})
+    {
+        AssertSearchPathsMatch<TfIdfRanking>(search_server, query);
+        AssertSearchPathsMatch<Bm25Ranking>(search_server, query);
+    }
+
+    // Expansion keeps the first words in dictionary order: cat and catalog.
+    search_server.SetMaxPrefixExpansions(2);
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cat*"s, QueryMode::ANY), vector<int>({1}));
+    ASSERT_EQUAL(search_server.CountDocuments("cat*"s), 1u);
+}
+
+void TestFuzzyCorrections()
+{
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat collar"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "cart"s, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, "dog"s, DocumentStatus::ACTUAL, {3});
+    search_server.AddDocument(4, "parrot"s, DocumentStatus::ACTUAL, {4});
+    ASSERT_THROWS(search_server.EnableFuzzySearch(3, 0.5), invalid_argument);
+    ASSERT_THROWS(search_server.EnableFuzzySearch(1, 0.0), invalid_argument);
+    ASSERT(search_server.FindTopDocuments("cst"s).empty());
+
+    // Only the closest words correct a query word, each weighted by the penalty per edit.
+    search_server.EnableFuzzySearch(2, 0.5);
+    const double inverse_document_freq = log(4.0);
+    auto documents = search_server.FindTopDocuments("cst"s);
+    ASSERT_EQUAL(documents.size(), 1u);
+    ASSERT_EQUAL(documents[0].id, 1);
+    ASSERT(abs(documents[0].relevance - 0.5 * 0.5 * inverse_document_freq) < 1e-6);
+    documents = search_server.FindTopDocuments("dxgx"s);
+    ASSERT_EQUAL(documents.size(), 1u);
+    ASSERT_EQUAL(documents[0].id, 3);
+    ASSERT(abs(documents[0].relevance - 0.25 * inverse_document_freq) < 1e-6);
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cst dxgx"s, QueryMode::ANY), vector<int>({1, 3}));
+    ASSERT(search_server.FindTopDocuments("elephant"s).empty());
+
+    // A word with postings is never corrected, even with close words in the index.
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cart"s, QueryMode::ANY), vector<int>({2}));
+    search_server.RemoveDocument(2);
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cart"s, QueryMode::ANY), vector<int>({1}));
+
+    search_server.EnableFuzzySearch(1, 0.5);
+    ASSERT(search_server.FindTopDocuments("dxgx"s).empty());
+    ASSERT_EQUAL(FindDocumentIds(search_server, "cst"s, QueryMode::ANY), vector<int>({1}));
+    for (const string &query : {"cst dog"s, "cst -dog"s, "dgo collar"s})
+    {
+        AssertSearchPathsMatch<TfIdfRanking>(search_server, query);
+        AssertSearchPathsMatch<Bm25Ranking>(search_server, query);
+    }
+}
+
+void TestMatchDocuments()
+{
+    SearchServer search_server("and in"s);
+    search_server.EnableFuzzySearch(1, 0.5);
+    search_server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::BANNED, {2});
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::IRRELEVANT, {3});
+
+    using Match = tuple<vector<string_view>, DocumentStatus>;
+    ASSERT(search_server.MatchDocument("white collar cat"s, 1) ==
+           Match({"cat"sv, "collar"sv, "white"sv}, DocumentStatus::ACTUAL));
+    ASSERT(search_server.MatchDocument("fluffy parrot"s, 2) == Match({"fluffy"sv}, DocumentStatus::BANNED));
+    ASSERT(search_server.MatchDocument("cat -tail"s, 2) == Match(vector<string_view>{}, DocumentStatus::BANNED));
+    ASSERT(search_server.MatchDocument("cat in and"s, 3) == Match(vector<string_view>{}, DocumentStatus::IRRELEVANT));
+    ASSERT(search_server.MatchDocument("fanc* dgo"s, 1) == Match({"fancy"sv}, DocumentStatus::ACTUAL));
+    ASSERT(search_server.MatchDocument("fanc* dgo"s, 3) == Match({"dog"sv}, DocumentStatus::IRRELEVANT));
+    ASSERT_THROWS(search_server.MatchDocument("cat"s, 4), invalid_argument);
+    ASSERT_THROWS(search_server.MatchDocument("cat"s, -1), invalid_argument);
+    ASSERT_THROWS(search_server.MatchDocument("cat --dog"s, 1), invalid_argument);
+    ASSERT_THROWS(search_server.MatchDocuments(execution::par, "cat"s, {1, 4}), invalid_argument);
+
+    // Both batch versions agree with matching one document at a time, in the given order.
+    mt19937 generator(27);
+    SearchServer random_server("w0"s);
+    vector<int> document_ids;
+    for (int id = 0; id < 500; ++id)
+    {
+        random_server.AddDocument(id * 3, GenerateText(generator, 10), DocumentStatus::ACTUAL, {id % 10});
+        document_ids.push_back(id * 3);
+    }
+    shuffle(document_ids.begin(), document_ids.end(), generator);
+    for (const string &query : GenerateQueries(generator))
+    {
+        vector<Match> expected;
+        for (const int document_id : document_ids)
+        {
+            expected.push_back(random_server.MatchDocument(query, document_id));
+        }
+        Assert(random_server.MatchDocuments(query, document_ids) == expected, query);
+        Assert(random_server.MatchDocuments(execution::par, query, document_ids) == expected, query);
+    }
+}
+
+void TestCountAndFacet()
+{
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "fluffy cat"s, DocumentStatus::BANNED, {5});
+    search_server.AddDocument(3, "groomed dog"s, DocumentStatus::ACTUAL, {9});
+    search_server.AddDocument(4, "white dog"s, DocumentStatus::ACTUAL, {5});
+    ASSERT_EQUAL(search_server.CountDocuments("cat dog -fluffy"s), 3u);
+    ASSERT_EQUAL(search_server.CountDocuments("parrot"s), 0u);
+    ASSERT_EQUAL(search_server.CountDocuments("cat dog"s, DocumentFilter{{DocumentStatus::ACTUAL}, 5, 9}), 2u);
+    const auto facet = search_server.Facet("white cat dog"s, FacetDimensions{true, {5}});
+    ASSERT_EQUAL(facet.GetDocumentCount(), 4u);
+    ASSERT_EQUAL(facet.GetStatusCount(DocumentStatus::ACTUAL), 3u);
+    ASSERT_EQUAL(facet.GetStatusCount(DocumentStatus::BANNED), 1u);
+    ASSERT_EQUAL(facet.GetRatingBucketCount(0), 1u);
+    ASSERT_EQUAL(facet.GetRatingBucketCount(1), 3u);
+    ASSERT_THROWS(search_server.Facet("cat"s, FacetDimensions{false, {5, 1}}), invalid_argument);
+
+    // Enough documents for many 64-document chunks, with sparse ids and removed documents,
+    // checked against matching every document on its own. Without a filter and dimensions
+    // the count is a popcount of the matched bitmap.
+    mt19937 generator(47);
+    SearchServer random_server("w0"s);
+    map<int, pair<DocumentStatus, int>> attributes;
+    for (int id = 0; id < 3000; ++id)
+    {
+        const auto status = static_cast<DocumentStatus>(generator() % 4);
+        const int rating = static_cast<int>(generator() % 10);
+        random_server.AddDocument(id * 2 + 1, GenerateText(generator, 8), status, {rating});
+        attributes[id * 2 + 1] = {status, rating};
+    }
+    for (int id = 1; id < 6000; id += 14)
+    {
+        random_server.RemoveDocument(id);
+        attributes.erase(id);
+    }
+    const vector<int> document_ids(random_server.begin(), random_server.end());
+
+    const DocumentFilter filter{{DocumentStatus::ACTUAL, DocumentStatus::BANNED}, 2, 6};
+    const FacetDimensions dimensions{true, {3, 7}};
+    for (const string &query : GenerateQueries(generator))
+    {
+        const auto matches = random_server.MatchDocuments(query, document_ids);
+        size_t expected_count = 0;
+        size_t expected_filtered_count = 0;
+        FacetResult expected_facet(dimensions);
+        for (size_t i = 0; i < document_ids.size(); ++i)
+        {
+            if (get<0>(matches[i]).empty())
+            {
+                continue;
+            }
+            const auto [status, rating] = attributes.at(document_ids[i]);
+            ++expected_count;
+            if (filter(document_ids[i], status, rating))
+            {
+                ++expected_filtered_count;
+                expected_facet.Add(status, rating);
+            }
+        }
+
+        AssertEqual(random_server.CountDocuments(query), expected_count, query);
+        AssertEqual(random_server.CountDocuments(execution::par, query), expected_count, query);
+        AssertEqual(random_server.CountDocuments(query, filter), expected_filtered_count, query);
+        AssertEqual(random_server.CountDocuments(execution::par, query, filter), expected_filtered_count, query);
+        AssertEqual(random_server.Facet(query, dimensions, filter).counts, expected_facet.counts, query);
+        AssertEqual(random_server.Facet(execution::par, query, dimensions, filter).counts, expected_facet.counts, query);
+    }
+}
+
+void TestFilterMatchesPredicate()
+{
+    // Statuses change every 300 ids and ratings grow with the id, so blocks of the attribute
+    // columns can be skipped by either, and a narrow rating range holds few enough documents
+    // to be read from the rating index.
+    mt19937 generator(45);
+    SearchServer search_server("w0"s);
+    for (int id = 0; id < 4000; ++id)
+    {
+        search_server.AddDocument(id, GenerateText(generator, 8), static_cast<DocumentStatus>(id / 300 % 4), {id / 10});
+    }
+    for (int id = 0; id < 4000; id += 9)
+    {
+        search_server.RemoveDocument(id);
+    }
+
+    const vector<DocumentFilter> filters = {
+        {{DocumentStatus::ACTUAL}},
+        {{}, 100, 101},
+        {{DocumentStatus::BANNED}, 100, 101},
+        {{DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT}, 50, 250},
+        {{}, numeric_limits<int>::min(), numeric_limits<int>::max(), 1000, 2000},
+        {{DocumentStatus::REMOVED}, 0, 50},
+    };
+    for (const auto &filter : filters)
+    {
+        const auto predicate = [&filter](int document_id, DocumentStatus status, int rating)
+        {
+            return document_id >= filter.min_document_id && document_id <= filter.max_document_id &&
+                   rating >= filter.min_rating && rating <= filter.max_rating &&
+                   (filter.statuses.empty() ||
+                    find(filter.statuses.begin(), filter.statuses.end(), status) != filter.statuses.end());
+        };
+        for (const string &query : GenerateQueries(generator))
+        {
+            const auto expected = search_server.FindTopDocuments(execution::seq, query, predicate);
+            AssertSameDocuments(search_server.FindTopDocuments(execution::seq, query, filter), expected, query);
+            AssertSameDocuments(search_server.FindTopDocuments(execution::par, query, filter), expected, query);
+            const auto expected_bm25 = search_server.FindTopDocuments<Bm25Ranking>(execution::seq, query, predicate);
+            AssertSameDocuments(search_server.FindTopDocuments<Bm25Ranking>(execution::seq, query, filter),
+                                expected_bm25, query);
+        }
+    }
+}
+
+void TestAddDocumentsMatchesAddDocument()
+{
+    mt19937 generator(35);
+    vector<string> texts;
+    vector<NewDocument> batch;
+    for (int id = 0; id < 2000; ++id)
+    {
+        texts.push_back(GenerateText(generator, 1 + static_cast<int>(generator() % 12)));
+    }
+    for (int id = 0; id < 2000; ++id)
+    {
+        batch.push_back({id * 5 + 2, texts[id], static_cast<DocumentStatus>(id % 4), {id % 7, -id % 3}});
+    }
+
+    SearchServer expected("w1 w2"s);
+    expected.EnablePositionalIndex();
+    for (const auto &document : batch)
+    {
+        expected.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+
+    SearchServer sequential("w1 w2"s);
+    sequential.EnablePositionalIndex();
+    sequential.AddDocuments(execution::seq, batch);
+    SearchServer parallel("w1 w2"s);
+    parallel.EnablePositionalIndex();
+    parallel.AddDocuments(execution::par, vector<NewDocument>(batch.begin(), batch.begin() + 700));
+    parallel.AddDocuments(execution::par, vector<NewDocument>(batch.begin() + 700, batch.end()));
+    SearchServer tokenized("w1 w2"s);
+    tokenized.EnablePositionalIndex();
+    tokenized.AddDocuments(execution::par, batch, tokenized.TokenizeDocuments(execution::par, batch));
+
+    auto queries = GenerateQueries(generator);
+    queries.push_back("\"w3 w4\" w7"s);
+    for (const SearchServer *server : {&sequential, &parallel, &tokenized})
+    {
+        ASSERT_EQUAL(server->GetDocumentCount(), expected.GetDocumentCount());
+        ASSERT(vector<int>(server->begin(), server->end()) == vector<int>(expected.begin(), expected.end()));
+        for (const int document_id : expected)
+        {
+            ASSERT(server->GetWordFrequenciesMap(document_id) == expected.GetWordFrequenciesMap(document_id));
+        }
+        for (const string &query : queries)
+        {
+            AssertSameDocuments(server->FindTopDocuments(query, DocumentStatus::BANNED),
+                                expected.FindTopDocuments(query, DocumentStatus::BANNED), query);
+            AssertSameDocuments(server->FindTopDocuments<Bm25Ranking>(query), expected.FindTopDocuments<Bm25Ranking>(query),
+                                query);
+        }
+    }
+
+    // A batch with a duplicate or existing id, or an invalid word, is rejected before any of
+    // it is indexed.
+    const string valid_text = "w1 w3 w5"s;
+    const string invalid_text = "w1 w\x01"s;
+    const auto make_document = [](int document_id, const string &text)
+    {
+        return NewDocument{document_id, text, DocumentStatus::ACTUAL, {1}};
+    };
+    const vector<vector<NewDocument>> invalid_batches = {
+        {make_document(10001, valid_text), make_document(10002, valid_text),
+         make_document(10001, valid_text)},
+        {make_document(10001, valid_text), make_document(2, valid_text)},
+        {make_document(10001, valid_text), make_document(-1, valid_text)},
+        {make_document(10001, valid_text), make_document(10002, invalid_text)},
+    };
+    for (const auto &invalid_batch : invalid_batches)
+    {
+        ASSERT_THROWS(parallel.AddDocuments(execution::par, invalid_batch), invalid_argument);
+        ASSERT_THROWS(sequential.AddDocuments(execution::seq, invalid_batch), invalid_argument);
+        for (const SearchServer *server : {&sequential, &parallel})
+        {
+            ASSERT_EQUAL(server->GetDocumentCount(), expected.GetDocumentCount());
+            AssertSameDocuments(server->FindTopDocuments("w3 w5"s), expected.FindTopDocuments("w3 w5"s), "w3 w5"s);
+        }
+    }
+    parallel.AddDocuments(execution::par, {make_document(10001, valid_text), make_document(10002, valid_text)});
+    ASSERT_EQUAL(parallel.GetDocumentCount(), expected.GetDocumentCount() + 2);
+}
+
+#ifdef __cpp_impl_coroutine
+namespace
+{
+    struct DetachedTask
+    {
+        struct promise_type
+        {
+            DetachedTask get_return_object()
+            {
+                return {};
+            }
+            suspend_never initial_suspend() noexcept
+            {
+                return {};
+            }
+            suspend_never final_suspend() noexcept
+            {
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception()
+            {
+                terminate();
+            }
+        };
+    };
+
+    DetachedTask FindAsync(const SearchServer &search_server, string query, QueryOptions options,
+                           promise<vector<int>> &result)
+    {
+        try
+        {
+            const auto page = co_await search_server.FindTopDocumentsAsync(query, options);
+            vector<int> document_ids;
+            for (const auto &document : page.documents)
+            {
+                document_ids.push_back(document.id);
+            }
+            sort(document_ids.begin(), document_ids.end());
+            result.set_value(document_ids);
+        }
+        catch (...)
+        {
+            result.set_exception(current_exception());
+        }
+    }
+}
+
+void TestAsyncQueries()
+{
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7});
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1});
+    CancellationSource source;
+    QueryOptions cancelled;
+    cancelled.cancellation = source.GetToken();
+    source.Cancel();
+
+    // Without an executor the query completes before co_await suspends
+    for (const bool is_async : {false, true})
+    {
+        if (is_async)
+        {
+            search_server.EnableAsyncQueries(2);
+        }
+        promise<vector<int>> found;
+        promise<vector<int>> cancelled_found;
+        auto found_ids = found.get_future();
+        auto cancelled_ids = cancelled_found.get_future();
+        FindAsync(search_server, "rat pet"s, {}, found);
+        FindAsync(search_server, "rat pet"s, cancelled, cancelled_found);
+        if (!is_async)
+        {
+            ASSERT(found_ids.wait_for(0s) == future_status::ready);
+        }
+        ASSERT_EQUAL(found_ids.get(), vector<int>({1, 2}));
+        ASSERT_THROWS(cancelled_ids.get(), QueryCancelled);
+    }
+}
+#endif
+
+void TestSearchServer()
+{
+    TestRunner tr;
+    RUN_TEST(tr, TestPhraseQueriesRequirePositionalIndex);
+    RUN_TEST(tr, TestOpenIndexMatchesBuiltIndex);
+    RUN_TEST(tr, TestSearchStrategiesMatchSequentialSearch);
+    RUN_TEST(tr, TestSparseIdsAndRemovalMatchSequentialSearch);
+    RUN_TEST(tr, TestConjunctiveAndBooleanQueries);
+    RUN_TEST(tr, TestPaginationVisitsEveryDocumentOnce);
+    RUN_TEST(tr, TestTextArenaReleasesChunks);
+    RUN_TEST(tr, TestRemovalDefersCompaction);
+    RUN_TEST(tr, TestFindDuplicates);
+    RUN_TEST(tr, TestIngestDocuments);
+    RUN_TEST(tr, TestSegmentedIndexMatchesSearchServer);
+    RUN_TEST(tr, TestSegmentedIndexKeepsTombstonesAcrossMerges);
+    RUN_TEST(tr, TestMemoryBudgetRejectsDocuments);
+    RUN_TEST(tr, TestScoringKernelsMatchScalar);
+    RUN_TEST(tr, TestCopiedServerIsIndependent);
+    RUN_TEST(tr, TestQueryCancellation);
+    RUN_TEST(tr, TestPrefixQueries);
+    RUN_TEST(tr, TestFuzzyCorrections);
+    RUN_TEST(tr, TestMatchDocuments);
+    RUN_TEST(tr, TestCountAndFacet);
+    RUN_TEST(tr, TestFilterMatchesPredicate);
+    RUN_TEST(tr, TestAddDocumentsMatchesAddDocument);
+#ifdef __cpp_impl_coroutine
+    RUN_TEST(tr, TestAsyncQueries);
+#endif
+}
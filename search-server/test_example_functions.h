@@ -0,0 +1,29 @@
+#pragma once
+
+void TestPhraseQueriesRequirePositionalIndex();
+void TestOpenIndexMatchesBuiltIndex();
+void TestSearchStrategiesMatchSequentialSearch();
+void TestSparseIdsAndRemovalMatchSequentialSearch();
+void TestConjunctiveAndBooleanQueries();
+void TestPaginationVisitsEveryDocumentOnce();
+void TestTextArenaReleasesChunks();
+void TestRemovalDefersCompaction();
+void TestFindDuplicates();
+void TestIngestDocuments();
+void TestSegmentedIndexMatchesSearchServer();
+void TestSegmentedIndexKeepsTombstonesAcrossMerges();
+void TestMemoryBudgetRejectsDocuments();
+void TestScoringKernelsMatchScalar();
+void TestCopiedServerIsIndependent();
+void TestQueryCancellation();
+void TestPrefixQueries();
+void TestFuzzyCorrections();
+void TestMatchDocuments();
+void TestCountAndFacet();
+void TestFilterMatchesPredicate();
+void TestAddDocumentsMatchesAddDocument();
+#ifdef __cpp_impl_coroutine
+void TestAsyncQueries();
+#endif
+
+void TestSearchServer();
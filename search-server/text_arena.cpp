@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cstring>
+
+#include "text_arena.h"
+
+TextArena::TextArena(size_t chunk_size) : chunk_size_(chunk_size) {}
+
+std::string_view TextArena::Store(std::string_view text)
+{
+    if (text.empty())
+    {
+        return {};
+    }
+
+    if (chunks_.empty() || chunks_.back().capacity - chunks_.back().used < text.size())
+    {
+        Chunk chunk;
+        chunk.capacity = std::max(chunk_size_, text.size());
+        chunk.data = std::make_unique<char[]>(chunk.capacity);
+        chunk_by_address_[chunk.data.get()] = chunks_.size();
+        chunks_.push_back(std::move(chunk));
+    }
+
+    Chunk &chunk = chunks_.back();
+    char *position = chunk.data.get() + chunk.used;
+    std::memcpy(position, text.data(), text.size());
+    chunk.used += text.size();
+    chunk.live += text.size();
+    live_bytes_ += text.size();
+    return {position, text.size()};
+}
+
+void TextArena::Release(std::string_view text)
+{
+    if (text.empty())
+    {
+        return;
+    }
+
+    auto owner = chunk_by_address_.upper_bound(text.data());
+    --owner;
+    const size_t chunk_index = owner->second;
+    Chunk &chunk = chunks_[chunk_index];
+    chunk.live -= text.size();
+    live_bytes_ -= text.size();
+    released_bytes_ += text.size();
+
+    if (chunk.live == 0 && chunk_index + 1 != chunks_.size())
+    {
+        released_bytes_ -= chunk.used;
+        chunk_by_address_.erase(owner);
+        chunk.data.reset();
+        chunk.capacity = 0;
+        chunk.used = 0;
+    }
+}
+
+size_t TextArena::GetLiveBytes() const
+{
+    return live_bytes_;
+}
+
+size_t TextArena::GetReleasedBytes() const
+{
+    return released_bytes_;
+}
+
+size_t TextArena::GetMemoryUsage() const
+{
+    size_t bytes = chunks_.capacity() * sizeof(Chunk) +
+                   chunk_by_address_.size() * (sizeof(std::pair<const char *const, size_t>) + 4 * sizeof(void *));
+    for (const Chunk &chunk : chunks_)
+    {
+        bytes += chunk.capacity;
+    }
+    return bytes;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only storage for strings in large chunks. Released strings are only
+// accounted for; a chunk is freed once every string stored in it is released.
+class TextArena
+{
+public:
+    explicit TextArena(size_t chunk_size);
+
+    std::string_view Store(std::string_view text);
+    void Release(std::string_view text);
+
+    size_t GetLiveBytes() const;
+    size_t GetReleasedBytes() const;
+    size_t GetMemoryUsage() const;
+
+private:
+    struct Chunk
+    {
+        std::unique_ptr<char[]> data;
+        size_t capacity = 0;
+        size_t used = 0;
+        size_t live = 0;
+    };
+
+    size_t chunk_size_;
+    std::vector<Chunk> chunks_;
+    std::map<const char *, size_t> chunk_by_address_;
+    size_t live_bytes_ = 0;
+    size_t released_bytes_ = 0;
+};
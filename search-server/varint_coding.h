@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+inline void AppendVarint(std::vector<uint8_t> &out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline size_t GetVarintSize(uint32_t value)
+{
+    size_t size = 1;
+    while (value >= 0x80)
+    {
+        ++size;
+        value >>= 7;
+    }
+    return size;
+}
+
+inline uint32_t ReadVarint(const uint8_t *&data)
+{
+    uint32_t value = 0;
+    int shift = 0;
+    while (*data & 0x80)
+    {
+        value |= static_cast<uint32_t>(*data & 0x7F) << shift;
+        shift += 7;
+        ++data;
+    }
+    value |= static_cast<uint32_t>(*data) << shift;
+    ++data;
+    return value;
+}
+
+inline void AppendDeltaEncoded(std::vector<uint8_t> &out, const std::vector<uint32_t> &sorted_values)
+{
+    uint32_t previous = 0;
+    for (const uint32_t value : sorted_values)
+    {
+        AppendVarint(out, value - previous);
+        previous = value;
+    }
+}
+
+inline std::vector<uint32_t> DecodeDeltaEncoded(const uint8_t *begin, const uint8_t *end)
+{
+    std::vector<uint32_t> values;
+    uint32_t previous = 0;
+    while (begin != end)
+    {
+        previous += ReadVarint(begin);
+        values.push_back(previous);
+    }
+    return values;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct TermFrequency
+{
+    int term_id;
+    double freq;
+};
+
+class WordFrequenciesView
+{
+public:
+    // Dereferencing builds the pair on the fly, so there is no element to refer to and the
+    // iterator only qualifies as an input iterator.
+    class Iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const TermFrequency *position, const std::vector<std::string_view> *words) : position_(position),
+                                                                                              words_(words) {}
+
+        value_type operator*() const
+        {
+            return {(*words_)[position_->term_id], position_->freq};
+        }
+
+        Iterator &operator++()
+        {
+            ++position_;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator previous = *this;
+            ++position_;
+            return previous;
+        }
+
+        bool operator==(const Iterator &other) const
+        {
+            return position_ == other.position_;
+        }
+
+        bool operator!=(const Iterator &other) const
+        {
+            return position_ != other.position_;
+        }
+
+    private:
+        const TermFrequency *position_;
+        const std::vector<std::string_view> *words_;
+    };
+
+    WordFrequenciesView() = default;
+    WordFrequenciesView(const TermFrequency *begin, const TermFrequency *end,
+                        const std::vector<std::string_view> &words) : begin_(begin), end_(end), words_(&words) {}
+
+    Iterator begin() const
+    {
+        return {begin_, words_};
+    }
+
+    Iterator end() const
+    {
+        return {end_, words_};
+    }
+
+    size_t size() const
+    {
+        return end_ - begin_;
+    }
+
+    bool empty() const
+    {
+        return begin_ == end_;
+    }
+
+    std::map<std::string_view, double> ToMap() const
+    {
+        return {begin(), end()};
+    }
+
+private:
+    const TermFrequency *begin_ = nullptr;
+    const TermFrequency *end_ = nullptr;
+    const std::vector<std::string_view> *words_ = nullptr;
+};